@@ -0,0 +1,256 @@
+#include "ParticleAffector.h"
+#include <cmath>
+#include <algorithm>
+
+USING_NS_CUSTOM;
+
+/** Returns how much of a field's strength is left at distance, fading to nothing at radius, or -1 beyond it. */
+static inline float fade(float distance, float radius)
+{
+	if (radius <= 0) return 1;
+	return distance < radius ? 1 - distance / radius : -1;
+}
+
+void NS_CUSTOM::ParticleAttractor::accelerate(Batch& batch)
+{
+	float centerX = _x - batch.originX, centerY = _y - batch.originY;
+	float strength = _strength * batch.delta;
+	for (int i = 0; i < batch.count; i++){
+		if (!batch.active[i]) continue;
+		float dx = centerX - batch.particles[i].x;
+		float dy = centerY - batch.particles[i].y;
+		float distance = std::sqrt(dx * dx + dy * dy);
+		float scale = fade(distance, _radius);
+		if (scale <= 0 || distance < 1e-4f) continue;
+		scale *= strength / distance;
+		batch.velocities[i * 2] += dx * scale;
+		batch.velocities[i * 2 + 1] += dy * scale;
+	}
+}
+
+void NS_CUSTOM::ParticleVortex::accelerate(Batch& batch)
+{
+	float centerX = _x - batch.originX, centerY = _y - batch.originY;
+	float strength = _strength * batch.delta, pull = _pull * batch.delta;
+	for (int i = 0; i < batch.count; i++){
+		if (!batch.active[i]) continue;
+		float dx = batch.particles[i].x - centerX;
+		float dy = batch.particles[i].y - centerY;
+		float distance = std::sqrt(dx * dx + dy * dy);
+		float scale = fade(distance, _radius);
+		if (scale <= 0 || distance < 1e-4f) continue;
+		scale /= distance;
+		// Counter-clockwise tangent, then inward.
+		batch.velocities[i * 2] += (-dy * strength - dx * pull) * scale;
+		batch.velocities[i * 2 + 1] += (dx * strength - dy * pull) * scale;
+	}
+}
+
+NS_CUSTOM::ParticleTurbulence::ParticleTurbulence(int gridSize, float cellSize, float strength, uint32_t seed) :
+	_gridSize(std::max(gridSize, 1)),
+	_cellSize(cellSize > 0 ? cellSize : 1),
+	_strength(strength),
+	_offsetX(0), _offsetY(0)
+{
+	// A generator of its own, so building a field does not disturb ParticleRandom's sequence.
+	uint32_t state = seed ? seed : 1;
+	_field.resize(_gridSize * _gridSize * 2);
+	for (int i = 0; i < _gridSize * _gridSize; i++){
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		float angle = (state >> 8) * (360.0f / (1 << 24));
+		_field[i * 2] = ParticleMath::cosDeg(angle);
+		_field[i * 2 + 1] = ParticleMath::sinDeg(angle);
+	}
+}
+
+void NS_CUSTOM::ParticleTurbulence::sample(float x, float y, float& fieldX, float& fieldY) const
+{
+	float gridX = (x + _offsetX) / _cellSize, gridY = (y + _offsetY) / _cellSize;
+	float floorX = std::floor(gridX), floorY = std::floor(gridY);
+	float tx = gridX - floorX, ty = gridY - floorY;
+	// Smoothstep keeps the field's slope continuous across cells.
+	tx = tx * tx * (3 - 2 * tx);
+	ty = ty * ty * (3 - 2 * ty);
+	int x0 = (int)floorX % _gridSize, y0 = (int)floorY % _gridSize;
+	if (x0 < 0) x0 += _gridSize;
+	if (y0 < 0) y0 += _gridSize;
+	int x1 = (x0 + 1) % _gridSize, y1 = (y0 + 1) % _gridSize;
+	const float* a = &_field[(y0 * _gridSize + x0) * 2];
+	const float* b = &_field[(y0 * _gridSize + x1) * 2];
+	const float* c = &_field[(y1 * _gridSize + x0) * 2];
+	const float* d = &_field[(y1 * _gridSize + x1) * 2];
+	float bottomX = a[0] + (b[0] - a[0]) * tx, bottomY = a[1] + (b[1] - a[1]) * tx;
+	float topX = c[0] + (d[0] - c[0]) * tx, topY = c[1] + (d[1] - c[1]) * tx;
+	fieldX = bottomX + (topX - bottomX) * ty;
+	fieldY = bottomY + (topY - bottomY) * ty;
+}
+
+void NS_CUSTOM::ParticleTurbulence::accelerate(Batch& batch)
+{
+	float strength = _strength * batch.delta;
+	for (int i = 0; i < batch.count; i++){
+		if (!batch.active[i]) continue;
+		float fieldX, fieldY;
+		sample(batch.particles[i].x + batch.originX, batch.particles[i].y + batch.originY, fieldX, fieldY);
+		batch.velocities[i * 2] += fieldX * strength;
+		batch.velocities[i * 2 + 1] += fieldY * strength;
+	}
+}
+
+void NS_CUSTOM::ParticleCollider::resolve(Batch& batch, int index, float nx, float ny, float depth)
+{
+	batch.particles[index].x += nx * depth;
+	batch.particles[index].y += ny * depth;
+	float* velocity = &batch.velocities[index * 2];
+	float normal = velocity[0] * nx + velocity[1] * ny;
+	if (normal >= 0) return;
+	float tangentX = velocity[0] - normal * nx, tangentY = velocity[1] - normal * ny;
+	float friction = 1 - _friction;
+	velocity[0] = tangentX * friction - normal * _bounce * nx;
+	velocity[1] = tangentY * friction - normal * _bounce * ny;
+}
+
+void NS_CUSTOM::ParticlePlaneCollider::setNormal(float x, float y)
+{
+	float length = std::sqrt(x * x + y * y);
+	if (length < 1e-6f){
+		_normalX = 0;
+		_normalY = 1;
+		return;
+	}
+	_normalX = x / length;
+	_normalY = y / length;
+}
+
+void NS_CUSTOM::ParticlePlaneCollider::constrain(Batch& batch)
+{
+	// Signed distance is position . normal - offset, with the offset taken in stored coordinates.
+	float offset = (_x - batch.originX) * _normalX + (_y - batch.originY) * _normalY;
+	for (int i = 0; i < batch.count; i++){
+		if (!batch.active[i]) continue;
+		float distance = batch.particles[i].x * _normalX + batch.particles[i].y * _normalY - offset;
+		if (distance < 0) resolve(batch, i, _normalX, _normalY, -distance);
+	}
+}
+
+void NS_CUSTOM::ParticleCircleCollider::constrain(Batch& batch)
+{
+	float centerX = _x - batch.originX, centerY = _y - batch.originY;
+	float radius2 = _radius * _radius;
+	for (int i = 0; i < batch.count; i++){
+		if (!batch.active[i]) continue;
+		float dx = batch.particles[i].x - centerX;
+		float dy = batch.particles[i].y - centerY;
+		float distance2 = dx * dx + dy * dy;
+		if (distance2 >= radius2) continue;
+		float distance = std::sqrt(distance2);
+		// A particle at the very center leaves upward.
+		if (distance < 1e-4f) resolve(batch, i, 0, 1, _radius);
+		else resolve(batch, i, dx / distance, dy / distance, _radius - distance);
+	}
+}
+
+void NS_CUSTOM::ParticleCollisionWorld::clear()
+{
+	_shapes.clear();
+	_dirty = true;
+}
+
+void NS_CUSTOM::ParticleCollisionWorld::addCircle(float x, float y, float radius)
+{
+	Shape shape = { false, x, y, radius, radius };
+	_shapes.push_back(shape);
+	_dirty = true;
+}
+
+void NS_CUSTOM::ParticleCollisionWorld::addBox(float x, float y, float width, float height)
+{
+	Shape shape = { true, x + width / 2, y + height / 2, std::abs(width) / 2, std::abs(height) / 2 };
+	_shapes.push_back(shape);
+	_dirty = true;
+}
+
+void NS_CUSTOM::ParticleCollisionWorld::setCellSize(float cellSize)
+{
+	_cellSize = cellSize > 0 ? cellSize : 1;
+	_dirty = true;
+}
+
+int NS_CUSTOM::ParticleCollisionWorld::getBucket(int cellX, int cellY) const
+{
+	uint32_t hash = ((uint32_t)cellX * 73856093u) ^ ((uint32_t)cellY * 19349663u);
+	return (int)(hash & (uint32_t)(_bucketStarts.size() - 2));
+}
+
+void NS_CUSTOM::ParticleCollisionWorld::rebuild()
+{
+	_dirty = false;
+	// A power of two, about two buckets per shape.
+	size_t bucketCount = 64;
+	while (bucketCount < _shapes.size() * 2) bucketCount *= 2;
+	_bucketStarts.assign(bucketCount + 1, 0);
+
+	// Count the cells of each bucket, turn the counts into starts, then fill: shapes stay in one flat array.
+	for (int pass = 0; pass < 2; pass++){
+		if (pass == 1){
+			for (size_t i = 1; i <= bucketCount; i++)
+				_bucketStarts[i] += _bucketStarts[i - 1];
+			_entries.resize(_bucketStarts[bucketCount]);
+		}
+		for (size_t i = 0; i < _shapes.size(); i++){
+			auto& shape = _shapes[i];
+			int left = (int)std::floor((shape.x - shape.width) / _cellSize);
+			int right = (int)std::floor((shape.x + shape.width) / _cellSize);
+			int bottom = (int)std::floor((shape.y - shape.height) / _cellSize);
+			int top = (int)std::floor((shape.y + shape.height) / _cellSize);
+			for (int cellY = bottom; cellY <= top; cellY++){
+				for (int cellX = left; cellX <= right; cellX++){
+					int bucket = getBucket(cellX, cellY);
+					// Counted at bucket + 1, so after the prefix sum _bucketStarts[bucket] is where it starts.
+					if (pass == 0) _bucketStarts[bucket + 1]++;
+					else _entries[_bucketStarts[bucket]++] = (int)i;
+				}
+			}
+		}
+	}
+	// Filling moved every start to the next bucket's; shift them back.
+	for (size_t i = bucketCount; i > 0; i--)
+		_bucketStarts[i] = _bucketStarts[i - 1];
+	_bucketStarts[0] = 0;
+}
+
+void NS_CUSTOM::ParticleCollisionWorld::collide(Batch& batch, int index, const Shape& shape)
+{
+	float dx = batch.particles[index].x + batch.originX - shape.x;
+	float dy = batch.particles[index].y + batch.originY - shape.y;
+	if (!shape.box){
+		float distance2 = dx * dx + dy * dy;
+		if (distance2 >= shape.width * shape.width) return;
+		float distance = std::sqrt(distance2);
+		if (distance < 1e-4f) resolve(batch, index, 0, 1, shape.width);
+		else resolve(batch, index, dx / distance, dy / distance, shape.width - distance);
+		return;
+	}
+	float depthX = shape.width - std::abs(dx), depthY = shape.height - std::abs(dy);
+	if (depthX <= 0 || depthY <= 0) return;
+	// Out through the nearest side.
+	if (depthX < depthY) resolve(batch, index, dx < 0 ? -1.0f : 1.0f, 0, depthX);
+	else resolve(batch, index, 0, dy < 0 ? -1.0f : 1.0f, depthY);
+}
+
+void NS_CUSTOM::ParticleCollisionWorld::constrain(Batch& batch)
+{
+	if (_shapes.empty()) return;
+	if (_dirty) rebuild();
+	for (int i = 0; i < batch.count; i++){
+		if (!batch.active[i]) continue;
+		int cellX = (int)std::floor((batch.particles[i].x + batch.originX) / _cellSize);
+		int cellY = (int)std::floor((batch.particles[i].y + batch.originY) / _cellSize);
+		int bucket = getBucket(cellX, cellY);
+		// Buckets may hold shapes of other cells that hash alike; testing them is only wasted work.
+		for (int j = _bucketStarts[bucket]; j < _bucketStarts[bucket + 1]; j++)
+			collide(batch, i, _shapes[_entries[j]]);
+	}
+}
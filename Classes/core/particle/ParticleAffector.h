@@ -0,0 +1,303 @@
+#ifndef __PARTICLE_AFFECTOR_H__
+#define __PARTICLE_AFFECTOR_H__
+
+#include <vector>
+#include <cstdint>
+#include "ParticleSimulation.h"
+#include "core/util/GameDefine.h"
+
+NS_CUSTOM_BEGIN
+
+/** A force field or collider acting on the particles of every simulation it is added to, in one pass over the
+* particle arrays per step. Positions are in the space particles spawn in, which for the emitters of an effect
+* is the effect's own. Simulations do not own their affectors; an affector must outlive them or be removed. */
+class ParticleAffector{
+public:
+	/** The particles of one simulation for one step. */
+	struct Batch{
+		Particle* particles;
+		const bool* active;
+		/** x and y velocity per particle in units per second, gathered from affectors only. */
+		float* velocities;
+		int count;
+		/** Added to stored positions to get the centers particles are drawn at, in the affectors' space. */
+		float originX, originY;
+		/** Seconds. */
+		float delta;
+	};
+
+	ParticleAffector() :_enabled(true){}
+
+	virtual ~ParticleAffector(){}
+
+	/** Adds to the velocities, before they move the particles. */
+	virtual void accelerate(Batch&){}
+
+	/** Corrects positions and velocities, after the particles moved. */
+	virtual void constrain(Batch&){}
+
+	bool isEnabled() const {
+		return _enabled;
+	}
+
+	void setEnabled(bool enabled) {
+		_enabled = enabled;
+	}
+protected:
+	bool _enabled;
+};
+
+/** Pulls particles toward a point, or pushes them away with a negative strength. The strength is in units per
+* second squared at the point and fades to nothing at the radius; a radius of 0 reaches everywhere at full
+* strength. */
+class ParticleAttractor : public ParticleAffector{
+public:
+	ParticleAttractor(float x = 0, float y = 0, float strength = 0, float radius = 0) :
+		_x(x), _y(y), _strength(strength), _radius(radius){}
+
+	void setPosition(float x, float y) {
+		_x = x;
+		_y = y;
+	}
+
+	float getX() const {
+		return _x;
+	}
+
+	float getY() const {
+		return _y;
+	}
+
+	void setStrength(float strength) {
+		_strength = strength;
+	}
+
+	float getStrength() const {
+		return _strength;
+	}
+
+	void setRadius(float radius) {
+		_radius = radius;
+	}
+
+	float getRadius() const {
+		return _radius;
+	}
+
+	virtual void accelerate(Batch& batch);
+private:
+	float _x, _y;
+	float _strength;
+	float _radius;
+};
+
+/** Swirls particles around a point, counter-clockwise with a positive strength, and pulls them in by pull so
+* they stay in orbit. Both fade like ParticleAttractor's strength. */
+class ParticleVortex : public ParticleAffector{
+public:
+	ParticleVortex(float x = 0, float y = 0, float strength = 0, float radius = 0) :
+		_x(x), _y(y), _strength(strength), _pull(0), _radius(radius){}
+
+	void setPosition(float x, float y) {
+		_x = x;
+		_y = y;
+	}
+
+	float getX() const {
+		return _x;
+	}
+
+	float getY() const {
+		return _y;
+	}
+
+	void setStrength(float strength) {
+		_strength = strength;
+	}
+
+	float getStrength() const {
+		return _strength;
+	}
+
+	void setPull(float pull) {
+		_pull = pull;
+	}
+
+	float getPull() const {
+		return _pull;
+	}
+
+	void setRadius(float radius) {
+		_radius = radius;
+	}
+
+	float getRadius() const {
+		return _radius;
+	}
+
+	virtual void accelerate(Batch& batch);
+private:
+	float _x, _y;
+	float _strength;
+	float _pull;
+	float _radius;
+};
+
+/** Pushes particles along a smooth random field, interpolated from a grid of random directions that is
+* computed once and tiled over space. Moving the offset each frame makes the field drift. */
+class ParticleTurbulence : public ParticleAffector{
+public:
+	/** The grid has gridSize points per side, cellSize units apart. Equal seeds give equal fields. */
+	ParticleTurbulence(int gridSize = 16, float cellSize = 64, float strength = 0, uint32_t seed = 1);
+
+	void setStrength(float strength) {
+		_strength = strength;
+	}
+
+	float getStrength() const {
+		return _strength;
+	}
+
+	/** Shifts the field by x, y units. */
+	void setOffset(float x, float y) {
+		_offsetX = x;
+		_offsetY = y;
+	}
+
+	/** Returns the field's direction at x, y, with a length of at most 1. */
+	void sample(float x, float y, float& fieldX, float& fieldY) const;
+
+	virtual void accelerate(Batch& batch);
+private:
+	int _gridSize;
+	float _cellSize;
+	float _strength;
+	float _offsetX, _offsetY;
+	/** x and y per grid point, row by row. */
+	std::vector<float> _field;
+};
+
+/** Base of the colliders. On contact a particle is moved out of the shape; bounce scales the part of its
+* affector velocity into the shape that is reflected, and friction takes a part off the rest. Velocity from the
+* definition is not stored and keeps pushing, so particles it drives into a shape slide along it. */
+class ParticleCollider : public ParticleAffector{
+public:
+	ParticleCollider() :_bounce(0.5f), _friction(0){}
+
+	void setBounce(float bounce) {
+		_bounce = bounce;
+	}
+
+	float getBounce() const {
+		return _bounce;
+	}
+
+	void setFriction(float friction) {
+		_friction = friction;
+	}
+
+	float getFriction() const {
+		return _friction;
+	}
+protected:
+	float _bounce;
+	float _friction;
+
+	/** Moves particle index by depth along the unit normal nx, ny and reflects its velocity. */
+	void resolve(Batch& batch, int index, float nx, float ny, float depth);
+};
+
+/** Keeps particles in front of a line through a point, on the side its normal faces. */
+class ParticlePlaneCollider : public ParticleCollider{
+public:
+	ParticlePlaneCollider(float x = 0, float y = 0, float normalX = 0, float normalY = 1) :_x(x), _y(y){
+		setNormal(normalX, normalY);
+	}
+
+	void setPosition(float x, float y) {
+		_x = x;
+		_y = y;
+	}
+
+	/** Normalized here; a zero normal points up. */
+	void setNormal(float x, float y);
+
+	virtual void constrain(Batch& batch);
+private:
+	float _x, _y;
+	float _normalX, _normalY;
+};
+
+/** Keeps particles out of a circle. */
+class ParticleCircleCollider : public ParticleCollider{
+public:
+	ParticleCircleCollider(float x = 0, float y = 0, float radius = 0) :_x(x), _y(y), _radius(radius){}
+
+	void setPosition(float x, float y) {
+		_x = x;
+		_y = y;
+	}
+
+	void setRadius(float radius) {
+		_radius = radius;
+	}
+
+	float getRadius() const {
+		return _radius;
+	}
+
+	virtual void constrain(Batch& batch);
+private:
+	float _x, _y;
+	float _radius;
+};
+
+/** Keeps particles out of many circles and boxes, e.g. the obstacles of a level. The shapes are hashed into
+* grid cells, so each particle only tests those in its own cell. Refill it whenever the shapes move; the hash
+* is rebuilt on the next step. */
+class ParticleCollisionWorld : public ParticleCollider{
+public:
+	/** cellSize should be around the size of a typical shape. */
+	explicit ParticleCollisionWorld(float cellSize = 64) :_cellSize(cellSize), _dirty(false){}
+
+	void clear();
+
+	void addCircle(float x, float y, float radius);
+
+	/** Adds the axis-aligned box with corners x, y and x + width, y + height. */
+	void addBox(float x, float y, float width, float height);
+
+	int getShapeCount() const {
+		return (int)_shapes.size();
+	}
+
+	void setCellSize(float cellSize);
+
+	virtual void constrain(Batch& batch);
+private:
+	struct Shape{
+		bool box;
+		/** Center. */
+		float x, y;
+		/** Radius of circles, half extents of boxes. */
+		float width, height;
+	};
+
+	float _cellSize;
+	bool _dirty;
+	std::vector<Shape> _shapes;
+	/** Shape indices, grouped by bucket; bucket i spans [_bucketStarts[i], _bucketStarts[i + 1]). */
+	std::vector<int> _entries;
+	std::vector<int> _bucketStarts;
+
+	void rebuild();
+
+	int getBucket(int cellX, int cellY) const;
+
+	/** Moves particle index out of shape, if it is inside. */
+	void collide(Batch& batch, int index, const Shape& shape);
+};
+
+NS_CUSTOM_END
+
+#endif
@@ -0,0 +1,204 @@
+#include "ParticleBakedLoop.h"
+#include <cmath>
+#include <algorithm>
+#include <unordered_map>
+
+USING_NS_CUSTOM;
+
+std::vector<ParticleBakedLoop::CacheEntry> NS_CUSTOM::ParticleBakedLoop::_cache;
+
+ParticleBakedLoop* NS_CUSTOM::ParticleBakedLoop::getOrBake(ParticleEmitter* emitter, size_t maxBytes, int frameRate)
+{
+	if (!emitter->isContinuous()) return nullptr;
+	auto definition = emitter->definition();
+	for (auto& entry : _cache){
+		if (entry.definition != definition || entry.spriteWidth != emitter->_spriteWidth
+			|| entry.spriteHeight != emitter->_spriteHeight || entry.maxParticleCount != emitter->maxParticleCount
+			|| entry.frameRate != frameRate) continue;
+		if (entry.loop) return entry.loop->getMemorySize() <= maxBytes ? entry.loop : nullptr;
+		if (maxBytes <= entry.maxBytes) return nullptr;
+		entry.maxBytes = maxBytes;
+		entry.loop = bake(emitter, maxBytes, frameRate);
+		return entry.loop;
+	}
+	CacheEntry entry = { definition, emitter->_spriteWidth, emitter->_spriteHeight, emitter->maxParticleCount,
+		frameRate, maxBytes, bake(emitter, maxBytes, frameRate) };
+	definition->retain();
+	_cache.push_back(entry);
+	return entry.loop;
+}
+
+ParticleBakedLoop* NS_CUSTOM::ParticleBakedLoop::bake(ParticleEmitter* emitter, size_t maxBytes, int frameRate)
+{
+	// Particles outliving this many loops are cut off; nothing authored as a loop lives that long.
+	static const int MAX_LAPS = 16;
+	static const size_t QUAD_BYTES = sizeof(int16_t) * 6 + sizeof(uint16_t);
+
+	struct Quad{
+		float x, y, ax, ay, bx, by;
+		Color4B color;
+	};
+
+	if (!emitter->isContinuous() || frameRate <= 0) return nullptr;
+
+	// A headless copy runs once through, so baking needs no GL buffers and leaves the emitter as it was.
+	auto pool = ParticleBufferPool::getInstance();
+	bool headless = pool->isHeadless();
+	pool->setHeadless(true);
+	auto recorder = new ParticleEmitter();
+	recorder->init(emitter);
+	recorder->setBakedLoop(nullptr);
+	recorder->setParticleSize(emitter->_spriteWidth, emitter->_spriteHeight);
+	recorder->setContinuous(false);
+	recorder->reset();
+	pool->setHeadless(headless);
+
+	// A continuous emitter restarts after its delay and duration.
+	float period = (recorder->delay + recorder->duration) / 1000;
+	int frameCount = std::max(1, (int)std::round(period * frameRate));
+	float frameTime = period / frameCount;
+	int limit = recorder->maxParticleCount;
+	std::vector<std::vector<Quad>> frames(frameCount);
+	size_t quadCount = 0;
+	bool fits = true;
+	for (int i = 0; i < frameCount * MAX_LAPS && fits && !recorder->isComplete(); i++){
+		recorder->step(frameTime);
+		recorder->updateParticleQuads();
+		// Later laps add the particles that would still be alive at the same moment of the next loop.
+		auto& frame = frames[i % frameCount];
+		int count = std::min(recorder->activeCount, limit - (int)frame.size());
+		for (int j = 0; j < count; j++){
+			auto& quad = recorder->_quads[j];
+			auto& bl = quad.bl.vertices;
+			Quad baked = { bl.x, bl.y, quad.br.vertices.x - bl.x, quad.br.vertices.y - bl.y,
+				quad.tl.vertices.x - bl.x, quad.tl.vertices.y - bl.y, quad.bl.colors };
+			frame.push_back(baked);
+		}
+		quadCount += count;
+		fits = quadCount * QUAD_BYTES <= maxBytes;
+	}
+	recorder->release();
+	if (!fits) return nullptr;
+
+	auto loop = new ParticleBakedLoop();
+	loop->_period = period;
+	loop->_frameTime = frameTime;
+	loop->_bounds.inf();
+	float extent = 0;
+	for (auto& frame : frames){
+		for (auto& quad : frame){
+			extent = std::max(extent, std::max(std::abs(quad.x), std::abs(quad.y)));
+			extent = std::max(extent, std::max(std::abs(quad.ax), std::abs(quad.ay)));
+			extent = std::max(extent, std::max(std::abs(quad.bx), std::abs(quad.by)));
+			loop->_bounds.ext(quad.x, quad.y, 0);
+			loop->_bounds.ext(quad.x + quad.ax, quad.y + quad.ay, 0);
+			loop->_bounds.ext(quad.x + quad.bx, quad.y + quad.by, 0);
+			loop->_bounds.ext(quad.x + quad.ax + quad.bx, quad.y + quad.ay + quad.by, 0);
+		}
+	}
+	loop->_precision = extent > 0 ? extent / INT16_MAX : 1;
+
+	float scale = 1 / loop->_precision;
+	loop->_positions.reserve(quadCount * 6);
+	loop->_frameStarts.reserve(frameCount + 1);
+	loop->_frameStarts.push_back(0);
+	for (auto& frame : frames){
+		for (auto& quad : frame){
+			const float values[] = { quad.x, quad.y, quad.ax, quad.ay, quad.bx, quad.by };
+			for (float value : values)
+				loop->_positions.push_back((int16_t)std::lround(value * scale));
+		}
+		loop->_frameStarts.push_back(loop->_frameStarts.back() + (int)frame.size());
+	}
+
+	// Exact colors when they fit 16-bit indices, else fewer bits per channel until they do.
+	for (int shift = 0; shift < 8; shift++){
+		uint8_t mask = (uint8_t)(0xff << shift);
+		std::unordered_map<uint32_t, uint16_t> indices;
+		loop->_palette.clear();
+		loop->_colors.clear();
+		bool fitsPalette = true;
+		for (auto& frame : frames){
+			for (size_t i = 0; i < frame.size() && fitsPalette; i++){
+				auto& color = frame[i].color;
+				Color4B masked(color.r & mask, color.g & mask, color.b & mask, color.a & mask);
+				uint32_t key = masked.r | masked.g << 8 | masked.b << 16 | (uint32_t)masked.a << 24;
+				auto it = indices.find(key);
+				if (it == indices.end()){
+					if (loop->_palette.size() > UINT16_MAX){
+						fitsPalette = false;
+						break;
+					}
+					it = indices.emplace(key, (uint16_t)loop->_palette.size()).first;
+					loop->_palette.push_back(masked);
+				}
+				loop->_colors.push_back(it->second);
+			}
+		}
+		if (fitsPalette) break;
+	}
+
+	if (loop->getMemorySize() > maxBytes){
+		loop->release();
+		return nullptr;
+	}
+	return loop;
+}
+
+void NS_CUSTOM::ParticleBakedLoop::clearCache()
+{
+	for (auto& entry : _cache){
+		CC_SAFE_RELEASE(entry.loop);
+		entry.definition->release();
+	}
+	_cache.clear();
+}
+
+std::vector<ParticleBakedLoop*> NS_CUSTOM::ParticleBakedLoop::getCachedLoops()
+{
+	std::vector<ParticleBakedLoop*> loops;
+	for (auto& entry : _cache){
+		if (entry.loop) loops.push_back(entry.loop);
+	}
+	return loops;
+}
+
+int NS_CUSTOM::ParticleBakedLoop::getFrame(float time) const
+{
+	int frame = (int)(time / _frameTime);
+	return std::min(std::max(frame, 0), getFrameCount() - 1);
+}
+
+int NS_CUSTOM::ParticleBakedLoop::decode(int frame, V3F_C4B_T2F_Quad* quads, int maxCount) const
+{
+	int start = _frameStarts[frame];
+	int count = std::min(_frameStarts[frame + 1] - start, maxCount);
+	const int16_t* position = _positions.data() + start * 6;
+	const uint16_t* color = _colors.data() + start;
+	for (int i = 0; i < count; i++, position += 6){
+		float x = position[0] * _precision, y = position[1] * _precision;
+		float ax = position[2] * _precision, ay = position[3] * _precision;
+		float bx = position[4] * _precision, by = position[5] * _precision;
+		auto& quad = quads[i];
+		quad.bl.vertices.x = x;
+		quad.bl.vertices.y = y;
+		quad.br.vertices.x = x + ax;
+		quad.br.vertices.y = y + ay;
+		quad.tl.vertices.x = x + bx;
+		quad.tl.vertices.y = y + by;
+		quad.tr.vertices.x = x + ax + bx;
+		quad.tr.vertices.y = y + ay + by;
+		const Color4B& quadColor = _palette[color[i]];
+		quad.bl.colors = quadColor;
+		quad.br.colors = quadColor;
+		quad.tl.colors = quadColor;
+		quad.tr.colors = quadColor;
+	}
+	return count;
+}
+
+size_t NS_CUSTOM::ParticleBakedLoop::getMemorySize() const
+{
+	return sizeof(ParticleBakedLoop) + sizeof(int16_t) * _positions.capacity() + sizeof(uint16_t) * _colors.capacity()
+		+ sizeof(Color4B) * _palette.capacity() + sizeof(int) * _frameStarts.capacity();
+}
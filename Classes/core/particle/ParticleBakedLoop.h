@@ -0,0 +1,95 @@
+#ifndef __PARTICLE_BAKED_LOOP_H__
+#define __PARTICLE_BAKED_LOOP_H__
+
+#include <vector>
+#include <cstdint>
+#include "cocos2d.h"
+#include "ParticleEmitter.h"
+#include "core/util/GameDefine.h"
+
+USING_NS_CC;
+
+NS_CUSTOM_BEGIN
+
+/** One loop of a continuous emitter's quads, recorded once and played back by any number of emitters instead of
+* simulating. Particles still alive when the loop ends are folded back onto its start, so it repeats without a
+* seam. A quad takes 14 bytes instead of 96: one corner as 16-bit fixed point, the edges to two more corners as
+* offsets from it, and its color as an index into a palette. Texture coordinates are the playing emitter's. */
+class ParticleBakedLoop : public Ref{
+public:
+	static const int DEFAULT_FRAME_RATE = 60;
+
+	/** Returns the loop of emitter's definition at its sprite size and particle limit, baking it on first use so
+	* that later emitters share it. Returns null if the emitter is not continuous or the loop would take more than
+	* maxBytes; a failed bake is only retried with more bytes. */
+	static ParticleBakedLoop* getOrBake(ParticleEmitter* emitter, size_t maxBytes, int frameRate = DEFAULT_FRAME_RATE);
+
+	/** Records a new loop from a copy of emitter, which is left untouched, or returns null like getOrBake(). The
+	* loop is owned by the caller. */
+	static ParticleBakedLoop* bake(ParticleEmitter* emitter, size_t maxBytes, int frameRate = DEFAULT_FRAME_RATE);
+
+	/** Releases the cached loops; emitters playing one keep it until they stop. */
+	static void clearCache();
+
+	/** Returns the cached loops, in the order they were baked. */
+	static std::vector<ParticleBakedLoop*> getCachedLoops();
+
+	/** Seconds: one delay and duration of the emitter. */
+	float getPeriod() const {
+		return _period;
+	}
+
+	int getFrameCount() const {
+		return (int)_frameStarts.size() - 1;
+	}
+
+	/** Returns the frame shown time seconds into the loop. */
+	int getFrame(float time) const;
+
+	int getQuadCount(int frame) const {
+		return _frameStarts[frame + 1] - _frameStarts[frame];
+	}
+
+	/** Writes the vertices and colors of frame's quads, at most maxCount, and returns how many it wrote. */
+	int decode(int frame, V3F_C4B_T2F_Quad* quads, int maxCount) const;
+
+	/** Returns the box around every quad of the loop, in the emitter's space. */
+	const BoundingBox& getBounds() const {
+		return _bounds;
+	}
+
+	size_t getMemorySize() const;
+private:
+	struct CacheEntry{
+		/** Retained, so the key cannot be reused by another definition. */
+		EmitterDefinition* definition;
+		float spriteWidth, spriteHeight;
+		int maxParticleCount;
+		int frameRate;
+		/** The bytes the loop was baked with; a failed bake is not retried with less. */
+		size_t maxBytes;
+		/** Null when baking failed. */
+		ParticleBakedLoop* loop;
+	};
+
+	static std::vector<CacheEntry> _cache;
+
+	float _period;
+	float _frameTime;
+	/** Units per fixed-point step. */
+	float _precision;
+	/** Per quad, the bottom-left corner and the edges from it to the bottom-right and top-left corners, as x, y
+	* pairs. Quads are parallelograms, so the top-right corner is the sum. */
+	std::vector<int16_t> _positions;
+	std::vector<uint16_t> _colors;
+	std::vector<Color4B> _palette;
+	/** Frame i spans quads [_frameStarts[i], _frameStarts[i + 1]). */
+	std::vector<int> _frameStarts;
+	BoundingBox _bounds;
+
+	ParticleBakedLoop() :_period(0), _frameTime(0), _precision(1){}
+};
+
+NS_CUSTOM_END
+
+#endif
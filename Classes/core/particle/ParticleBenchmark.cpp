@@ -0,0 +1,422 @@
+#include "ParticleBenchmark.h"
+#include "ParticleEffect.h"
+#include "core/util/GameUtil.h"
+#include <chrono>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+USING_NS_CUSTOM;
+
+typedef std::chrono::duration<double, std::milli> Milliseconds;
+typedef std::chrono::duration<double, std::nano> Nanoseconds;
+
+/** Kernel results are summed into here, so the calls cannot be optimized away. */
+static volatile float kernelSink;
+
+/** Calls kernel(i) until options.iterations items are covered, batch items per call, once untimed and then
+* options.repeats times timed. */
+template <typename Kernel>
+static ParticleBenchmark::KernelResult timeKernel(const string& name, int size, int batch,
+	const ParticleBenchmark::KernelOptions& options, Kernel kernel)
+{
+	int calls = std::max(1, options.iterations / batch);
+	int repeats = std::max(1, options.repeats);
+	std::vector<double> times;
+	for (int run = -1; run < repeats; run++){
+		float sum = 0;
+		auto startTime = std::chrono::steady_clock::now();
+		for (int i = 0; i < calls; i++)
+			sum += kernel(i);
+		double time = Nanoseconds(std::chrono::steady_clock::now() - startTime).count();
+		kernelSink = sum;
+		if (run >= 0) times.push_back(time / ((double)calls * batch));
+	}
+	std::sort(times.begin(), times.end());
+	ParticleBenchmark::KernelResult result;
+	result.name = size > 0 ? name + "/" + std::to_string(size) : name;
+	result.size = size;
+	result.iterations = (long long)calls * batch;
+	result.nsPerCall = times.front();
+	result.medianNsPerCall = times[times.size() / 2];
+	return result;
+}
+
+/** Calls load(definitions) once untimed and then repeats times timed, releasing what it loaded after each run. */
+template <typename Loader>
+static ParticleBenchmark::LoadResult timeLoad(const string& name, int files, int repeats, Loader load)
+{
+	ParticleBenchmark::LoadResult result;
+	result.name = name;
+	result.files = files;
+	result.emitters = 0;
+	std::vector<double> times;
+	for (int run = -1; run < std::max(1, repeats); run++){
+		std::vector<EmitterDefinition*> definitions;
+		auto startTime = std::chrono::steady_clock::now();
+		load(definitions);
+		double time = Milliseconds(std::chrono::steady_clock::now() - startTime).count();
+		result.emitters = (int)definitions.size();
+		for (auto definition : definitions)
+			definition->release();
+		if (run >= 0) times.push_back(time);
+	}
+	std::sort(times.begin(), times.end());
+	result.milliseconds = times.front();
+	result.medianMilliseconds = times[times.size() / 2];
+	return result;
+}
+
+/** Calls load() once untimed and then repeats times timed. After each run the effects of files are counted and
+* dropped from the effect cache, and their images from the TextureCache. */
+template <typename Loader>
+static ParticleBenchmark::LoadResult timePreload(const string& name, const std::vector<string>& files, int repeats, Loader load)
+{
+	auto cache = ParticleEffectCache::getInstance();
+	auto textureCache = Director::getInstance()->getTextureCache();
+	ParticleBenchmark::LoadResult result;
+	result.name = name;
+	result.files = (int)files.size();
+	std::vector<double> times;
+	for (int run = -1; run < std::max(1, repeats); run++){
+		auto startTime = std::chrono::steady_clock::now();
+		load();
+		double time = Milliseconds(std::chrono::steady_clock::now() - startTime).count();
+		result.emitters = 0;
+		for (auto& file : files){
+			auto effect = cache->peek(file);
+			if (!effect) continue;
+			string path = getPathForFilename(file);
+			for (auto emitter : effect->getEmitters()){
+				result.emitters++;
+				if (!emitter->getImagePath().empty()) textureCache->removeTextureForKey(path + emitter->getImagePath());
+			}
+			cache->remove(file);
+		}
+		if (run >= 0) times.push_back(time);
+	}
+	std::sort(times.begin(), times.end());
+	result.milliseconds = times.front();
+	result.medianMilliseconds = times[times.size() / 2];
+	return result;
+}
+
+std::vector<ParticleBenchmark::Scenario> NS_CUSTOM::ParticleBenchmark::getDefaultScenarios(const std::vector<string>& files)
+{
+	std::vector<Scenario> scenarios;
+	if (files.empty()) return scenarios;
+
+	Scenario huge;
+	huge.name = "huge-emitter";
+	huge.files.push_back(files[0]);
+	huge.maxParticles = 20000;
+	huge.fill = true;
+	scenarios.push_back(huge);
+
+	Scenario many;
+	many.name = "many-small-effects";
+	many.files = files;
+	many.instances = 200;
+	scenarios.push_back(many);
+
+	Scenario storm;
+	storm.name = "burst-storm";
+	storm.files = files;
+	storm.maxParticles = 10000;
+	storm.burstsPerFrame = 50;
+	storm.burstCount = 8;
+	scenarios.push_back(storm);
+	return scenarios;
+}
+
+ParticleBenchmark::Result NS_CUSTOM::ParticleBenchmark::run(const Scenario& scenario)
+{
+	// Emitters have no sprite here; any size keeps the scale curves finite.
+	static const float SPRITE_SIZE = 32;
+	// Bursts land anywhere in an area this size.
+	static const float BURST_AREA = 1000;
+
+	Result result = Result();
+	result.name = scenario.name;
+	result.frames = scenario.frames;
+
+	auto pool = ParticleBufferPool::getInstance();
+	bool headless = pool->isHeadless();
+	pool->setHeadless(true);
+
+	cocos2d::Vector<ParticleEmitter*> emitters;
+	for (auto& file : scenario.files){
+		std::vector<EmitterDefinition*> definitions;
+		auto effectFile = EffectFile::open(FileUtils::getInstance()->fullPathForFilename(file));
+		if (!effectFile){
+			CCLOG("ParticleBenchmark: missing effect %s", file.c_str());
+			continue;
+		}
+		ParticleEffect::readDefinitions(effectFile, definitions);
+		effectFile->release();
+		for (int i = 0; i < scenario.instances; i++){
+			for (auto definition : definitions){
+				auto emitter = ParticleEmitter::create();
+				emitter->setDefinition(definition);
+				emitter->setParticleSize(SPRITE_SIZE, SPRITE_SIZE);
+				if (scenario.maxParticles > 0) emitter->setMaxParticleCount(scenario.maxParticles);
+				if (scenario.fill) emitter->setMinParticleCount(emitter->getMaxParticleCount());
+				emitter->setContinuous(true);
+				emitter->start();
+				if (scenario.burstsPerFrame > 0) emitter->setEmitting(false);
+				emitters.pushBack(emitter);
+			}
+		}
+		for (auto definition : definitions)
+			definition->release();
+	}
+	result.emitters = (int)emitters.size();
+
+	std::vector<bool> wasActive;
+	for (int frame = 0; frame < scenario.frames; frame++){
+		size_t bytes = 0;
+		for (auto emitter : emitters){
+			int before = emitter->activeCount;
+			if (scenario.burstsPerFrame > 0){
+				auto burstTime = std::chrono::steady_clock::now();
+				for (int i = 0; i < scenario.burstsPerFrame; i++)
+					emitter->burst(random(0.0f, BURST_AREA), random(0.0f, BURST_AREA), scenario.burstCount);
+				result.updateTime += Milliseconds(std::chrono::steady_clock::now() - burstTime).count();
+				result.spawned += emitter->activeCount - before;
+			}
+
+			// Which particles die is read from the active flags around the step, outside the timed part.
+			before = emitter->activeCount;
+			wasActive.assign(emitter->active, emitter->active + emitter->maxParticleCount);
+			auto stepTime = std::chrono::steady_clock::now();
+			emitter->step(scenario.delta);
+			auto quadTime = std::chrono::steady_clock::now();
+			emitter->updateParticleQuads();
+			auto endTime = std::chrono::steady_clock::now();
+			result.updateTime += Milliseconds(quadTime - stepTime).count();
+			result.quadTime += Milliseconds(endTime - quadTime).count();
+
+			int killed = 0;
+			for (int i = 0; i < emitter->maxParticleCount; i++){
+				if (wasActive[i] && !emitter->active[i]) killed++;
+			}
+			result.spawned += emitter->activeCount - before + killed;
+			result.particleUpdates += emitter->activeCount + killed;
+			result.quads += emitter->activeCount;
+			bytes += emitter->getMemorySize();
+		}
+		result.peakBytes = std::max(result.peakBytes, bytes);
+	}
+
+	pool->setHeadless(headless);
+	if (result.particleUpdates > 0) result.nsPerParticleUpdate = result.updateTime * 1e6 / result.particleUpdates;
+	if (result.quads > 0) result.nsPerQuad = result.quadTime * 1e6 / result.quads;
+	if (result.updateTime > 0) result.spawnsPerSecond = result.spawned * 1000 / result.updateTime;
+	return result;
+}
+
+std::vector<ParticleBenchmark::Result> NS_CUSTOM::ParticleBenchmark::run(const std::vector<Scenario>& scenarios)
+{
+	std::vector<Result> results;
+	for (auto& scenario : scenarios)
+		results.push_back(run(scenario));
+	return results;
+}
+
+string NS_CUSTOM::ParticleBenchmark::toJson(const std::vector<Result>& results)
+{
+	std::ostringstream output;
+	output << std::fixed << std::setprecision(3);
+	output << "{\"scenarios\":[";
+	for (size_t i = 0; i < results.size(); i++){
+		auto& result = results[i];
+		if (i > 0) output << ',';
+		output << "{\"name\":\"" << result.name << "\",\"frames\":" << result.frames << ",\"emitters\":" << result.emitters
+			<< ",\"particleUpdates\":" << result.particleUpdates << ",\"quads\":" << result.quads
+			<< ",\"spawned\":" << result.spawned << ",\"updateMs\":" << result.updateTime
+			<< ",\"quadMs\":" << result.quadTime << ",\"nsPerParticleUpdate\":" << result.nsPerParticleUpdate
+			<< ",\"nsPerQuad\":" << result.nsPerQuad << ",\"spawnsPerSecond\":" << result.spawnsPerSecond
+			<< ",\"peakBytes\":" << result.peakBytes << '}';
+	}
+	output << "]}";
+	return output.str();
+}
+
+std::vector<ParticleBenchmark::KernelResult> NS_CUSTOM::ParticleBenchmark::runKernels(const KernelOptions& options)
+{
+	static const float SPRITE_SIZE = 32;
+	static const float SPAWN_AREA = 100;
+	static const int SPAWN_COUNT = 1000;
+	// Percents are read from a table, so the curves are not always hit at the same point.
+	static const int PERCENT_COUNT = 1024;
+
+	std::vector<KernelResult> results;
+	auto pool = ParticleBufferPool::getInstance();
+	bool headless = pool->isHeadless();
+	pool->setHeadless(true);
+	uint32_t randomState = ParticleRandom::getState();
+	ParticleRandom::setSeed(1);
+
+	float percents[PERCENT_COUNT];
+	for (int i = 0; i < PERCENT_COUNT; i++)
+		percents[i] = ParticleRandom::random(0, 1);
+
+	for (int size : options.timelineSizes){
+		if (size < 1) continue;
+		float_array timeline, scaling, colors;
+		for (int i = 0; i < size; i++){
+			timeline.push_back(size > 1 ? i / (float)(size - 1) : 0);
+			scaling.push_back(ParticleRandom::random(0, 1));
+			for (int j = 0; j < 3; j++)
+				colors.push_back(ParticleRandom::random(0, 1));
+		}
+		ScaledNumericValue scaled;
+		scaled.setTimeline(timeline);
+		scaled.setScaling(scaling);
+		results.push_back(timeKernel("getScale", size, 1, options, [&](int i){
+			return scaled.getScale(percents[i % PERCENT_COUNT]);
+		}));
+		GradientColorValue gradient;
+		gradient.setTimeline(timeline);
+		gradient.setColors(colors);
+		results.push_back(timeKernel("getColor", size, 1, options, [&](int i){
+			return gradient.getColor(percents[i % PERCENT_COUNT])[0];
+		}));
+	}
+
+	RangedNumericValue ranged;
+	ranged.setLow(0, 100);
+	results.push_back(timeKernel("newLowValue", 0, 1, options, [&](int){
+		return ranged.newLowValue();
+	}));
+
+	struct Shape{
+		const char* name;
+		SpawnShape shape;
+		bool edges;
+	};
+	const Shape shapes[] = { { "point", point, false }, { "line", line, false }, { "square", square, false },
+		{ "ellipse", ellipse, false }, { "ellipse-edges", ellipse, true } };
+	for (auto& shape : shapes){
+		auto emitter = ParticleEmitter::create();
+		emitter->setMaxParticleCount(SPAWN_COUNT);
+		emitter->setParticleSize(SPRITE_SIZE, SPRITE_SIZE);
+		emitter->getSpawnShape().setShape(shape.shape);
+		emitter->getSpawnShape().setEdges(shape.edges);
+		emitter->getSpawnWidth().setHigh(SPAWN_AREA);
+		emitter->getSpawnHeight().setHigh(SPAWN_AREA);
+		emitter->start();
+		results.push_back(timeKernel(string("spawn/") + shape.name, 0, 1, options, [&](int i){
+			emitter->activateParticle(i % SPAWN_COUNT, 0, 0);
+			return 0.0f;
+		}));
+	}
+
+	// updatePosWithParticle is inlined into updateParticleQuads and timed through it, per quad.
+	for (int count : options.particleCounts){
+		if (count < 1) continue;
+		auto emitter = ParticleEmitter::create();
+		emitter->setMaxParticleCount(count);
+		emitter->setParticleSize(SPRITE_SIZE, SPRITE_SIZE);
+		emitter->getRotation().setActive(true);
+		emitter->getRotation().setHigh(0, 360);
+		emitter->start();
+		emitter->addParticles(count);
+		results.push_back(timeKernel("updateParticleQuads", count, count, options, [&](int){
+			emitter->updateParticleQuads();
+			return 0.0f;
+		}));
+	}
+
+	pool->setHeadless(headless);
+	ParticleRandom::setState(randomState);
+	return results;
+}
+
+string NS_CUSTOM::ParticleBenchmark::toJson(const std::vector<KernelResult>& results)
+{
+	std::ostringstream output;
+	output << std::fixed << std::setprecision(3);
+	output << "{\"kernels\":[";
+	for (size_t i = 0; i < results.size(); i++){
+		auto& result = results[i];
+		if (i > 0) output << ',';
+		output << "{\"name\":\"" << result.name << "\",\"size\":" << result.size
+			<< ",\"iterations\":" << result.iterations << ",\"nsPerCall\":" << result.nsPerCall
+			<< ",\"medianNsPerCall\":" << result.medianNsPerCall << '}';
+	}
+	output << "]}";
+	return output.str();
+}
+
+std::vector<ParticleBenchmark::LoadResult> NS_CUSTOM::ParticleBenchmark::runLoaders(const std::vector<string>& files, int repeats)
+{
+	cocos2d::Vector<EffectFile*> effectFiles;
+	for (auto& file : files){
+		auto effectFile = EffectFile::open(FileUtils::getInstance()->fullPathForFilename(file));
+		if (!effectFile){
+			CCLOG("ParticleBenchmark: missing effect %s", file.c_str());
+			continue;
+		}
+		if (!effectFile->isBinary()) effectFiles.pushBack(effectFile);
+		effectFile->release();
+	}
+
+	std::vector<LoadResult> results;
+	results.push_back(timeLoad("text-parser", (int)effectFiles.size(), repeats, [&](std::vector<EmitterDefinition*>& definitions){
+		for (auto effectFile : effectFiles)
+			ParticleEffect::parseDefinitions(effectFile->getData(), effectFile->getSize(), definitions);
+	}));
+	// As loadEmitters read files before the parser: a copy into a string, then into a stream.
+	results.push_back(timeLoad("stream-reader", (int)effectFiles.size(), repeats, [&](std::vector<EmitterDefinition*>& definitions){
+		for (auto effectFile : effectFiles){
+			string content(effectFile->getData(), effectFile->getSize());
+			std::istringstream iss(content);
+			ParticleEffect::readDefinitions(iss, definitions);
+		}
+	}));
+	return results;
+}
+
+std::vector<ParticleBenchmark::LoadResult> NS_CUSTOM::ParticleBenchmark::runPackLoad(const std::vector<string>& files, const string& packFile, int repeats)
+{
+	std::vector<LoadResult> results;
+	if (!ParticleEffectPack::write(files, packFile)){
+		CCLOG("ParticleBenchmark: cannot pack into %s", packFile.c_str());
+		return results;
+	}
+	auto cache = ParticleEffectCache::getInstance();
+	for (auto& file : files)
+		cache->remove(file);
+
+	results.push_back(timePreload("pack", files, repeats, [&](){
+		auto pack = ParticleEffectPack::create(packFile);
+		if (pack) pack->preload();
+	}));
+	// The miss path of createFromCache, without the instance it hands out.
+	results.push_back(timePreload("loose-files", files, repeats, [&](){
+		for (auto& file : files){
+			if (cache->peek(file)) continue;
+			auto effect = ParticleEffect::create();
+			effect->loadEmitters(file);
+			effect->loadEmitterImages(getPathForFilename(file));
+			cache->insert(file, effect, 0);
+		}
+	}));
+	return results;
+}
+
+string NS_CUSTOM::ParticleBenchmark::toJson(const std::vector<LoadResult>& results)
+{
+	std::ostringstream output;
+	output << std::fixed << std::setprecision(3);
+	output << "{\"loaders\":[";
+	for (size_t i = 0; i < results.size(); i++){
+		auto& result = results[i];
+		if (i > 0) output << ',';
+		output << "{\"name\":\"" << result.name << "\",\"files\":" << result.files << ",\"emitters\":" << result.emitters
+			<< ",\"ms\":" << result.milliseconds << ",\"medianMs\":" << result.medianMilliseconds << '}';
+	}
+	output << "]}";
+	return output.str();
+}
@@ -0,0 +1,127 @@
+#ifndef __PARTICLE_BENCHMARK_H__
+#define __PARTICLE_BENCHMARK_H__
+
+#include <string>
+#include <vector>
+#include "cocos2d.h"
+#include "core/util/GameDefine.h"
+
+USING_NS_CC;
+using std::string;
+
+NS_CUSTOM_BEGIN
+
+/** Simulates effect files for a number of frames at a fixed delta without a window or GL context, and measures
+* the time spent updating particles and generating quads. Emitters are driven directly, outside the scene
+* graph; quads are built but never uploaded or drawn. */
+class ParticleBenchmark{
+public:
+	struct Scenario{
+		string name;
+		/** Effect files, resolved through FileUtils. */
+		std::vector<string> files;
+		/** Copies of each effect. */
+		int instances;
+		int frames;
+		float delta;
+		/** Overrides every emitter's particle limit, 0 for the authored one. */
+		int maxParticles;
+		/** Keeps every emitter at its particle limit. */
+		bool fill;
+		/** Bursts per emitter and frame at random origins, with its own emission off. 0 for regular emission. */
+		int burstsPerFrame;
+		int burstCount;
+
+		Scenario() :instances(1), frames(600), delta(1 / 60.0f), maxParticles(0), fill(false),
+			burstsPerFrame(0), burstCount(0){}
+	};
+
+	struct Result{
+		string name;
+		int frames;
+		int emitters;
+		long long particleUpdates;
+		long long quads;
+		long long spawned;
+		/** Milliseconds in emission, bursts and particle updates. */
+		double updateTime;
+		/** Milliseconds building quads. */
+		double quadTime;
+		double nsPerParticleUpdate;
+		double nsPerQuad;
+		/** Particles spawned per second of update time. */
+		double spawnsPerSecond;
+		/** Most bytes held by the emitters in any frame; shared definitions are not included. */
+		size_t peakBytes;
+	};
+
+	/** Sizes and iteration counts of the kernel microbenchmarks. */
+	struct KernelOptions{
+		/** Timeline points of the curves given to getScale and getColor. */
+		std::vector<int> timelineSizes;
+		/** Active particles in the quad benchmark. */
+		std::vector<int> particleCounts;
+		/** Calls per timed run; every kernel makes the same number. */
+		int iterations;
+		/** Timed runs per kernel, after one untimed warm-up run. */
+		int repeats;
+
+		KernelOptions() :timelineSizes({ 2, 4, 8, 16, 32 }), particleCounts({ 100, 1000, 10000 }),
+			iterations(1000000), repeats(5){}
+	};
+
+	struct KernelResult{
+		/** The kernel, with its size where it has one, e.g. "getScale/8". */
+		string name;
+		int size;
+		long long iterations;
+		/** Nanoseconds per call in the fastest and the median run. */
+		double nsPerCall;
+		double medianNsPerCall;
+	};
+
+	struct LoadResult{
+		/** The loader, e.g. "text-parser". */
+		string name;
+		int files;
+		/** Definitions loaded per run. */
+		int emitters;
+		/** Milliseconds to load every file once, in the fastest and the median run. */
+		double milliseconds;
+		double medianMilliseconds;
+	};
+
+	/** One huge emitter from the first file, hundreds of small effects and a burst storm. */
+	static std::vector<Scenario> getDefaultScenarios(const std::vector<string>& files);
+
+	static Result run(const Scenario& scenario);
+
+	static std::vector<Result> run(const std::vector<Scenario>& scenarios);
+
+	static string toJson(const std::vector<Result>& results);
+
+	/** Times the per-particle building blocks in isolation: ScaledNumericValue::getScale and
+	* GradientColorValue::getColor per timeline size, RangedNumericValue::newLowValue, activateParticle per
+	* spawn shape, and quad building per particle count. Random draws are seeded, so runs are comparable;
+	* the generator is put back afterwards, so running them does not change later simulations. */
+	static std::vector<KernelResult> runKernels(const KernelOptions& options = KernelOptions());
+
+	static string toJson(const std::vector<KernelResult>& results);
+
+	/** Times reading text effect files into definitions with ParticleTextReader ("text-parser") and with the
+	* line-by-line stream reader it replaced ("stream-reader"), once untimed and then repeats times each. Files
+	* are read into memory up front, so only parsing is timed; binary files are skipped. */
+	static std::vector<LoadResult> runLoaders(const std::vector<string>& files, int repeats = 20);
+
+	/** Times preloading effect files with their images into the ParticleEffectCache from a pack ("pack", opening
+	* it included) and one file at a time as createFromCache does ("loose-files"), once untimed and then repeats
+	* times each. The files are packed into packFile first. Every run starts with none of the files in the effect
+	* cache and their images unloaded from the TextureCache. */
+	static std::vector<LoadResult> runPackLoad(const std::vector<string>& files, const string& packFile, int repeats = 5);
+
+	static string toJson(const std::vector<LoadResult>& results);
+};
+
+NS_CUSTOM_END
+
+#endif
@@ -1,53 +1,163 @@
 #include "ParticleEffect.h"
+#include "ParticleSystemManager.h"
 #include "core/util/GameUtil.h"
+#include <algorithm>
+#include <chrono>
+#include <unordered_set>
 
 USING_NS_CUSTOM;
 
 void NS_CUSTOM::ParticleEffect::init(ParticleEffect* effect)
 {
-	emitters.clear();
-	removeAllChildren();
-	for (auto em : effect->emitters){
-		auto emitter = ParticleEmitter::create();
-		emitter->init(em);
-		emitters.pushBack(emitter);
-		addChild(emitter);
+	if (emitters.size() != effect->emitters.size()){
+		removeAllSubEmitters();
+		emitters.clear();
+		removeAllChildren();
+		for (size_t i = 0; i < effect->emitters.size(); i++){
+			auto emitter = ParticleEmitter::create();
+			emitters.pushBack(emitter);
+			addChild(emitter);
+		}
+	}
+	for (size_t i = 0; i < emitters.size(); i++){
+		emitters.at(i)->init(effect->emitters.at(i));
 	}
+	initSubEmitters(effect);
+	// Copies of a baked effect get a phase of their own.
+	if (isBakedPlayback()) setPlaybackPhase(random(0.0f, getBakedPeriod()));
+	_parseTime = effect->_parseTime;
+	_imageTime = effect->_imageTime;
 }
 
-Map<string, ParticleEffect*> NS_CUSTOM::ParticleEffect::particleCache;
+std::unordered_map<string, cocos2d::Vector<ParticleEffect*>> NS_CUSTOM::ParticleEffect::instancePool;
+std::unordered_map<string, int> NS_CUSTOM::ParticleEffect::poolCapacities;
+int NS_CUSTOM::ParticleEffect::defaultPoolCapacity = 8;
+cocos2d::Vector<ParticleEffect*> NS_CUSTOM::ParticleEffect::completedEffects;
+EventListenerCustom* NS_CUSTOM::ParticleEffect::recycleListener = nullptr;
 
 ParticleEffect* NS_CUSTOM::ParticleEffect::createFromCache(const string name)
 {
-	auto p = particleCache.at(name);
+	auto cache = ParticleEffectCache::getInstance();
+	auto p = cache->get(name);
 	if (p == nullptr){
-		auto tmp = ParticleEffect::create();
-		tmp->loadEmitters(name);
-		tmp->loadEmitterImages(getPathForFilename(name));
-		particleCache.insert(name, tmp);
-		return tmp;
+		auto startTime = std::chrono::steady_clock::now();
+		p = ParticleEffect::create();
+		p->loadEmitters(name);
+		p->loadEmitterImages(getPathForFilename(name));
+		std::chrono::duration<float, std::milli> loadTime = std::chrono::steady_clock::now() - startTime;
+		cache->insert(name, p, loadTime.count());
 	}
 	else{
-		auto tmp = ParticleEffect::create();
-		tmp->init(p);
-		return tmp;
+		auto& pool = instancePool[name];
+		if (!pool.empty()){
+			auto tmp = pool.back();
+			tmp->retain();
+			pool.popBack();
+			tmp->autorelease();
+			return tmp;
+		}
 	}
+	auto tmp = ParticleEffect::create();
+	tmp->init(p);
+	tmp->_cacheName = name;
+	return tmp;
 }
 
 void NS_CUSTOM::ParticleEffect::clearCache()
 {
-	particleCache.clear();
+	ParticleEffectCache::getInstance()->clear();
+	instancePool.clear();
+	ParticleBakedLoop::clearCache();
+}
+
+void NS_CUSTOM::ParticleEffect::setPoolCapacity(int capacity)
+{
+	defaultPoolCapacity = capacity;
+	trimPool(capacity);
+}
+
+void NS_CUSTOM::ParticleEffect::setPoolCapacity(const string& name, int capacity)
+{
+	poolCapacities[name] = capacity;
+	auto& pool = instancePool[name];
+	while ((int)pool.size() > capacity) pool.popBack();
+}
+
+void NS_CUSTOM::ParticleEffect::trimPool(int maxPerName)
+{
+	for (auto& pair : instancePool){
+		while ((int)pair.second.size() > maxPerName) pair.second.popBack();
+	}
+}
+
+int NS_CUSTOM::ParticleEffect::getPooledCount(const string& name)
+{
+	auto it = instancePool.find(name);
+	return it == instancePool.end() ? 0 : (int)it->second.size();
+}
+
+void NS_CUSTOM::ParticleEffect::clearPool(const string& name)
+{
+	instancePool.erase(name);
+}
+
+void NS_CUSTOM::ParticleEffect::recycleCompleted()
+{
+	if (completedEffects.empty()) return;
+	for (auto effect : completedEffects){
+		effect->removeFromParent();
+		// Only park instances nobody else holds on to.
+		if (effect->_cacheName.empty() || effect->getReferenceCount() > 1) continue;
+		if (!ParticleEffectCache::getInstance()->peek(effect->_cacheName)) continue;
+		auto it = poolCapacities.find(effect->_cacheName);
+		int capacity = it == poolCapacities.end() ? defaultPoolCapacity : it->second;
+		auto& pool = instancePool[effect->_cacheName];
+		if ((int)pool.size() >= capacity) continue;
+		effect->recycle();
+		pool.pushBack(effect);
+	}
+	completedEffects.clear();
+}
+
+void NS_CUSTOM::ParticleEffect::recycle()
+{
+	auto p = ParticleEffectCache::getInstance()->peek(_cacheName);
+	if (p) init(p);
+	_completeListener = nullptr;
+	_freeMode = false;
+	_priority = 0;
+	_throttle = 1;
+	_lod.screenSize = _lod.distance = 0;
+	_lowDetail = false;
+	applyDetail();
+	setHiddenMode(HiddenMode::SIMULATE);
+	_hiddenTime = 0;
+	_burstHost = false;
+	removeAllAffectors();
+	Node::setPosition(0, 0);
+	setScale(1);
+	setRotation(0);
+	setVisible(true);
+}
+
+NS_CUSTOM::ParticleEffect::~ParticleEffect()
+{
+	ParticleSystemManager::getInstance()->remove(this);
+	for (auto& subEmitter : _subEmitters)
+		CC_SAFE_RELEASE(subEmitter.prototype);
 }
 
 void ParticleEffect::start()
 {
-	scheduleUpdate();
+	ParticleSystemManager::getInstance()->add(this);
+	stopSubEmitters();
 	for (auto emitter : emitters)
 		emitter->start();
 }
 
 void ParticleEffect::reset()
 {
+	stopSubEmitters();
 	for (auto emitter : emitters)
 		emitter->reset();
 }
@@ -57,33 +167,206 @@ void NS_CUSTOM::ParticleEffect::setCompleteListener(completeListener listener)
 	_completeListener = listener;
 }
 
+void ParticleEffect::startBursts()
+{
+	_burstHost = true;
+	start();
+	for (auto emitter : emitters)
+		emitter->setEmitting(false);
+}
+
+void ParticleEffect::burstAt(float x, float y, int count, const ParticleEmitter::BurstParams& params)
+{
+	if (_managerIndex < 0) startBursts();
+	for (auto emitter : emitters)
+		emitter->burst(x, y, count, params);
+}
+
 void ParticleEffect::update(float delta)
 {
+	PARTICLE_TRACE("ParticleEffect::update");
+	if (_hiddenMode != HiddenMode::SIMULATE && !isShown()){
+		_hiddenTime += delta;
+		return;
+	}
+	if (_hiddenTime > 0){
+		if (_hiddenMode == HiddenMode::FAST_FORWARD) fastForward(std::min(_hiddenTime, _maxCatchUp));
+		_hiddenTime = 0;
+	}
 	if (_freeMode){
 		const Vec2& pos = convertToWorldSpace(Vec2::ZERO);
-		for (auto emitter : emitters){
+		forEachEmitter([&](ParticleEmitter* emitter){
 			emitter->translate(pos.x - _lastWorldX, pos.y - _lastWorldY);
-		}
+		});
 		_lastWorldX = pos.x;
 		_lastWorldY = pos.y;
 	}
+	if (_lod.screenSize > 0 || _lod.distance > 0) updateLod(delta);
+	if (_lowDetail && _lod.updateInterval > 0){
+		_lodElapsed += delta;
+		if (_lodElapsed < _lod.updateInterval){
+			for (auto emitter : emitters)
+				emitter->extrapolate(_lodElapsed);
+			for (auto& subEmitter : _subEmitters){
+				for (auto child : subEmitter.running)
+					child->extrapolate(_lodElapsed);
+			}
+			return;
+		}
+		delta = _lodElapsed;
+		_lodElapsed = 0;
+	}
 	for (auto emitter : emitters){
 		emitter->update(delta);
 	}
+	if (!_subEmitters.empty()) updateSubEmitters(delta, false);
 	if (isComplete()){
+		ParticleSystemManager::getInstance()->remove(this);
 		if (_completeListener) _completeListener();
-		removeFromParent();
+		if (!recycleListener){
+			recycleListener = Director::getInstance()->getEventDispatcher()->addCustomEventListener(
+				Director::EVENT_AFTER_UPDATE, [](EventCustom*){ recycleCompleted(); });
+		}
+		completedEffects.pushBack(this);
 	}
 }
 
-void ParticleEffect::allowCompletion()
+void ParticleEffect::cleanup()
+{
+	ParticleSystemManager::getInstance()->remove(this);
+	Node::cleanup();
+}
+
+void ParticleEffect::pause()
+{
+	Node::pause();
+	_paused = true;
+}
+
+void ParticleEffect::resume()
+{
+	Node::resume();
+	_paused = false;
+}
+
+bool ParticleEffect::isShown()
+{
+	for (Node* node = this; node; node = node->getParent()){
+		if (!node->isVisible()) return false;
+	}
+	return true;
+}
+
+void ParticleEffect::fastForward(float time)
+{
+	// Coarse steps: nothing is drawn in between, only emission and ageing need to come out right.
+	static const float FAST_FORWARD_STEP = 0.1f;
+	while (time > 0){
+		float step = std::min(time, FAST_FORWARD_STEP);
+		for (auto emitter : emitters)
+			emitter->simulate(step);
+		if (!_subEmitters.empty()) updateSubEmitters(step, true);
+		time -= step;
+	}
+}
+
+int ParticleEffect::getActiveCount()
 {
+	int count = 0;
 	for (auto emitter : emitters)
+		count += emitter->getActiveCount();
+	for (auto& subEmitter : _subEmitters){
+		for (auto child : subEmitter.running)
+			count += child->getActiveCount();
+	}
+	return count;
+}
+
+void ParticleEffect::setThrottle(float throttle)
+{
+	throttle = std::min(std::max(throttle, 0.0f), 1.0f);
+	if (_throttle == throttle) return;
+	_throttle = throttle;
+	float scale = _lowDetail ? _lod.emissionScale : 1;
+	forEachEmitter([&](ParticleEmitter* emitter){
+		emitter->setThrottle(throttle * scale);
+	});
+}
+
+void ParticleEffect::setLodSettings(const LodSettings& settings)
+{
+	_lod = settings;
+	_lodTimer = 0;
+	if (_lod.screenSize <= 0 && _lod.distance <= 0 && _lowDetail){
+		_lowDetail = false;
+		applyDetail();
+	}
+}
+
+void ParticleEffect::applyDetail()
+{
+	int disabled = 0;
+	if (_lowDetail && _lod.disableRotation) disabled |= ParticleEmitter::UPDATE_ROTATION;
+	if (_lowDetail && _lod.disableTint) disabled |= ParticleEmitter::UPDATE_TINT;
+	bool interpolate = _lowDetail && _lod.updateInterval > 0;
+	float throttle = _throttle * (_lowDetail ? _lod.emissionScale : 1);
+	forEachEmitter([&](ParticleEmitter* emitter){
+		emitter->setThrottle(throttle);
+		emitter->setDisabledUpdates(disabled);
+		emitter->setMotionTracking(interpolate);
+	});
+	_lodElapsed = 0;
+}
+
+void ParticleEffect::updateLod(float delta)
+{
+	// How far away and how big the effect is changes slowly, checking a few times a second is enough.
+	static const float LOD_CHECK_INTERVAL = 0.25f;
+	// Returning to full detail needs a margin, so effects near a threshold do not flip every check.
+	static const float LOD_HYSTERESIS = 1.1f;
+
+	_lodTimer -= delta;
+	if (_lodTimer > 0) return;
+	_lodTimer = LOD_CHECK_INTERVAL;
+
+	bool small = false, far = false;
+	float margin = _lowDetail ? LOD_HYSTERESIS : 1;
+	if (_lod.screenSize > 0){
+		auto& box = getBoundingBox();
+		// No live particles says nothing about the size, keep the current level.
+		if (box.max.x < box.min.x) small = _lowDetail;
+		else{
+			const Mat4& transform = getNodeToWorldTransform();
+			float worldScale = std::sqrt(std::abs(transform.m[0] * transform.m[5] - transform.m[1] * transform.m[4]));
+			float size = std::max(box.max.x - box.min.x, box.max.y - box.min.y) * worldScale;
+			small = size < _lod.screenSize * margin;
+		}
+	}
+	if (_lod.distance > 0){
+		auto camera = Camera::getDefaultCamera();
+		if (camera){
+			const Vec2& pos = convertToWorldSpace(Vec2::ZERO);
+			far = camera->getPosition3D().distance(Vec3(pos.x, pos.y, 0)) > _lod.distance / margin;
+		}
+	}
+	bool lowDetail = small || far;
+	if (lowDetail != _lowDetail){
+		_lowDetail = lowDetail;
+		applyDetail();
+	}
+}
+
+void ParticleEffect::allowCompletion()
+{
+	setBakedPlayback(false);
+	forEachEmitter([](ParticleEmitter* emitter){
 		emitter->allowCompletion();
+	});
 }
 
 bool ParticleEffect::isComplete()
 {
+	if (_burstHost || _descendantCount > 0) return false;
 	for (auto emitter : emitters) {
 		if (!emitter->isComplete()) return false;
 	}
@@ -92,30 +375,36 @@ bool ParticleEffect::isComplete()
 
 void ParticleEffect::setDuration(int duration)
 {
-	for (auto emitter : emitters) {
+	setBakedPlayback(false);
+	forEachEmitter([&](ParticleEmitter* emitter){
 		emitter->setContinuous(false);
 		emitter->duration = duration;
 		emitter->durationTimer = 0;
-	}
+	});
 }
 
 void ParticleEffect::setPosition(float x, float y)
 {
 	Node::setPosition(x, y);
-	for (auto emitter : emitters)
+	forEachEmitter([&](ParticleEmitter* emitter){
 		emitter->setPosition(x, y);
+	});
 }
 
 void ParticleEffect::setFlip(bool flipX, bool flipY)
 {
-	for (auto emitter : emitters)
+	forEachEmitter([&](ParticleEmitter* emitter){
 		emitter->setFlip(flipX, flipY);
+	});
+	for (auto& subEmitter : _subEmitters)
+		subEmitter.prototype->setFlip(flipX, flipY);
 }
 
 void ParticleEffect::flipY()
 {
-	for (auto emitter : emitters)
+	for (auto emitter : getTemplateEmitters())
 		emitter->flipY();
+	refreshSubEmitters();
 }
 
 void NS_CUSTOM::ParticleEffect::setFreeMode(bool isFree)
@@ -131,42 +420,133 @@ void NS_CUSTOM::ParticleEffect::setFreeMode(bool isFree)
 
 ParticleEmitter* ParticleEffect::findEmitter(string name)
 {
-	for (auto emitter : emitters) {
+	for (auto emitter : getTemplateEmitters()) {
 		if (emitter->getName() == name) return emitter;
 	}
 	return nullptr;
 }
 
-void ParticleEffect::save(ostream& output)
+bool ParticleEffect::save(ostream& output)
 {
+	if (!_subEmitters.empty()) {
+		CCLOG("ParticleEffect::save: effect files cannot hold sub-emitters; save the effect before adding them");
+		return false;
+	}
 	int index = 0;
 	for (auto emitter : emitters) {
 		if (index++ > 0) output << "\n\n";
 		emitter->save(output);
 	}
+	return true;
 }
 
 void ParticleEffect::loadEmitters(string file)
+{
+	PARTICLE_TRACE("ParticleEffect::loadEmitters");
+	auto startTime = std::chrono::steady_clock::now();
+	std::vector<EmitterDefinition*> definitions;
+	auto effectFile = EffectFile::open(FileUtils::getInstance()->fullPathForFilename(file));
+	if (effectFile){
+		readDefinitions(effectFile, definitions);
+		effectFile->release();
+	}
+	std::chrono::duration<float, std::milli> parseTime = std::chrono::steady_clock::now() - startTime;
+	initWithDefinitions(definitions);
+	addLoadTime(parseTime.count(), 0);
+	for (auto definition : definitions)
+		definition->release();
+}
+
+void ParticleEffect::initWithDefinitions(const std::vector<EmitterDefinition*>& definitions)
 {
 	emitters.clear();
 	removeAllChildren();
-	string str = FileUtils::getInstance()->getStringFromFile(file);
-	std::istringstream iss(str);
-	string line;
-	while (true) {
+	for (auto definition : definitions) {
 		auto emitter = ParticleEmitter::create();
-		emitter->load(iss);
+		emitter->init(definition);
 		emitters.pushBack(emitter);
 		addChild(emitter);
-		getline(iss, line);
-		if (iss.eof()) break;
-		getline(iss, line);
-		if (iss.eof()) break;
 	}
 }
 
+void ParticleEffect::readDefinitions(const string& content, std::vector<EmitterDefinition*>& definitions)
+{
+	if (parseDefinitions(content.data(), content.size(), definitions)) return;
+	std::istringstream iss(content);
+	readDefinitions(iss, definitions);
+}
+
+void ParticleEffect::readDefinitions(istream& input, std::vector<EmitterDefinition*>& definitions)
+{
+	string line;
+	while (true) {
+		auto definition = new EmitterDefinition();
+		definition->load(input);
+		definitions.push_back(definition);
+		getline(input, line);
+		if (input.eof()) break;
+		getline(input, line);
+		if (input.eof()) break;
+	}
+}
+
+void ParticleEffect::readDefinitions(EffectFile* file, std::vector<EmitterDefinition*>& definitions)
+{
+	readDefinitions(file, file->getData(), file->getSize(), definitions);
+}
+
+void ParticleEffect::readDefinitions(EffectFile* file, const char* data, size_t size, std::vector<EmitterDefinition*>& definitions)
+{
+	if (ParticleEffectBinary::isBinary(data, size)){
+		if (!ParticleEffectBinary::read(file, data, size, definitions))
+			CCLOG("ParticleEffect: corrupt binary effect file");
+		return;
+	}
+	if (!parseDefinitions(data, size, definitions)) {
+		std::istringstream iss(string(data, size));
+		readDefinitions(iss, definitions);
+	}
+}
+
+bool ParticleEffect::parseDefinitions(const char* data, size_t size, std::vector<EmitterDefinition*>& definitions)
+{
+	ParticleTextReader reader(data, size);
+	size_t first = definitions.size();
+	while (true) {
+		auto definition = new EmitterDefinition();
+		definitions.push_back(definition);
+		if (!definition->load(reader)) {
+			for (size_t i = first; i < definitions.size(); i++)
+				definitions[i]->release();
+			definitions.resize(first);
+			return false;
+		}
+		if (!reader.skipLine()) break;
+		if (!reader.skipLine()) break;
+	}
+	return true;
+}
+
+void ParticleEffect::loadEmitterImages(string path, ParticleEffectPack* pack)
+{
+	PARTICLE_TRACE("ParticleEffect::loadEmitterImages");
+	auto startTime = std::chrono::steady_clock::now();
+	ownsTexture = true;
+	for (auto emitter : emitters){
+		string imagePath = emitter->getImagePath();
+		if (imagePath.empty()) continue;
+		auto texture = pack->getTexture(path + imagePath);
+		auto sprite = texture ? Sprite::createWithTexture(texture) : createSprite(path + imagePath);
+		emitter->setSprite(sprite);
+	}
+	std::chrono::duration<float, std::milli> imageTime = std::chrono::steady_clock::now() - startTime;
+	addLoadTime(0, imageTime.count());
+}
+
 void ParticleEffect::loadEmitterImages(string path)
 {
+	PARTICLE_TRACE("ParticleEffect::loadEmitterImages");
+	auto startTime = std::chrono::steady_clock::now();
 	ownsTexture = true;
 	for (auto emitter : emitters){
 		string imagePath = emitter->getImagePath();
@@ -174,6 +554,31 @@ void ParticleEffect::loadEmitterImages(string path)
 		auto sprite = createSprite(path + imagePath);
 		emitter->setSprite(sprite);
 	}
+	std::chrono::duration<float, std::milli> imageTime = std::chrono::steady_clock::now() - startTime;
+	addLoadTime(0, imageTime.count());
+}
+
+ParticleStats ParticleEffect::getStats()
+{
+	ParticleStats stats;
+	for (auto emitter : emitters)
+		stats.add(emitter->getStats());
+	for (auto& subEmitter : _subEmitters){
+		for (auto child : subEmitter.pool)
+			stats.add(child->getStats());
+	}
+	stats.parseTime = _parseTime;
+	stats.imageTime = _imageTime;
+	return stats;
+}
+
+void ParticleEffect::addLoadTime(float parseTime, float imageTime)
+{
+	_parseTime += parseTime;
+	_imageTime += imageTime;
+	auto registry = ParticleStatsRegistry::getInstance();
+	if (parseTime > 0) registry->addParseTime(parseTime);
+	if (imageTime > 0) registry->addImageTime(imageTime);
 }
 
 BoundingBox& ParticleEffect::getBoundingBox()
@@ -181,12 +586,16 @@ BoundingBox& ParticleEffect::getBoundingBox()
 	bounds.inf();
 	for (auto emitter : emitters)
 		bounds.ext(emitter->getBoundingBox());
+	for (auto& subEmitter : _subEmitters){
+		for (auto child : subEmitter.running)
+			bounds.ext(child->getBoundingBox());
+	}
 	return bounds;
 }
 
 void ParticleEffect::scaleEffect(float scaleFactor)
 {
-	for (auto particleEmitter : emitters) {
+	for (auto particleEmitter : getTemplateEmitters()) {
 		particleEmitter->getScale().setHigh(particleEmitter->getScale().getHighMin() * scaleFactor,
 			particleEmitter->getScale().getHighMax() * scaleFactor);
 		particleEmitter->getScale().setLow(particleEmitter->getScale().getLowMin() * scaleFactor,
@@ -223,11 +632,383 @@ void ParticleEffect::scaleEffect(float scaleFactor)
 		particleEmitter->getYOffsetValue().setLow(particleEmitter->getYOffsetValue().getLowMin() * scaleFactor,
 			particleEmitter->getYOffsetValue().getLowMax() * scaleFactor);
 	}
+	refreshSubEmitters();
+}
+
+void ParticleEffect::addAffector(ParticleAffector* affector)
+{
+	forEachEmitter([&](ParticleEmitter* emitter){
+		emitter->addAffector(affector);
+	});
+}
+
+void ParticleEffect::removeAffector(ParticleAffector* affector)
+{
+	forEachEmitter([&](ParticleEmitter* emitter){
+		emitter->removeAffector(affector);
+	});
+}
+
+void ParticleEffect::removeAllAffectors()
+{
+	forEachEmitter([&](ParticleEmitter* emitter){
+		while (!emitter->getAffectors().empty())
+			emitter->removeAffector(emitter->getAffectors().back());
+	});
+}
+
+bool ParticleEffect::setBakedPlayback(bool baked, size_t maxBytes)
+{
+	if (!baked){
+		for (auto emitter : emitters)
+			emitter->setBakedLoop(nullptr);
+		return true;
+	}
+	if (emitters.empty() || _burstHost || !_subEmitters.empty()) return false;
+	std::vector<ParticleBakedLoop*> loops;
+	for (auto emitter : emitters){
+		auto loop = emitter->getAffectors().empty() ? ParticleBakedLoop::getOrBake(emitter, maxBytes) : nullptr;
+		if (!loop) return false;
+		loops.push_back(loop);
+	}
+	for (size_t i = 0; i < loops.size(); i++)
+		emitters.at(i)->setBakedLoop(loops[i]);
+	setPlaybackPhase(random(0.0f, getBakedPeriod()));
+	return true;
+}
+
+bool ParticleEffect::isBakedPlayback() const
+{
+	// Emitters are baked all together or not at all.
+	return !emitters.empty() && emitters.at(0)->getBakedLoop();
+}
+
+void ParticleEffect::setPlaybackPhase(float seconds)
+{
+	// One phase for every emitter keeps them in step with each other, as when simulated.
+	for (auto emitter : emitters)
+		emitter->setBakedPhase(seconds);
+}
+
+float ParticleEffect::getBakedPeriod()
+{
+	float period = 0;
+	for (auto emitter : emitters){
+		if (emitter->getBakedLoop()) period = std::max(period, emitter->getBakedLoop()->getPeriod());
+	}
+	return period;
+}
+
+void ParticleEffect::forEachEmitter(const std::function<void(ParticleEmitter*)>& function)
+{
+	for (auto emitter : emitters)
+		function(emitter);
+	for (auto& subEmitter : _subEmitters){
+		for (auto child : subEmitter.pool)
+			function(child);
+	}
+}
+
+bool ParticleEffect::addSubEmitter(const string& parent, const string& child, SubEmitterTrigger trigger, int poolSize)
+{
+	int parentEmitter = -1, parentSubEmitter = -1;
+	for (int i = 0; i < (int)emitters.size() && parentEmitter < 0; i++){
+		if (emitters.at(i)->getName() == parent) parentEmitter = i;
+	}
+	for (int i = 0; i < (int)_subEmitters.size() && parentEmitter < 0 && parentSubEmitter < 0; i++){
+		if (_subEmitters[i].prototype->getName() == parent) parentSubEmitter = i;
+	}
+	// The child is taken out of the emitters the first time, later sub-emitters share its prototype.
+	ParticleEmitter* prototype = nullptr;
+	for (auto& subEmitter : _subEmitters){
+		if (subEmitter.prototype->getName() == child) prototype = subEmitter.prototype;
+	}
+	int childIndex = -1;
+	for (int i = 0; i < (int)emitters.size() && !prototype; i++){
+		if (emitters.at(i)->getName() == child) childIndex = i;
+	}
+	if (parentEmitter < 0 && parentSubEmitter < 0) return false;
+	if (!prototype && (childIndex < 0 || childIndex == parentEmitter)) return false;
+
+	if (childIndex >= 0){
+		prototype = emitters.at(childIndex);
+		prototype->retain();
+		removeChild(prototype);
+		emitters.erase(childIndex);
+		if (parentEmitter > childIndex) parentEmitter--;
+		for (auto& subEmitter : _subEmitters){
+			if (subEmitter.parentEmitter > childIndex) subEmitter.parentEmitter--;
+		}
+		// Still retained by this call; the sub-emitter's reference follows.
+		addSubEmitter(parentEmitter, parentSubEmitter, prototype, trigger, poolSize);
+		prototype->release();
+	}
+	else addSubEmitter(parentEmitter, parentSubEmitter, prototype, trigger, poolSize);
+	return true;
+}
+
+void ParticleEffect::addSubEmitter(int parentEmitter, int parentSubEmitter, ParticleEmitter* prototype,
+	SubEmitterTrigger trigger, int poolSize)
+{
+	SubEmitter subEmitter;
+	subEmitter.parentEmitter = parentEmitter;
+	subEmitter.parentSubEmitter = parentSubEmitter;
+	subEmitter.trigger = trigger;
+	subEmitter.prototype = prototype;
+	prototype->retain();
+	auto& affectors = emitters.empty() ? prototype->getAffectors() : emitters.at(0)->getAffectors();
+	float throttle = _throttle * (_lowDetail ? _lod.emissionScale : 1);
+	for (int i = 0; i < poolSize; i++){
+		auto child = ParticleEmitter::create();
+		child->init(prototype);
+		child->setContinuous(false);
+		child->setThrottle(throttle);
+		child->setVisible(false);
+		for (auto affector : affectors)
+			child->addAffector(affector);
+		subEmitter.pool.pushBack(child);
+		subEmitter.idle.push_back(child);
+		addChild(child);
+	}
+	_subEmitters.push_back(subEmitter);
+	updateRecordedEvents();
+}
+
+void ParticleEffect::removeAllSubEmitters()
+{
+	for (auto& subEmitter : _subEmitters){
+		for (auto child : subEmitter.pool)
+			removeChild(child);
+		CC_SAFE_RELEASE(subEmitter.prototype);
+	}
+	_subEmitters.clear();
+	_descendantCount = 0;
+	updateRecordedEvents();
+}
+
+void ParticleEffect::initSubEmitters(ParticleEffect* effect)
+{
+	bool same = _subEmitters.size() == effect->_subEmitters.size();
+	for (size_t i = 0; i < _subEmitters.size() && same; i++){
+		auto& subEmitter = _subEmitters[i];
+		auto& other = effect->_subEmitters[i];
+		same = subEmitter.parentEmitter == other.parentEmitter && subEmitter.parentSubEmitter == other.parentSubEmitter
+			&& subEmitter.trigger == other.trigger && subEmitter.pool.size() == other.pool.size();
+	}
+	if (!same){
+		removeAllSubEmitters();
+		for (auto& other : effect->_subEmitters){
+			auto prototype = ParticleEmitter::create();
+			prototype->init(other.prototype);
+			addSubEmitter(other.parentEmitter, other.parentSubEmitter, prototype, other.trigger, (int)other.pool.size());
+		}
+		return;
+	}
+	for (size_t i = 0; i < _subEmitters.size(); i++)
+		_subEmitters[i].prototype->init(effect->_subEmitters[i].prototype);
+	refreshSubEmitters();
+}
+
+std::vector<ParticleEmitter*> ParticleEffect::getTemplateEmitters()
+{
+	std::vector<ParticleEmitter*> all(emitters.begin(), emitters.end());
+	for (auto& subEmitter : _subEmitters)
+		all.push_back(subEmitter.prototype);
+	return all;
+}
+
+void ParticleEffect::refreshSubEmitters()
+{
+	if (_subEmitters.empty()) return;
+	stopSubEmitters();
+	float throttle = _throttle * (_lowDetail ? _lod.emissionScale : 1);
+	for (auto& subEmitter : _subEmitters){
+		for (auto child : subEmitter.pool){
+			child->init(subEmitter.prototype);
+			child->setContinuous(false);
+			child->setThrottle(throttle);
+		}
+	}
+	updateRecordedEvents();
+}
+
+static int getTriggerEvent(ParticleEffect::SubEmitterTrigger trigger)
+{
+	if (trigger == ParticleEffect::SubEmitterTrigger::BIRTH) return ParticleEmitter::EVENT_BIRTH;
+	return ParticleEmitter::EVENT_DEATH;
+}
+
+void ParticleEffect::updateRecordedEvents()
+{
+	std::vector<int> emitterEvents(emitters.size(), 0), subEmitterEvents(_subEmitters.size(), 0);
+	for (auto& subEmitter : _subEmitters){
+		int event = getTriggerEvent(subEmitter.trigger);
+		if (subEmitter.parentEmitter >= 0) emitterEvents[subEmitter.parentEmitter] |= event;
+		else subEmitterEvents[subEmitter.parentSubEmitter] |= event;
+	}
+	for (size_t i = 0; i < emitters.size(); i++){
+		emitters.at(i)->setRecordedEvents(emitterEvents[i]);
+		emitters.at(i)->clearEvents();
+	}
+	for (size_t i = 0; i < _subEmitters.size(); i++){
+		for (auto child : _subEmitters[i].pool){
+			child->setRecordedEvents(subEmitterEvents[i]);
+			child->clearEvents();
+		}
+	}
+}
+
+void ParticleEffect::updateSubEmitters(float delta, bool simulateOnly)
+{
+	// Children started here run from the next update, so one cascade level is added per frame at most.
+	for (size_t i = 0; i < _subEmitters.size(); i++){
+		auto& running = _subEmitters[i].running;
+		for (size_t j = 0; j < running.size(); j++){
+			if (simulateOnly) running[j]->simulate(delta);
+			else running[j]->update(delta);
+		}
+	}
+	for (size_t i = 0; i < emitters.size(); i++){
+		auto emitter = emitters.at(i);
+		if (emitter->getRecordedEvents() != 0) startSubEmitters(emitter, (int)i, -1);
+	}
+	for (size_t i = 0; i < _subEmitters.size(); i++){
+		// Indexed, as starting children may add to this running list.
+		auto& running = _subEmitters[i].running;
+		size_t count = running.size();
+		for (size_t j = 0; j < count; j++){
+			if (running[j]->getRecordedEvents() != 0) startSubEmitters(running[j], -1, (int)i);
+		}
+	}
+	for (auto& subEmitter : _subEmitters){
+		auto& running = subEmitter.running;
+		for (size_t j = 0; j < running.size();){
+			auto child = running[j];
+			if (!child->isComplete()){
+				j++;
+				continue;
+			}
+			child->setVisible(false);
+			subEmitter.idle.push_back(child);
+			running[j] = running.back();
+			running.pop_back();
+			_descendantCount--;
+		}
+	}
+}
+
+void ParticleEffect::startSubEmitters(ParticleEmitter* parent, int parentEmitter, int parentSubEmitter)
+{
+	auto& events = parent->getEvents();
+	for (auto& subEmitter : _subEmitters){
+		if (subEmitter.parentEmitter != parentEmitter || subEmitter.parentSubEmitter != parentSubEmitter) continue;
+		int type = getTriggerEvent(subEmitter.trigger);
+		for (auto& event : events){
+			if (event.type != type) continue;
+			// Events beyond the cap or the pool are dropped, so a cascade stays bounded.
+			if (_descendantCount >= _maxDescendants || subEmitter.idle.empty()) break;
+			auto child = subEmitter.idle.back();
+			subEmitter.idle.pop_back();
+			child->reset();
+			child->setSpawnPoint(event.x, event.y);
+			child->setVisible(true);
+			subEmitter.running.push_back(child);
+			_descendantCount++;
+		}
+	}
+	parent->clearEvents();
+}
+
+void ParticleEffect::stopSubEmitters()
+{
+	for (auto& subEmitter : _subEmitters){
+		for (auto child : subEmitter.running){
+			child->reset();
+			child->setVisible(false);
+			subEmitter.idle.push_back(child);
+		}
+		subEmitter.running.clear();
+		for (auto child : subEmitter.pool)
+			child->clearEvents();
+	}
+	for (auto emitter : emitters)
+		emitter->clearEvents();
+	_descendantCount = 0;
+}
+
+size_t ParticleEffect::getMemorySize()
+{
+	return getMemoryUsage().total();
+}
+
+ParticleMemoryUsage ParticleEffect::getMemoryUsage()
+{
+	ParticleMemoryUsage usage;
+	std::unordered_set<const void*> counted;
+	addMemoryUsage(usage, counted);
+	return usage;
+}
+
+void ParticleEffect::addMemoryUsage(ParticleMemoryUsage& usage, std::unordered_set<const void*>& counted)
+{
+	usage.state += sizeof(ParticleEffect);
+	std::vector<ParticleEmitter*> all(emitters.begin(), emitters.end());
+	for (auto& subEmitter : _subEmitters){
+		all.push_back(subEmitter.prototype);
+		all.insert(all.end(), subEmitter.pool.begin(), subEmitter.pool.end());
+	}
+	for (auto emitter : all){
+		usage.add(emitter->getMemoryUsage());
+		auto loop = emitter->getBakedLoop();
+		if (loop && counted.insert(loop).second) usage.bakedLoops += loop->getMemorySize();
+		auto definition = emitter->getDefinition();
+		if (counted.insert(definition).second) usage.add(definition->getMemoryUsage());
+		auto sprite = emitter->getSprite();
+		auto texture = sprite ? sprite->getTexture() : nullptr;
+		if (texture && counted.insert(texture).second)
+			usage.textures += texture->getPixelsWide() * texture->getPixelsHigh() * texture->getBitsPerPixelForFormat() / 8;
+	}
+}
+
+ParticleMemoryUsage ParticleEffect::getTotalMemoryUsage()
+{
+	ParticleMemoryUsage usage;
+	std::unordered_set<const void*> counted;
+	auto add = [&](ParticleEffect* effect){
+		if (effect && counted.insert(effect).second) effect->addMemoryUsage(usage, counted);
+	};
+	for (auto effect : ParticleSystemManager::getInstance()->getEffects())
+		add(effect);
+	for (auto effect : completedEffects)
+		add(effect);
+	for (auto& pair : instancePool){
+		for (auto effect : pair.second)
+			add(effect);
+	}
+
+	// Prototypes come last, so definitions and textures shared with instances count as theirs.
+	for (auto effect : ParticleEffectCache::getInstance()->getEffects()){
+		if (!counted.insert(effect).second) continue;
+		ParticleMemoryUsage prototype;
+		effect->addMemoryUsage(prototype, counted);
+		usage.curves += prototype.curves;
+		usage.textures += prototype.textures;
+		usage.cachePrototypes += prototype.total() - prototype.curves - prototype.textures;
+	}
+
+	for (auto loop : ParticleBakedLoop::getCachedLoops()){
+		if (counted.insert(loop).second) usage.bakedLoops += loop->getMemorySize();
+	}
+
+	auto pool = ParticleBufferPool::getInstance();
+	usage.indices += pool->getIndexBufferSize();
+	usage.glBuffers += pool->getPooledBufferSize();
+	return usage;
 }
 
 void ParticleEffect::setEmittersCleanUpBlendFunction(bool cleanUpBlendFunction)
 {
-	for (auto emitter : emitters) {
+	forEachEmitter([&](ParticleEmitter* emitter){
 		emitter->setCleansUpBlendFunction(cleanUpBlendFunction);
-	}
+	});
 }
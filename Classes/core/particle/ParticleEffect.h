@@ -4,8 +4,17 @@
 #include <string>
 #include <iostream>
 #include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <functional>
 #include "cocos2d.h"
 #include "ParticleEmitter.h"
+#include "ParticleAffector.h"
+#include "ParticleBakedLoop.h"
+#include "ParticleEffectCache.h"
+#include "ParticleEffectBinary.h"
+#include "ParticleEffectPack.h"
 #include "core/util/GameDefine.h"
 
 USING_NS_CC;
@@ -15,9 +24,64 @@ NS_CUSTOM_BEGIN
 
 
 class ParticleEffect :public Node{
+public:
+	/** Level of detail. The effect runs at low detail while it covers fewer than screenSize points on screen
+	* or is further than distance from the camera; 0 turns a test off. Definitions are not changed. */
+	struct LodSettings{
+		float screenSize;
+		float distance;
+		/** Scale of emission and the particle limit at low detail. */
+		float emissionScale;
+		/** Seconds between simulation steps at low detail, 0 for every frame. Particles are moved along their
+		* last motion in between. */
+		float updateInterval;
+		bool disableRotation;
+		bool disableTint;
+	};
+
+	/** What an effect does while it or one of its ancestors is invisible. */
+	enum class HiddenMode{
+		/** Keeps simulating as if visible. */
+		SIMULATE,
+		/** Stops, and continues where it stopped once shown. */
+		PAUSE,
+		/** Stops, and once shown catches up on the hidden time in coarse steps without drawing them. */
+		FAST_FORWARD
+	};
+
+	/** Bytes each emitter's baked loop may take by default, see setBakedPlayback(). */
+	static const size_t DEFAULT_BAKED_BYTES = 256 * 1024;
+
+	/** What starts a sub-emitter. */
+	enum class SubEmitterTrigger{
+		BIRTH,
+		DEATH
+	};
 private:
-	//
-	static Map<string, ParticleEffect*>particleCache;
+	friend class ParticleSystemManager;
+	friend class ParticleBenchmark;
+
+	/** Children started at the particles of one parent, from a pool created up front. */
+	struct SubEmitter{
+		/** The parent: one of the emitters, or the children of another sub-emitter. The other index is -1. */
+		int parentEmitter;
+		int parentSubEmitter;
+		SubEmitterTrigger trigger;
+		/** The child as loaded, taken out of the emitters. Retained. The pool shares its definition. */
+		ParticleEmitter* prototype;
+		/** Added as this effect's children back to back, so their draws batch. */
+		cocos2d::Vector<ParticleEmitter*> pool;
+		std::vector<ParticleEmitter*> running;
+		std::vector<ParticleEmitter*> idle;
+	};
+
+	/** Completed instances parked for reuse, by effect name. */
+	static std::unordered_map<string, cocos2d::Vector<ParticleEffect*>> instancePool;
+	static std::unordered_map<string, int> poolCapacities;
+	static int defaultPoolCapacity;
+	/** Instances that completed this frame, removed and parked in one step after the scheduler update. */
+	static cocos2d::Vector<ParticleEffect*> completedEffects;
+	static EventListenerCustom* recycleListener;
 	cocos2d::Vector<ParticleEmitter*> emitters;
 	BoundingBox bounds;
 	bool ownsTexture;
@@ -26,12 +90,114 @@ private:
 	completeListener _completeListener;
 	bool _freeMode;
 	float _lastWorldX, _lastWorldY;
+	string _cacheName;
+	/** Slot in the ParticleSystemManager while started, -1 otherwise. */
+	int _managerIndex;
+	bool _paused;
+	int _priority;
+	float _throttle;
+	LodSettings _lod;
+	bool _lowDetail;
+	float _lodTimer;	// seconds until the level is checked again
+	float _lodElapsed;	// seconds not yet simulated at low detail
+	float _pendingDelta;	// seconds the manager deferred while over its amortized budget
+	HiddenMode _hiddenMode;
+	float _maxCatchUp;
+	float _hiddenTime;	// seconds spent hidden, caught up on when shown
+	bool _burstHost;
+	float _parseTime, _imageTime;	// milliseconds spent loading, copied from the prototype
+	std::vector<SubEmitter> _subEmitters;
+	int _maxDescendants;
+	int _descendantCount;	// running sub-emitter children
+
+	/** Restores the state createFromCache hands out, reusing the existing emitters. */
+	void recycle();
+
+	/** Line-by-line reader for text that parseDefinitions rejects. */
+	static void readDefinitions(istream& input, std::vector<EmitterDefinition*>& definitions);
+
+	/** Effects with equal keys share definitions and are updated next to each other. */
+	const void* getGroupKey() const {
+		return emitters.empty() ? nullptr : emitters.at(0)->getDefinition();
+	}
+
+	void setThrottle(float throttle);
+
+	/** Passes the throttle and the level of detail on to the emitters. */
+	void applyDetail();
+
+	void updateLod(float delta);
+
+	/** Whether this node and all its ancestors are visible. */
+	bool isShown();
+
+	void fastForward(float time);
+
+	/** Adds a sub-emitter running copies of prototype, which it retains. */
+	void addSubEmitter(int parentEmitter, int parentSubEmitter, ParticleEmitter* prototype, SubEmitterTrigger trigger,
+		int poolSize);
+
+	/** Returns the emitters followed by the sub-emitters' prototypes: what the effect is loaded from and saves. */
+	std::vector<ParticleEmitter*> getTemplateEmitters();
+
+	/** Copies each prototype into its pool again after it changed, stopping the running children. */
+	void refreshSubEmitters();
+
+	/** Matches this effect's sub-emitters to effect's, reusing the pools when they have the same layout. */
+	void initSubEmitters(ParticleEffect* effect);
+
+	/** Tells every emitter and child which births and deaths its sub-emitters need. */
+	void updateRecordedEvents();
+
+	/** Advances the running children and starts new ones where the events of the last update call for them.
+	* simulateOnly skips building quads, as when fast-forwarding. */
+	void updateSubEmitters(float delta, bool simulateOnly);
+
+	void startSubEmitters(ParticleEmitter* parent, int parentEmitter, int parentSubEmitter);
+
+	/** Stops every child and parks it in its pool. */
+	void stopSubEmitters();
+
+	/** Returns the longest period of the emitters' baked loops, 0 when not baked. */
+	float getBakedPeriod();
+
+	/** Calls function for every emitter and every sub-emitter child, running or not. */
+	void forEachEmitter(const std::function<void(ParticleEmitter*)>& function);
+
+	/** Adds what this effect holds to usage, skipping definitions and textures already in counted. */
+	void addMemoryUsage(ParticleMemoryUsage& usage, std::unordered_set<const void*>& counted);
 public:
 	//洴
 	static ParticleEffect* createFromCache(const string name);
 	static void clearCache();
 
-	ParticleEffect() :_completeListener(nullptr) {}
+	/** Sets how many completed instances are kept for reuse per effect name. Defaults to 8. */
+	static void setPoolCapacity(int capacity);
+
+	/** Overrides the pool capacity for one effect name. */
+	static void setPoolCapacity(const string& name, int capacity);
+
+	/** Releases parked instances until at most maxPerName remain for every effect name. */
+	static void trimPool(int maxPerName = 0);
+
+	static int getPooledCount(const string& name);
+
+	/** Releases every parked instance of one effect. */
+	static void clearPool(const string& name);
+
+	/** Removes the instances that completed since the last call from the scene and parks them in the pool.
+	* Runs automatically after each scheduler update. */
+	static void recycleCompleted();
+
+	ParticleEffect() :ownsTexture(false), _completeListener(nullptr), _freeMode(false), _lastWorldX(0), _lastWorldY(0),
+		_managerIndex(-1), _paused(false), _priority(0), _throttle(1), _lowDetail(false), _lodTimer(0), _lodElapsed(0), _pendingDelta(0),
+		_hiddenMode(HiddenMode::SIMULATE), _maxCatchUp(2), _hiddenTime(0), _burstHost(false),
+		_parseTime(0), _imageTime(0), _maxDescendants(64), _descendantCount(0) {
+		memset(&_lod, 0, sizeof(_lod));
+		_lod.emissionScale = 1;
+	}
+
+	virtual ~ParticleEffect();
 
 	virtual void init(ParticleEffect* effect);
 
@@ -41,8 +207,27 @@ public:
 
 	virtual void setCompleteListener(completeListener listener);
 
+	/** Starts the effect as a burst host: the emitters stop emitting on their own, particles only come from
+	* burstAt(), and the effect never completes. Keep one host per effect in the scene and remove it when done. */
+	virtual void startBursts();
+
+	/** Spawns count particles from every emitter around x, y in this node's space. Each burst keeps its own
+	* origin, so many short impacts share this effect's update and draw. Starts an unstarted effect as a host. */
+	virtual void burstAt(float x, float y, int count, const ParticleEmitter::BurstParams& params = ParticleEmitter::BurstParams());
+
+	bool isBurstHost() const {
+		return _burstHost;
+	}
+
+	/** Advances all emitters. Called by the ParticleSystemManager between start() and completion. */
 	virtual void update(float delta) override;
 
+	virtual void cleanup() override;
+
+	virtual void pause() override;
+
+	virtual void resume() override;
+
 	virtual void allowCompletion();
 
 	virtual bool isComplete();
@@ -57,24 +242,151 @@ public:
 
 	virtual void setFreeMode(bool isFree);
 
+	/** Under the particle budget, effects with lower priority are throttled first. Defaults to 0. */
+	void setPriority(int priority) {
+		_priority = priority;
+	}
+
+	int getPriority() const {
+		return _priority;
+	}
+
+	/** How far the particle budget currently scales this effect down: 1 when running as authored. */
+	float getThrottle() const {
+		return _throttle;
+	}
+
+	/** Returns the number of live particles in all emitters. */
+	int getActiveCount();
+
+	/** Adds a force field or collider to every emitter; its positions are in this effect's space. The effect does
+	* not own it, and recycled instances drop it. */
+	void addAffector(ParticleAffector* affector);
+
+	void removeAffector(ParticleAffector* affector);
+
+	void removeAllAffectors();
+
+	/** Starts a copy of the emitter named child wherever a particle of the emitter named parent is born or dies,
+	* e.g. sparks where a firework shell bursts. The child leaves this effect's emitters and only runs as a
+	* sub-emitter, once, not continuously. Copies come from a pool of poolSize created here and share the child's
+	* definition and texture. parent may be the child of an earlier sub-emitter, for cascades. Returns false if
+	* either name is unknown. Instances created from the cache copy the prototype's sub-emitters. */
+	bool addSubEmitter(const string& parent, const string& child, SubEmitterTrigger trigger, int poolSize = 16);
+
+	void removeAllSubEmitters();
+
+	/** Caps the sub-emitter children running at once across all sub-emitters and levels. Defaults to 64. */
+	void setMaxDescendants(int count) {
+		_maxDescendants = count;
+	}
+
+	int getMaxDescendants() const {
+		return _maxDescendants;
+	}
+
+	int getDescendantCount() const {
+		return _descendantCount;
+	}
+
+	/** Plays every emitter back from a loop recorded once per definition and shared by all instances instead of
+	* simulating it, e.g. for a level full of identical torches. Each instance starts at a random phase, so they do
+	* not flicker in step. Returns false and keeps simulating unless every emitter is continuous and its loop fits
+	* in maxBytes; effects with affectors or sub-emitters are never baked. Baked emitters ignore throttling and
+	* level of detail, and move rigidly with the effect. */
+	bool setBakedPlayback(bool baked, size_t maxBytes = DEFAULT_BAKED_BYTES);
+
+	bool isBakedPlayback() const;
+
+	/** Moves baked playback to seconds into the loops. */
+	void setPlaybackPhase(float seconds);
+
+	void setLodSettings(const LodSettings& settings);
+
+	const LodSettings& getLodSettings() const {
+		return _lod;
+	}
+
+	bool isLowDetail() const {
+		return _lowDetail;
+	}
+
+	/** Sets what the effect does while hidden. SIMULATE by default, so hidden effects still complete and are
+	* recycled. FAST_FORWARD catches up on at most maxCatchUp seconds. With PAUSE or FAST_FORWARD an effect does not
+	* complete while hidden, so one that is never shown again must be stopped by its owner. */
+	void setHiddenMode(HiddenMode mode, float maxCatchUp = 2) {
+		_hiddenMode = mode;
+		_maxCatchUp = maxCatchUp;
+	}
+
+	HiddenMode getHiddenMode() const {
+		return _hiddenMode;
+	}
+
 	virtual cocos2d::Vector<ParticleEmitter*>& getEmitters() {
 		return emitters;
 	}
 
-	/** Returns the emitter with the specified name, or null. */
+	/** Returns the emitter with the specified name, or null. Sub-emitters are found by their prototype; changes to it
+	* reach the pooled copies through scaleEffect() and flipY(), or when the effect is copied. */
 	virtual ParticleEmitter* findEmitter(string name);
 
-	virtual void save(ostream& output);
+	/** Writes the emitters in the effect file format, which cannot express sub-emitters: effects with any are not
+	* saved, and false is returned. */
+	virtual bool save(ostream& output);
 
 	virtual void loadEmitters(string file);
 
+	/** Creates one emitter per definition, replacing the current emitters. */
+	virtual void initWithDefinitions(const std::vector<EmitterDefinition*>& definitions);
+
+	/** Parses the content of an effect file into definitions owned by the caller. Does not touch the
+	* scene graph, so it can run off the GL thread. */
+	static void readDefinitions(const string& content, std::vector<EmitterDefinition*>& definitions);
+
+	/** Parses text effect content in place. Returns false, appending nothing, if the content strays from the
+	* format as saved; readDefinitions then falls back to the line-by-line stream reader. */
+	static bool parseDefinitions(const char* data, size_t size, std::vector<EmitterDefinition*>& definitions);
+
+	/** Reads a text or binary effect file. Binary definitions use their curves in place and keep the file open. */
+	static void readDefinitions(EffectFile* file, std::vector<EmitterDefinition*>& definitions);
+
+	/** Reads an effect stored at data inside file, e.g. an entry of an effect pack. */
+	static void readDefinitions(EffectFile* file, const char* data, size_t size, std::vector<EmitterDefinition*>& definitions);
+
 	virtual void loadEmitterImages(string path = PARTICLE_IMAGE_PATH);
 
+	/** Takes images found in the pack from it and loads the rest from files. */
+	virtual void loadEmitterImages(string path, ParticleEffectPack* pack);
+
 	/** Returns the bounding box for all active particles. z axis will always be zero. */
 	virtual BoundingBox& getBoundingBox();
 
 	virtual void scaleEffect(float scaleFactor);
 
+	/** Returns the bytes held by the emitters, their definitions and the distinct textures they use. */
+	virtual size_t getMemorySize();
+
+	/** Breaks getMemorySize() down by category. Definitions and textures shared with other effects are
+	* included. */
+	ParticleMemoryUsage getMemoryUsage();
+
+	/** Returns the bytes held by every started, pooled and cached effect and by the shared GL buffers, counting
+	* shared definitions and textures once. Effects that are none of these are not seen. */
+	static ParticleMemoryUsage getTotalMemoryUsage();
+
+	/** Sums the counters of the emitters, with the load times of the effect. */
+	ParticleStats getStats();
+
+	/** Records milliseconds spent parsing the effect and loading its images, also in the ParticleStatsRegistry.
+	* Called by the loaders; instances created from the cache report their prototype's times. */
+	void addLoadTime(float parseTime, float imageTime);
+
+	/** The name the effect was created from the cache with, empty otherwise. */
+	const string& getCacheName() const {
+		return _cacheName;
+	}
+
 	/** Sets the {@link com.badlogic.gdx.graphics.g2d.ParticleEmitter#setCleansUpBlendFunction(boolean) cleansUpBlendFunction}
 	* parameter on all {@link com.badlogic.gdx.graphics.g2d.ParticleEmitter ParticleEmitters} currently in this ParticleEffect.
 	* <p>
@@ -0,0 +1,350 @@
+#include "ParticleEffectBinary.h"
+#include "ParticleEffect.h"
+#include <cstring>
+#include <fstream>
+
+#if CC_TARGET_PLATFORM == CC_PLATFORM_WIN32
+#include <windows.h>
+#elif CC_TARGET_PLATFORM != CC_PLATFORM_WINRT
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+USING_NS_CUSTOM;
+
+EffectFile* NS_CUSTOM::EffectFile::open(const string& fullPath)
+{
+	auto file = new EffectFile();
+	if (!file->map(fullPath)){
+		// Packaged files (e.g. inside an apk) cannot be mapped, read them instead.
+		file->_buffer = FileUtils::getInstance()->getDataFromFile(fullPath);
+		if (file->_buffer.isNull()){
+			file->release();
+			return nullptr;
+		}
+		file->_data = (const char*)file->_buffer.getBytes();
+		file->_size = (size_t)file->_buffer.getSize();
+	}
+	return file;
+}
+
+NS_CUSTOM::EffectFile::~EffectFile()
+{
+#if CC_TARGET_PLATFORM == CC_PLATFORM_WIN32
+	if (_mapping) UnmapViewOfFile(_mapping);
+	if (_handle) CloseHandle((HANDLE)_handle);
+#elif CC_TARGET_PLATFORM != CC_PLATFORM_WINRT
+	if (_mapping) munmap(_mapping, _size);
+#endif
+}
+
+bool NS_CUSTOM::EffectFile::isBinary() const
+{
+	return ParticleEffectBinary::isBinary(_data, _size);
+}
+
+bool NS_CUSTOM::EffectFile::map(const string& fullPath)
+{
+#if CC_TARGET_PLATFORM == CC_PLATFORM_WIN32
+	int length = MultiByteToWideChar(CP_UTF8, 0, fullPath.c_str(), -1, nullptr, 0);
+	if (length <= 0) return false;
+	std::wstring widePath(length, L'\0');
+	MultiByteToWideChar(CP_UTF8, 0, fullPath.c_str(), -1, &widePath[0], length);
+	HANDLE fileHandle = CreateFileW(widePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0){
+		CloseHandle(fileHandle);
+		return false;
+	}
+	HANDLE mappingHandle = CreateFileMappingW(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(fileHandle);
+	if (!mappingHandle) return false;
+	void* view = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (!view){
+		CloseHandle(mappingHandle);
+		return false;
+	}
+	_handle = mappingHandle;
+	_mapping = view;
+	_data = (const char*)view;
+	_size = (size_t)fileSize.QuadPart;
+	return true;
+#elif CC_TARGET_PLATFORM != CC_PLATFORM_WINRT
+	int fd = ::open(fullPath.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size <= 0){
+		::close(fd);
+		return false;
+	}
+	void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (view == MAP_FAILED) return false;
+	_mapping = view;
+	_data = (const char*)view;
+	_size = (size_t)info.st_size;
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool NS_CUSTOM::ParticleEffectBinary::isBinary(const char* data, size_t size)
+{
+	uint32_t magic;
+	if (size < sizeof(magic)) return false;
+	memcpy(&magic, data, sizeof(magic));
+	return magic == MAGIC;
+}
+
+bool NS_CUSTOM::ParticleEffectBinary::write(const std::vector<EmitterDefinition*>& definitions, ostream& output)
+{
+	std::vector<EmitterRecord> records(definitions.size());
+	std::vector<float> floats;
+	string strings;
+	for (size_t i = 0; i < definitions.size(); i++){
+		auto definition = definitions[i];
+		auto& record = records[i];
+		memset(&record, 0, sizeof(record));
+		record.name = (uint32_t)strings.size();
+		strings.append(definition->name).push_back('\0');
+		record.imagePath = (uint32_t)strings.size();
+		strings.append(definition->imagePath).push_back('\0');
+		record.minParticleCount = definition->minParticleCount;
+		record.maxParticleCount = definition->maxParticleCount;
+		if (definition->attached) record.flags |= FLAG_ATTACHED;
+		if (definition->continuous) record.flags |= FLAG_CONTINUOUS;
+		if (definition->aligned) record.flags |= FLAG_ALIGNED;
+		if (definition->additive) record.flags |= FLAG_ADDITIVE;
+		if (definition->behind) record.flags |= FLAG_BEHIND;
+		if (definition->premultipliedAlpha) record.flags |= FLAG_PREMULTIPLIED_ALPHA;
+
+		auto values = record.values;
+		saveValue(definition->delayValue, values[VALUE_DELAY]);
+		saveValue(definition->durationValue, values[VALUE_DURATION]);
+		saveValue(definition->lifeOffsetValue, values[VALUE_LIFE_OFFSET], floats);
+		saveValue(definition->lifeValue, values[VALUE_LIFE], floats);
+		saveValue(definition->emissionValue, values[VALUE_EMISSION], floats);
+		saveValue(definition->scaleValue, values[VALUE_SCALE], floats);
+		saveValue(definition->rotationValue, values[VALUE_ROTATION], floats);
+		saveValue(definition->velocityValue, values[VALUE_VELOCITY], floats);
+		saveValue(definition->angleValue, values[VALUE_ANGLE], floats);
+		saveValue(definition->windValue, values[VALUE_WIND], floats);
+		saveValue(definition->gravityValue, values[VALUE_GRAVITY], floats);
+		saveValue(definition->transparencyValue, values[VALUE_TRANSPARENCY], floats);
+		saveValue(definition->tintValue, values[VALUE_TINT], floats);
+		saveValue(definition->xOffsetValue, values[VALUE_X_OFFSET], floats);
+		saveValue(definition->yOffsetValue, values[VALUE_Y_OFFSET], floats);
+		saveValue(definition->spawnWidthValue, values[VALUE_SPAWN_WIDTH], floats);
+		saveValue(definition->spawnHeightValue, values[VALUE_SPAWN_HEIGHT], floats);
+		saveValue(definition->spawnShapeValue, values[VALUE_SPAWN_SHAPE]);
+	}
+
+	Header header;
+	header.magic = MAGIC;
+	header.version = VERSION;
+	header.emitterCount = (uint32_t)records.size();
+	header.emitterOffset = sizeof(Header);
+	header.floatOffset = header.emitterOffset + (uint32_t)(records.size() * sizeof(EmitterRecord));
+	header.floatCount = (uint32_t)floats.size();
+	header.stringOffset = header.floatOffset + (uint32_t)(floats.size() * sizeof(float));
+	header.stringSize = (uint32_t)strings.size();
+
+	output.write((const char*)&header, sizeof(header));
+	output.write((const char*)records.data(), records.size() * sizeof(EmitterRecord));
+	output.write((const char*)floats.data(), floats.size() * sizeof(float));
+	output.write(strings.data(), strings.size());
+	return output.good();
+}
+
+bool NS_CUSTOM::ParticleEffectBinary::read(EffectFile* file, std::vector<EmitterDefinition*>& definitions)
+{
+	return read(file, file->getData(), file->getSize(), definitions);
+}
+
+bool NS_CUSTOM::ParticleEffectBinary::read(EffectFile* file, const char* data, size_t size, std::vector<EmitterDefinition*>& definitions)
+{
+	if (!validate(data, size)) return false;
+	auto header = (const Header*)data;
+	auto records = (const EmitterRecord*)(data + header->emitterOffset);
+	auto floats = (const float*)(data + header->floatOffset);
+	auto strings = data + header->stringOffset;
+	for (uint32_t i = 0; i < header->emitterCount; i++){
+		auto& record = records[i];
+		auto definition = new EmitterDefinition();
+		file->retain();
+		definition->_source = file;
+		definition->name = strings + record.name;
+		definition->imagePath = strings + record.imagePath;
+		definition->minParticleCount = record.minParticleCount;
+		definition->maxParticleCount = record.maxParticleCount;
+		definition->attached = (record.flags & FLAG_ATTACHED) != 0;
+		definition->continuous = (record.flags & FLAG_CONTINUOUS) != 0;
+		definition->aligned = (record.flags & FLAG_ALIGNED) != 0;
+		definition->additive = (record.flags & FLAG_ADDITIVE) != 0;
+		definition->behind = (record.flags & FLAG_BEHIND) != 0;
+		definition->premultipliedAlpha = (record.flags & FLAG_PREMULTIPLIED_ALPHA) != 0;
+
+		auto values = record.values;
+		loadValue(definition->delayValue, values[VALUE_DELAY]);
+		loadValue(definition->durationValue, values[VALUE_DURATION]);
+		loadValue(definition->lifeOffsetValue, values[VALUE_LIFE_OFFSET], floats);
+		loadValue(definition->lifeValue, values[VALUE_LIFE], floats);
+		loadValue(definition->emissionValue, values[VALUE_EMISSION], floats);
+		loadValue(definition->scaleValue, values[VALUE_SCALE], floats);
+		loadValue(definition->rotationValue, values[VALUE_ROTATION], floats);
+		loadValue(definition->velocityValue, values[VALUE_VELOCITY], floats);
+		loadValue(definition->angleValue, values[VALUE_ANGLE], floats);
+		loadValue(definition->windValue, values[VALUE_WIND], floats);
+		loadValue(definition->gravityValue, values[VALUE_GRAVITY], floats);
+		loadValue(definition->transparencyValue, values[VALUE_TRANSPARENCY], floats);
+		loadValue(definition->tintValue, values[VALUE_TINT], floats);
+		loadValue(definition->xOffsetValue, values[VALUE_X_OFFSET], floats);
+		loadValue(definition->yOffsetValue, values[VALUE_Y_OFFSET], floats);
+		loadValue(definition->spawnWidthValue, values[VALUE_SPAWN_WIDTH], floats);
+		loadValue(definition->spawnHeightValue, values[VALUE_SPAWN_HEIGHT], floats);
+		loadValue(definition->spawnShapeValue, values[VALUE_SPAWN_SHAPE]);
+		definitions.push_back(definition);
+	}
+	return true;
+}
+
+bool NS_CUSTOM::ParticleEffectBinary::convert(const string& textFile, const string& binaryFile)
+{
+	auto content = FileUtils::getInstance()->getStringFromFile(textFile);
+	if (content.empty()) return false;
+	std::vector<EmitterDefinition*> definitions;
+	ParticleEffect::readDefinitions(content, definitions);
+	std::ofstream output(binaryFile, std::ios::binary | std::ios::trunc);
+	bool result = output.is_open() && write(definitions, output);
+	for (auto definition : definitions)
+		definition->release();
+	return result;
+}
+
+bool NS_CUSTOM::ParticleEffectBinary::validate(const char* data, size_t size)
+{
+	if (!isBinary(data, size) || size < sizeof(Header)) return false;
+	auto header = (const Header*)data;
+	if (header->version != VERSION) return false;
+	auto fits = [size](uint64_t offset, uint64_t length){
+		return offset <= size && length <= size - offset;
+	};
+	if (!fits(header->emitterOffset, (uint64_t)header->emitterCount * sizeof(EmitterRecord))
+		|| !fits(header->floatOffset, (uint64_t)header->floatCount * sizeof(float))
+		|| !fits(header->stringOffset, header->stringSize))
+		return false;
+	if (header->emitterOffset % alignof(EmitterRecord) != 0 || header->floatOffset % alignof(float) != 0)
+		return false;
+	// Every string ends at a terminator before the end of the table.
+	if (header->stringSize == 0 || data[header->stringOffset + header->stringSize - 1] != '\0')
+		return false;
+	auto curveFits = [header](uint32_t offset, uint32_t count){
+		return offset <= header->floatCount && count <= header->floatCount - offset;
+	};
+	auto records = (const EmitterRecord*)(data + header->emitterOffset);
+	for (uint32_t i = 0; i < header->emitterCount; i++){
+		auto& record = records[i];
+		if (record.name >= header->stringSize || record.imagePath >= header->stringSize) return false;
+		for (int j = 0; j < VALUE_COUNT; j++){
+			auto& value = record.values[j];
+			if (!curveFits(value.curve, value.curveCount) || !curveFits(value.timeline, value.timelineCount))
+				return false;
+			// Delay, duration and the shape have no curves; the others are sampled from their first point on.
+			if (j < VALUE_LIFE_OFFSET || j == VALUE_SPAWN_SHAPE) continue;
+			uint64_t pointSize = j == VALUE_TINT ? 3 : 1;
+			if (value.timelineCount < 1 || value.curveCount != value.timelineCount * pointSize)
+				return false;
+		}
+		auto& shape = record.values[VALUE_SPAWN_SHAPE];
+		if (!(shape.lowMin >= SpawnShape::point && shape.lowMin <= SpawnShape::ellipse)
+			|| !(shape.lowMax >= SpawnEllipseSide::both && shape.lowMax <= SpawnEllipseSide::bottom))
+			return false;
+	}
+	return true;
+}
+
+void NS_CUSTOM::ParticleEffectBinary::saveValue(const ParticleValue& value, ValueRecord& record)
+{
+	if (value.active) record.flags |= FLAG_ACTIVE;
+	if (value.alwaysActive) record.flags |= FLAG_ALWAYS_ACTIVE;
+}
+
+void NS_CUSTOM::ParticleEffectBinary::saveValue(const RangedNumericValue& value, ValueRecord& record)
+{
+	saveValue((const ParticleValue&)value, record);
+	record.lowMin = value.lowMin;
+	record.lowMax = value.lowMax;
+}
+
+void NS_CUSTOM::ParticleEffectBinary::saveValue(const ScaledNumericValue& value, ValueRecord& record, std::vector<float>& floats)
+{
+	saveValue((const RangedNumericValue&)value, record);
+	record.highMin = value.highMin;
+	record.highMax = value.highMax;
+	if (value.relative) record.flags |= FLAG_RELATIVE;
+	record.curve = (uint32_t)floats.size();
+	record.curveCount = (uint32_t)value.scalingCount();
+	floats.insert(floats.end(), value.scalingData(), value.scalingData() + value.scalingCount());
+	record.timeline = (uint32_t)floats.size();
+	record.timelineCount = (uint32_t)value.timelineCount();
+	floats.insert(floats.end(), value.timelineData(), value.timelineData() + value.timelineCount());
+}
+
+void NS_CUSTOM::ParticleEffectBinary::saveValue(const GradientColorValue& value, ValueRecord& record, std::vector<float>& floats)
+{
+	saveValue((const ParticleValue&)value, record);
+	record.curve = (uint32_t)floats.size();
+	record.curveCount = (uint32_t)value.colorsCount();
+	floats.insert(floats.end(), value.colorsData(), value.colorsData() + value.colorsCount());
+	record.timeline = (uint32_t)floats.size();
+	record.timelineCount = (uint32_t)value.timelineCount();
+	floats.insert(floats.end(), value.timelineData(), value.timelineData() + value.timelineCount());
+}
+
+void NS_CUSTOM::ParticleEffectBinary::saveValue(const SpawnShapeValue& value, ValueRecord& record)
+{
+	saveValue((const ParticleValue&)value, record);
+	if (value.edges) record.flags |= FLAG_EDGES;
+	record.lowMin = (float)value.shape;
+	record.lowMax = (float)value.side;
+}
+
+void NS_CUSTOM::ParticleEffectBinary::loadValue(ParticleValue& value, const ValueRecord& record)
+{
+	value.active = (record.flags & FLAG_ACTIVE) != 0;
+	value.alwaysActive = (record.flags & FLAG_ALWAYS_ACTIVE) != 0;
+}
+
+void NS_CUSTOM::ParticleEffectBinary::loadValue(RangedNumericValue& value, const ValueRecord& record)
+{
+	loadValue((ParticleValue&)value, record);
+	value.lowMin = record.lowMin;
+	value.lowMax = record.lowMax;
+}
+
+void NS_CUSTOM::ParticleEffectBinary::loadValue(ScaledNumericValue& value, const ValueRecord& record, const float* floats)
+{
+	loadValue((RangedNumericValue&)value, record);
+	value.highMin = record.highMin;
+	value.highMax = record.highMax;
+	value.relative = (record.flags & FLAG_RELATIVE) != 0;
+	value.mapCurves(floats + record.curve, record.curveCount, floats + record.timeline, record.timelineCount);
+}
+
+void NS_CUSTOM::ParticleEffectBinary::loadValue(GradientColorValue& value, const ValueRecord& record, const float* floats)
+{
+	loadValue((ParticleValue&)value, record);
+	value.mapCurves(floats + record.curve, record.curveCount, floats + record.timeline, record.timelineCount);
+}
+
+void NS_CUSTOM::ParticleEffectBinary::loadValue(SpawnShapeValue& value, const ValueRecord& record)
+{
+	loadValue((ParticleValue&)value, record);
+	value.edges = (record.flags & FLAG_EDGES) != 0;
+	value.shape = (SpawnShape)(int)record.lowMin;
+	value.side = (SpawnEllipseSide)(int)record.lowMax;
+}
@@ -0,0 +1,160 @@
+#ifndef __PARTICLE_EFFECT_BINARY_H__
+#define __PARTICLE_EFFECT_BINARY_H__
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <iostream>
+#include "cocos2d.h"
+#include "core/util/GameDefine.h"
+#include "ParticleEmitter.h"
+
+USING_NS_CC;
+using std::string;
+using std::ostream;
+
+NS_CUSTOM_BEGIN
+
+/** The bytes of an effect file, memory-mapped when the platform allows it and read into memory otherwise.
+* Definitions loaded from a binary file point into it and keep it retained. */
+class EffectFile : public Ref{
+public:
+	/** Opens a file by full path, or returns null. The caller owns the returned reference.
+	* Nothing is autoreleased, so it may be called off the GL thread. */
+	static EffectFile* open(const string& fullPath);
+
+	virtual ~EffectFile();
+
+	const char* getData() const {
+		return _data;
+	}
+
+	size_t getSize() const {
+		return _size;
+	}
+
+	bool isMapped() const {
+		return _mapping != nullptr;
+	}
+
+	/** Whether the file starts with the binary effect header rather than text. */
+	bool isBinary() const;
+private:
+	EffectFile() : _data(nullptr), _size(0), _mapping(nullptr), _handle(nullptr){}
+
+	bool map(const string& fullPath);
+
+	const char* _data;
+	size_t _size;
+	void* _mapping;
+	void* _handle;
+	Data _buffer;
+};
+
+/** Compiled form of the text effect format. Scalars are stored in fixed-size records and all curves in one
+* float table, so loading is a header check and a pass over the records, with curves used in place. */
+class ParticleEffectBinary{
+public:
+	static const uint32_t MAGIC = 0x42454650;	// "PFEB"
+	static const uint32_t VERSION = 1;
+
+	static bool isBinary(const char* data, size_t size);
+
+	static bool write(const std::vector<EmitterDefinition*>& definitions, ostream& output);
+
+	/** Appends one new definition per emitter, owned by the caller. Returns false on a truncated,
+	* corrupt or foreign file, in which case nothing is appended. */
+	static bool read(EffectFile* file, std::vector<EmitterDefinition*>& definitions);
+
+	/** Reads a binary effect stored at data, which lies inside file, e.g. an entry of an effect pack. */
+	static bool read(EffectFile* file, const char* data, size_t size, std::vector<EmitterDefinition*>& definitions);
+
+	/** Compiles a text effect file into a binary one. Paths are resolved through FileUtils. */
+	static bool convert(const string& textFile, const string& binaryFile);
+private:
+	enum ValueFlags{
+		FLAG_ACTIVE = 1 << 0,
+		FLAG_ALWAYS_ACTIVE = 1 << 1,
+		FLAG_RELATIVE = 1 << 2,
+		FLAG_EDGES = 1 << 3,
+	};
+
+	enum EmitterFlags{
+		FLAG_ATTACHED = 1 << 0,
+		FLAG_CONTINUOUS = 1 << 1,
+		FLAG_ALIGNED = 1 << 2,
+		FLAG_ADDITIVE = 1 << 3,
+		FLAG_BEHIND = 1 << 4,
+		FLAG_PREMULTIPLIED_ALPHA = 1 << 5,
+	};
+
+	struct Header{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t emitterCount;
+		uint32_t emitterOffset;
+		uint32_t floatOffset;
+		uint32_t floatCount;
+		uint32_t stringOffset;
+		uint32_t stringSize;
+	};
+
+	/** Any value. Curves are indices into the float table; colors use the first curve, shapes use
+	* lowMin for the shape and lowMax for the ellipse side. */
+	struct ValueRecord{
+		uint32_t flags;
+		float lowMin, lowMax;
+		float highMin, highMax;
+		uint32_t curve, curveCount;
+		uint32_t timeline, timelineCount;
+	};
+
+	enum{
+		VALUE_DELAY,
+		VALUE_DURATION,
+		VALUE_LIFE_OFFSET,
+		VALUE_LIFE,
+		VALUE_EMISSION,
+		VALUE_SCALE,
+		VALUE_ROTATION,
+		VALUE_VELOCITY,
+		VALUE_ANGLE,
+		VALUE_WIND,
+		VALUE_GRAVITY,
+		VALUE_TRANSPARENCY,
+		VALUE_TINT,
+		VALUE_X_OFFSET,
+		VALUE_Y_OFFSET,
+		VALUE_SPAWN_WIDTH,
+		VALUE_SPAWN_HEIGHT,
+		VALUE_SPAWN_SHAPE,
+		VALUE_COUNT
+	};
+
+	struct EmitterRecord{
+		uint32_t name, imagePath;	// offsets into the string table
+		int32_t minParticleCount, maxParticleCount;
+		uint32_t flags;
+		ValueRecord values[VALUE_COUNT];
+	};
+
+	static void saveValue(const ParticleValue& value, ValueRecord& record);
+	static void saveValue(const RangedNumericValue& value, ValueRecord& record);
+	static void saveValue(const ScaledNumericValue& value, ValueRecord& record, std::vector<float>& floats);
+	static void saveValue(const GradientColorValue& value, ValueRecord& record, std::vector<float>& floats);
+	static void saveValue(const SpawnShapeValue& value, ValueRecord& record);
+
+	static void loadValue(ParticleValue& value, const ValueRecord& record);
+	static void loadValue(RangedNumericValue& value, const ValueRecord& record);
+	static void loadValue(ScaledNumericValue& value, const ValueRecord& record, const float* floats);
+	static void loadValue(GradientColorValue& value, const ValueRecord& record, const float* floats);
+	static void loadValue(SpawnShapeValue& value, const ValueRecord& record);
+
+	/** Checks that every offset in the file stays inside it and every curve has a point per timeline entry (three
+	* floats for colors), so records can be used without further checks. */
+	static bool validate(const char* data, size_t size);
+};
+
+NS_CUSTOM_END
+
+#endif
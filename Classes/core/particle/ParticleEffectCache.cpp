@@ -0,0 +1,129 @@
+#include "ParticleEffectCache.h"
+#include "ParticleEffect.h"
+
+USING_NS_CUSTOM;
+
+ParticleEffectCache* NS_CUSTOM::ParticleEffectCache::_instance = nullptr;
+
+NS_CUSTOM::ParticleEffectCache::~ParticleEffectCache()
+{
+	clear();
+	if (this == _instance) _instance = nullptr;
+}
+
+ParticleEffectCache* NS_CUSTOM::ParticleEffectCache::getInstance()
+{
+	if (!_instance){
+		_instance = new ParticleEffectCache();
+	}
+	return _instance;
+}
+
+ParticleEffect* NS_CUSTOM::ParticleEffectCache::get(const string& name)
+{
+	auto it = _entries.find(name);
+	if (it == _entries.end()){
+		_statistics.misses++;
+		return nullptr;
+	}
+	_statistics.hits++;
+	_order.splice(_order.begin(), _order, it->second.order);
+	return it->second.effect;
+}
+
+ParticleEffect* NS_CUSTOM::ParticleEffectCache::peek(const string& name)
+{
+	auto it = _entries.find(name);
+	return it == _entries.end() ? nullptr : it->second.effect;
+}
+
+std::vector<ParticleEffect*> NS_CUSTOM::ParticleEffectCache::getEffects() const
+{
+	std::vector<ParticleEffect*> effects;
+	for (auto& pair : _entries)
+		effects.push_back(pair.second.effect);
+	return effects;
+}
+
+void NS_CUSTOM::ParticleEffectCache::insert(const string& name, ParticleEffect* effect, float loadTime)
+{
+	remove(name);
+	effect->retain();
+	Entry entry;
+	entry.effect = effect;
+	entry.bytes = effect->getMemorySize();
+	entry.loadTime = loadTime;
+	entry.order = _order.insert(_order.begin(), name);
+	_entries[name] = entry;
+	_bytes += entry.bytes;
+
+	_statistics.loads++;
+	_statistics.totalLoadTime += loadTime;
+	_statistics.maxLoadTime = std::max(_statistics.maxLoadTime, loadTime);
+	evict();
+}
+
+void NS_CUSTOM::ParticleEffectCache::remove(const string& name)
+{
+	auto it = _entries.find(name);
+	if (it != _entries.end()) erase(it);
+}
+
+void NS_CUSTOM::ParticleEffectCache::clear()
+{
+	while (!_entries.empty()) erase(_entries.begin());
+}
+
+void NS_CUSTOM::ParticleEffectCache::pin(const string& name)
+{
+	_pinned.insert(name);
+}
+
+void NS_CUSTOM::ParticleEffectCache::unpin(const string& name)
+{
+	_pinned.erase(name);
+	evict();
+}
+
+void NS_CUSTOM::ParticleEffectCache::setBudget(size_t bytes)
+{
+	_budget = bytes;
+	evict();
+}
+
+size_t NS_CUSTOM::ParticleEffectCache::getBytes(const string& name) const
+{
+	auto it = _entries.find(name);
+	return it == _entries.end() ? 0 : it->second.bytes;
+}
+
+void NS_CUSTOM::ParticleEffectCache::resetStatistics()
+{
+	memset(&_statistics, 0, sizeof(_statistics));
+}
+
+void NS_CUSTOM::ParticleEffectCache::evict()
+{
+	if (_budget == 0) return;
+	// Walk from the least recently used end, never evicting the entry used last.
+	auto it = _order.end();
+	while (_bytes > _budget && it != _order.begin()){
+		--it;
+		if (it == _order.begin()) break;
+		if (_pinned.count(*it)) continue;
+		auto victim = _entries.find(*it);
+		++it;
+		erase(victim);
+		_statistics.evictions++;
+	}
+}
+
+void NS_CUSTOM::ParticleEffectCache::erase(std::unordered_map<string, Entry>::iterator it)
+{
+	// Parked instances of an evicted effect hold the same definitions and textures.
+	ParticleEffect::clearPool(it->first);
+	_bytes -= it->second.bytes;
+	_order.erase(it->second.order);
+	it->second.effect->release();
+	_entries.erase(it);
+}
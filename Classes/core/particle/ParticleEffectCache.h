@@ -0,0 +1,106 @@
+#ifndef __PARTICLE_EFFECT_CACHE_H__
+#define __PARTICLE_EFFECT_CACHE_H__
+
+#include <string>
+#include <list>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include "cocos2d.h"
+#include "core/util/GameDefine.h"
+
+USING_NS_CC;
+using std::string;
+
+NS_CUSTOM_BEGIN
+
+class ParticleEffect;
+
+/** Prototype effects loaded by ParticleEffect::createFromCache, kept in least-recently-used order.
+* When a byte budget is set, the least recently used unpinned prototypes are evicted to stay under it. */
+class ParticleEffectCache{
+public:
+	struct Statistics{
+		int hits;
+		int misses;
+		int evictions;
+		int loads;
+		float totalLoadTime;	// milliseconds
+		float maxLoadTime;		// milliseconds
+	};
+
+	ParticleEffectCache() : _budget(0), _bytes(0){
+		resetStatistics();
+	}
+	~ParticleEffectCache();
+	static ParticleEffectCache* getInstance();
+
+	/** Returns the prototype and marks it as most recently used, or null. Counts a hit or a miss. */
+	ParticleEffect* get(const string& name);
+
+	/** Returns the prototype without touching the LRU order or the statistics, or null. */
+	ParticleEffect* peek(const string& name);
+
+	/** Adds a freshly loaded prototype. loadTime is in milliseconds. */
+	void insert(const string& name, ParticleEffect* effect, float loadTime);
+
+	void remove(const string& name);
+
+	void clear();
+
+	/** Pinned effects are never evicted. Names may be pinned before they are loaded. */
+	void pin(const string& name);
+
+	void unpin(const string& name);
+
+	/** Sets the byte budget for all prototypes, 0 for unlimited, and evicts down to it. */
+	void setBudget(size_t bytes);
+
+	size_t getBudget() const {
+		return _budget;
+	}
+
+	size_t getBytes() const {
+		return _bytes;
+	}
+
+	/** Returns the bytes accounted to one prototype, or 0 when it is not cached. */
+	size_t getBytes(const string& name) const;
+
+	int getCount() const {
+		return (int)_entries.size();
+	}
+
+	/** Returns the cached prototypes, in no particular order. */
+	std::vector<ParticleEffect*> getEffects() const;
+
+	const Statistics& getStatistics() const {
+		return _statistics;
+	}
+
+	void resetStatistics();
+
+private:
+	struct Entry{
+		ParticleEffect* effect;
+		size_t bytes;
+		float loadTime;
+		std::list<string>::iterator order;
+	};
+
+	static ParticleEffectCache* _instance;
+	std::unordered_map<string, Entry> _entries;
+	std::unordered_set<string> _pinned;
+	/** Most recently used first. */
+	std::list<string> _order;
+	size_t _budget;
+	size_t _bytes;
+	Statistics _statistics;
+
+	void evict();
+	void erase(std::unordered_map<string, Entry>::iterator it);
+};
+
+NS_CUSTOM_END
+
+#endif
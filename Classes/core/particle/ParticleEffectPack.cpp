@@ -0,0 +1,181 @@
+#include "ParticleEffectPack.h"
+#include "ParticleEffect.h"
+#include "core/util/GameUtil.h"
+#include <chrono>
+#include <fstream>
+#include <unordered_set>
+
+USING_NS_CUSTOM;
+
+ParticleEffectPack* NS_CUSTOM::ParticleEffectPack::create(const string& file)
+{
+	auto effectFile = EffectFile::open(FileUtils::getInstance()->fullPathForFilename(file));
+	if (!effectFile) return nullptr;
+	auto pack = new ParticleEffectPack();
+	bool result = pack->init(effectFile);
+	effectFile->release();
+	if (!result){
+		CCLOG("ParticleEffectPack: corrupt pack %s", file.c_str());
+		pack->release();
+		return nullptr;
+	}
+	pack->autorelease();
+	return pack;
+}
+
+NS_CUSTOM::ParticleEffectPack::~ParticleEffectPack()
+{
+	CC_SAFE_RELEASE(_file);
+}
+
+bool NS_CUSTOM::ParticleEffectPack::init(EffectFile* file)
+{
+	auto data = file->getData();
+	size_t size = file->getSize();
+	if (size < sizeof(Header)) return false;
+	auto header = (const Header*)data;
+	if (header->magic != MAGIC || header->version != VERSION) return false;
+	auto fits = [size](uint64_t offset, uint64_t length){
+		return offset <= size && length <= size - offset;
+	};
+	if (header->indexOffset % alignof(IndexRecord) != 0
+		|| !fits(header->indexOffset, (uint64_t)header->entryCount * sizeof(IndexRecord))
+		|| !fits(header->nameOffset, header->nameSize))
+		return false;
+	auto records = (const IndexRecord*)(data + header->indexOffset);
+	auto names = data + header->nameOffset;
+	for (uint32_t i = 0; i < header->entryCount; i++){
+		auto& record = records[i];
+		// Entries are 4-byte aligned so binary effects can use their float tables in place.
+		if (record.type > ENTRY_IMAGE || record.offset % 4 != 0 || !fits(record.offset, record.size)
+			|| record.name > header->nameSize || record.nameLength > header->nameSize - record.name)
+			return false;
+		string name(names + record.name, record.nameLength);
+		_entries[name] = Entry{ (EntryType)record.type, data + record.offset, record.size };
+		if (record.type == ENTRY_EFFECT) _effectNames.push_back(name);
+	}
+	file->retain();
+	_file = file;
+	return true;
+}
+
+int NS_CUSTOM::ParticleEffectPack::preload()
+{
+	return preload(_effectNames);
+}
+
+int NS_CUSTOM::ParticleEffectPack::preload(const std::vector<string>& names)
+{
+	int count = 0;
+	for (auto& name : names){
+		if (preload(name)) count++;
+	}
+	return count;
+}
+
+bool NS_CUSTOM::ParticleEffectPack::preload(const string& name)
+{
+	auto cache = ParticleEffectCache::getInstance();
+	auto it = _entries.find(name);
+	if (it == _entries.end() || it->second.type != ENTRY_EFFECT || cache->peek(name)) return false;
+	auto startTime = std::chrono::steady_clock::now();
+	std::vector<EmitterDefinition*> definitions;
+	ParticleEffect::readDefinitions(_file, it->second.data, it->second.size, definitions);
+	std::chrono::duration<float, std::milli> parseTime = std::chrono::steady_clock::now() - startTime;
+	auto effect = ParticleEffect::create();
+	effect->initWithDefinitions(definitions);
+	effect->addLoadTime(parseTime.count(), 0);
+	for (auto definition : definitions)
+		definition->release();
+	effect->loadEmitterImages(getPathForFilename(name), this);
+	std::chrono::duration<float, std::milli> loadTime = std::chrono::steady_clock::now() - startTime;
+	cache->insert(name, effect, loadTime.count());
+	return true;
+}
+
+Texture2D* NS_CUSTOM::ParticleEffectPack::getTexture(const string& name)
+{
+	auto it = _entries.find(name);
+	if (it == _entries.end() || it->second.type != ENTRY_IMAGE) return nullptr;
+	auto textureCache = Director::getInstance()->getTextureCache();
+	auto texture = textureCache->getTextureForKey(name);
+	if (texture) return texture;
+	auto image = new Image();
+	if (image->initWithImageData((const unsigned char*)it->second.data, it->second.size))
+		texture = textureCache->addImage(image, name);
+	image->release();
+	return texture;
+}
+
+bool NS_CUSTOM::ParticleEffectPack::write(const std::vector<string>& effectNames, const string& packFile)
+{
+	auto fileUtils = FileUtils::getInstance();
+	std::vector<IndexRecord> records;
+	std::vector<Data> contents;
+	string names;
+	std::unordered_set<string> added;
+	auto add = [&](const string& name, EntryType type, const string& fullPath){
+		Data data = fileUtils->getDataFromFile(fullPath);
+		if (data.isNull()) return false;
+		IndexRecord record;
+		record.type = type;
+		record.name = (uint32_t)names.size();
+		record.nameLength = (uint32_t)name.size();
+		record.offset = 0;
+		record.size = (uint32_t)data.getSize();
+		names.append(name);
+		records.push_back(record);
+		contents.push_back(std::move(data));
+		added.insert(name);
+		return true;
+	};
+
+	for (auto& name : effectNames){
+		if (added.count(name)) continue;
+		string fullPath = fileUtils->fullPathForFilename(name);
+		if (!add(name, ENTRY_EFFECT, fullPath)){
+			CCLOG("ParticleEffectPack: missing effect %s", name.c_str());
+			return false;
+		}
+		auto effectFile = EffectFile::open(fullPath);
+		if (!effectFile) continue;
+		std::vector<EmitterDefinition*> definitions;
+		ParticleEffect::readDefinitions(effectFile, definitions);
+		effectFile->release();
+		string path = getPathForFilename(name);
+		for (auto definition : definitions){
+			auto& imagePath = definition->getImagePath();
+			if (!imagePath.empty() && !added.count(path + imagePath)){
+				// A missing image stays out of the pack and is looked up as a loose file at load time.
+				if (!add(path + imagePath, ENTRY_IMAGE, fileUtils->fullPathForFilename(path + imagePath)))
+					CCLOG("ParticleEffectPack: missing image %s", (path + imagePath).c_str());
+			}
+			definition->release();
+		}
+	}
+
+	uint32_t offset = sizeof(Header);
+	for (auto& record : records){
+		record.offset = offset;
+		offset = (offset + record.size + 3) & ~3u;
+	}
+	Header header;
+	header.magic = MAGIC;
+	header.version = VERSION;
+	header.entryCount = (uint32_t)records.size();
+	header.indexOffset = offset;
+	header.nameOffset = offset + (uint32_t)(records.size() * sizeof(IndexRecord));
+	header.nameSize = (uint32_t)names.size();
+
+	std::ofstream output(packFile, std::ios::binary | std::ios::trunc);
+	if (!output.is_open()) return false;
+	output.write((const char*)&header, sizeof(header));
+	static const char padding[4] = {};
+	for (size_t i = 0; i < records.size(); i++){
+		output.write((const char*)contents[i].getBytes(), records[i].size);
+		output.write(padding, (4 - records[i].size % 4) % 4);
+	}
+	output.write((const char*)records.data(), records.size() * sizeof(IndexRecord));
+	output.write(names.data(), names.size());
+	return output.good();
+}
@@ -0,0 +1,90 @@
+#ifndef __PARTICLE_EFFECT_PACK_H__
+#define __PARTICLE_EFFECT_PACK_H__
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include "cocos2d.h"
+#include "core/util/GameDefine.h"
+
+USING_NS_CC;
+using std::string;
+
+NS_CUSTOM_BEGIN
+
+class EffectFile;
+
+/** Many effect files and the images they use in one file behind a name index. The pack is opened with a
+* single open and map (or read, for packaged assets) and its entries are parsed in place. */
+class ParticleEffectPack : public Ref{
+public:
+	static const uint32_t MAGIC = 0x4b504650;	// "PFPK"
+	static const uint32_t VERSION = 1;
+
+	/** Opens a pack through FileUtils, or returns null if it is missing or corrupt. */
+	static ParticleEffectPack* create(const string& file);
+
+	/** Packs the effects and every image they reference. Effects keep the names given here, which are the
+	* names later passed to ParticleEffect::createFromCache. */
+	static bool write(const std::vector<string>& effectNames, const string& packFile);
+
+	virtual ~ParticleEffectPack();
+
+	bool contains(const string& name) const {
+		return _entries.find(name) != _entries.end();
+	}
+
+	const std::vector<string>& getEffectNames() const {
+		return _effectNames;
+	}
+
+	/** Loads every effect in the pack into the ParticleEffectCache, skipping those already cached.
+	* Returns the number loaded. */
+	int preload();
+
+	int preload(const std::vector<string>& names);
+
+	/** Returns the texture for an image in the pack, decoding it on first use, or null. */
+	Texture2D* getTexture(const string& name);
+private:
+	enum EntryType{
+		ENTRY_EFFECT,
+		ENTRY_IMAGE
+	};
+
+	struct Header{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t entryCount;
+		uint32_t indexOffset;
+		uint32_t nameOffset;
+		uint32_t nameSize;
+	};
+
+	struct IndexRecord{
+		uint32_t type;
+		uint32_t name, nameLength;	// in the name table
+		uint32_t offset, size;
+	};
+
+	struct Entry{
+		EntryType type;
+		const char* data;
+		size_t size;
+	};
+
+	ParticleEffectPack() :_file(nullptr){}
+
+	bool init(EffectFile* file);
+
+	bool preload(const string& name);
+
+	EffectFile* _file;
+	std::unordered_map<string, Entry> _entries;
+	std::vector<string> _effectNames;
+};
+
+NS_CUSTOM_END
+
+#endif
@@ -1,95 +1,11 @@
 #include "ParticleEmitter.h"
+#include "ParticleBakedLoop.h"
 #include "core/util/GameUtil.h"
+#include <cstring>
+#include <cmath>
 
 USING_NS_CUSTOM;
 
-float_array GradientColorValue::temp = { 0, 0, 0, 0 };
-
-float_array& GradientColorValue::getColor(float percent)
-{
-	int startIndex = 0, endIndex = -1;
-	int n = timeline.size();
-	for (int i = 1; i < n; i++) {
-		float t = timeline[i];
-		if (t > percent) {
-			endIndex = i;
-			break;
-		}
-		startIndex = i;
-	}
-	float startTime = timeline[startIndex];
-	startIndex *= 3;
-	float r1 = colors[startIndex];
-	float g1 = colors[startIndex + 1];
-	float b1 = colors[startIndex + 2];
-	if (endIndex == -1) {
-		temp[0] = r1;
-		temp[1] = g1;
-		temp[2] = b1;
-		return temp;
-	}
-	float factor = (percent - startTime) / (timeline[endIndex] - startTime);
-	endIndex *= 3;
-	temp[0] = r1 + (colors[endIndex] - r1) * factor;
-	temp[1] = g1 + (colors[endIndex + 1] - g1) * factor;
-	temp[2] = b1 + (colors[endIndex + 2] - b1) * factor;
-	return temp;
-}
-
-ostream& GradientColorValue::save(ostream& output)
-{
-	ParticleValue::save(output);
-	if (!active) return output;
-	output << "colorsCount: " << colors.size() << "\n";
-	for (int i = 0; i != colors.size(); i++)
-		output << "colors" << i << ": " << colors[i] << "\n";
-	output << "timelineCount: " << timeline.size() << "\n";
-	for (int i = 0; i != timeline.size(); i++)
-		output << "timeline" << i << ": " << timeline[i] << "\n";
-	return output;
-}
-
-void GradientColorValue::load(GradientColorValue& value)
-{
-	ParticleValue::load(value);
-	colors.clear();
-	for (float v : value.colors){
-		colors.push_back(v);
-	}
-	timeline.clear();
-	for (float v : value.timeline){
-		timeline.push_back(v);
-	}
-}
-
-void GradientColorValue::load(istream& reader)
-{
-	ParticleValue::load(reader);
-	if (!active) return;
-	colors.clear();
-	int colorsCount = readInt(reader, "colorsCount");
-	for (int i = 0; i < colorsCount; i++){
-		colors.push_back(readFloat(reader, "colors" + i));
-	}
-	timeline.clear();
-	int timelineCount = readInt(reader, "timelineCount");
-	for (int i = 0; i < timelineCount; i++){
-		timeline.push_back(readFloat(reader, "timeline" + i));
-	}
-}
-
-void Particle::setPosition(float x, float y)
-{
-	_position.x = x;
-	_position.y = y;
-}
-
-void Particle::translate(float dx, float dy)
-{
-	_position.x += dx;
-	_position.y += dy;
-}
-
 BoundingBox BoundingBox::clr()
 {
 	min.set(0, 0, 0);
@@ -136,35 +52,11 @@ BoundingBox& BoundingBox::ext(const BoundingBox& a_bounds)
 
 const Vec3 BoundingBox::tmpVector;
 
-Color3B ParticleEmitter::tempColor;
-
-ParticleEmitter::ParticleEmitter(ParticleEmitter* emitter)
+ParticleEmitter::ParticleEmitter(ParticleEmitter* emitter) : ParticleEmitter()
 {
 	init(emitter);
 }
 
-void ParticleEmitter::setPosition(float x, float y)
-{
-	if (!attached) {
-		float xAmount = this->dx - x;
-		float yAmount = this->dy - y;
-		for (int i = 0; i < maxParticleCount; i++)
-			if (active[i]) particles[i]->translate(xAmount, yAmount);
-	}
-	dx = x;
-	dy = y;
-}
-
-void ParticleEmitter::translate(float x, float y)
-{
-	if (!attached) {
-		for (int i = 0; i < maxParticleCount; i++)
-			if (active[i]) particles[i]->translate(-x, -y);
-	}
-	dx += x;
-	dy += y;
-}
-
 void ParticleEmitter::setFlip(bool flipX, bool flipY)
 {
 	this->_flipX = flipX;
@@ -174,40 +66,30 @@ void ParticleEmitter::setFlip(bool flipX, bool flipY)
 
 void ParticleEmitter::setSprite(Sprite* sprite)
 {
-	CC_SAFE_RELEASE_NULL(this->sprite);
+	CC_SAFE_RETAIN(sprite);
+	CC_SAFE_RELEASE(this->sprite);
 	this->sprite = sprite;
 	if (!sprite) return;
-	sprite->retain();
 	auto& size = sprite->getContentSize();
 	_spriteWidth = size.width;
 	_spriteHeight = size.height;
 	updateTexCoords();
 }
 
+ParticleEmitter::~ParticleEmitter()
+{
+	CC_SAFE_RELEASE(definition());
+	CC_SAFE_RELEASE_NULL(sprite);
+	CC_SAFE_RELEASE(_bakedLoop);
+	CC_SAFE_FREE(_quads);
+	ParticleBufferPool::getInstance()->returnVertexBuffer(_vertexBuffer);
+}
+
 void ParticleEmitter::init(ParticleEmitter* emitter)
 {
-	name = emitter->name;
-	imagePath = emitter->imagePath;
+	setDefinition(emitter->definition());
 	setMaxParticleCount(emitter->maxParticleCount);
 	minParticleCount = emitter->minParticleCount;
-	delayValue.load(emitter->delayValue);
-	durationValue.load(emitter->durationValue);
-	emissionValue.load(emitter->emissionValue);
-	lifeValue.load(emitter->lifeValue);
-	lifeOffsetValue.load(emitter->lifeOffsetValue);
-	scaleValue.load(emitter->scaleValue);
-	rotationValue.load(emitter->rotationValue);
-	velocityValue.load(emitter->velocityValue);
-	angleValue.load(emitter->angleValue);
-	windValue.load(emitter->windValue);
-	gravityValue.load(emitter->gravityValue);
-	transparencyValue.load(emitter->transparencyValue);
-	tintValue.load(emitter->tintValue);
-	xOffsetValue.load(emitter->xOffsetValue);
-	yOffsetValue.load(emitter->yOffsetValue);
-	spawnWidthValue.load(emitter->spawnWidthValue);
-	spawnHeightValue.load(emitter->spawnHeightValue);
-	spawnShapeValue.load(emitter->spawnShapeValue);
 	attached = emitter->attached;
 	continuous = emitter->continuous;
 	aligned = emitter->aligned;
@@ -215,251 +97,173 @@ void ParticleEmitter::init(ParticleEmitter* emitter)
 	additive = emitter->additive;
 	premultipliedAlpha = emitter->premultipliedAlpha;
 	this->_cleansUpBlendFunction = emitter->_cleansUpBlendFunction;
+	// Recycled emitters come back with the runtime state of their last run.
+	for (int i = 0; i < maxParticleCount; i++){
+		active[i] = false;
+	}
+	activeCount = 0;
+	accumulator = 0;
+	_throttle = 1;
+	_emitting = true;
+	_stats.reset();
+	emissionDelta = 0;
+	dx = dy = 0;
+	_originX = _originY = 0;
+	_spawnPinned = false;
+	_spawnX = _spawnY = 0;
+	setRecordedEvents(0);
+	clearEvents();
+	setBakedLoop(emitter->_bakedLoop, emitter->_bakedTime);
+	_flipX = emitter->_flipX;
+	_flipY = emitter->_flipY;
 	setSprite(emitter->sprite);
 	updateBlendFunc();
 	initGLProgramState();
 }
 
+void ParticleEmitter::setDefinition(EmitterDefinition* definition)
+{
+	CC_SAFE_RETAIN(definition);
+	CC_SAFE_RELEASE(this->definition());
+	ParticleSimulation::setDefinition(definition);
+}
+
+EmitterDefinition* ParticleEmitter::mutableDefinition()
+{
+	auto definition = this->definition();
+	if (definition->getReferenceCount() > 1) {
+		definition->release();
+		definition = definition->clone();
+		_definition = definition;
+	}
+	return definition;
+}
+
 void ParticleEmitter::draw(Renderer *renderer, const Mat4 &transform, uint32_t flags)
 {
-	//quad command
-	if (activeCount > 0){
-		_quadCommand.init(_globalZOrder, sprite->getTexture()->getName(), getGLProgramState(), _blendFunc, _quads, activeCount, transform, flags);
-		renderer->addCommand(&_quadCommand);
+	// Headless emitters have no GL buffer to draw from.
+	if (getQuadCount() > 0 && _vertexBuffer.vbo){
+		PARTICLE_TRACE("ParticleEmitter::draw");
+		_customCommand.init(_globalZOrder, transform, flags);
+		_customCommand.func = CC_CALLBACK_0(ParticleEmitter::onDraw, this, transform, flags);
+		renderer->addCommand(&_customCommand);
+		PARTICLE_STATS(beginStatsFrame(); _stats.drawCalls++);
 	}
 }
 
-void ParticleEmitter::setMaxParticleCount(int maxParticleCount)
+void ParticleEmitter::onDraw(const Mat4& transform, uint32_t flags)
 {
-	if (this->maxParticleCount == maxParticleCount) return;
+	if (_quadsDirty) postStep();
+	int quadCount = std::min(getQuadCount(), ParticleBufferPool::MAX_QUADS);
 
-	if (active) delete[]active;
-	active = new bool[maxParticleCount];
-	for (int i = 0; i < maxParticleCount; ++i){
-		active[i] = false;
-	}
+	auto glProgram = getGLProgram();
+	glProgram->use();
+	glProgram->setUniformsForBuiltins(transform);
+	GL::bindTexture2D(sprite->getTexture()->getName());
+	GL::blendFunc(_blendFunc.src, _blendFunc.dst);
 
-	if (particles){
-		auto pool = ParticlePool::getInstance();
-		for (int i = 0; i < this->maxParticleCount; ++i){
-			pool->freeToPool(particles[i]);
-		}
-	}
-	particles = new Particle*[maxParticleCount];
-	for (int i = 0; i < maxParticleCount; ++i){
-		particles[i] = nullptr;
+	if (_vertexBuffer.vao){
+		GL::bindVAO(_vertexBuffer.vao);
+		glDrawElements(GL_TRIANGLES, (GLsizei)quadCount * 6, GL_UNSIGNED_SHORT, nullptr);
+		GL::bindVAO(0);
 	}
+	else{
+#define kQuadSize sizeof(V3F_C4B_T2F)
+		glBindBuffer(GL_ARRAY_BUFFER, _vertexBuffer.vbo);
+		GL::enableVertexAttribs(GL::VERTEX_ATTRIB_FLAG_POS_COLOR_TEX);
+		glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_POSITION, 2, GL_FLOAT, GL_FALSE, kQuadSize, (GLvoid*)offsetof(V3F_C4B_T2F, vertices));
+		glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, kQuadSize, (GLvoid*)offsetof(V3F_C4B_T2F, colors));
+		glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_TEX_COORD, 2, GL_FLOAT, GL_FALSE, kQuadSize, (GLvoid*)offsetof(V3F_C4B_T2F, texCoords));
+#undef kQuadSize
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ParticleBufferPool::getInstance()->getIndexBuffer(quadCount));
+		glDrawElements(GL_TRIANGLES, (GLsizei)quadCount * 6, GL_UNSIGNED_SHORT, nullptr);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	CC_INCREMENT_GL_DRAWN_BATCHES_AND_VERTICES(1, quadCount * 6);
+	CHECK_GL_ERROR_DEBUG();
+}
 
+void ParticleEmitter::setMaxParticleCount(int maxParticleCount)
+{
+	if (this->maxParticleCount == maxParticleCount) return;
 
 	// If we are setting the total number of particles to a number higher
 	// than what is allocated, we need to allocate new arrays
-	if (maxParticleCount > _allocatedParticles)
+	bool grown = maxParticleCount > _allocatedParticles;
+	if (grown)
 	{
 		// Allocate new memory
 		size_t quadsSize = sizeof(_quads[0]) * maxParticleCount * 1;
-		size_t indicesSize = sizeof(_indices[0]) * maxParticleCount * 6 * 1;
 
 		V3F_C4B_T2F_Quad* quadsNew = (V3F_C4B_T2F_Quad*)realloc(_quads, quadsSize);
-		GLushort* indicesNew = (GLushort*)realloc(_indices, indicesSize);
 
-		if (quadsNew && indicesNew){
+		if (quadsNew){
 			// Assign pointers
 			_quads = quadsNew;
-			_indices = indicesNew;
 
 			// Clear the memory
 			memset(_quads, 0, quadsSize);
-			memset(_indices, 0, indicesSize);
 
 			_allocatedParticles = maxParticleCount;
 		}
 		else{
 			// Out of memory, failed to resize some array
-			if (quadsNew) _quads = quadsNew;
-			if (indicesNew) _indices = indicesNew;
-
 			CCLOG("Particle system: out of memory");
 			return;
 		}
 
-		this->maxParticleCount = maxParticleCount;
-
-		initIndices();
-		if (Configuration::getInstance()->supportsShareableVAO()){
-			setupVBOandVAO();
+		// Buffers come from the shared pool, so this only touches GL when the pool has no fitting bucket.
+		if (_vertexBuffer.capacity < maxParticleCount){
+			auto pool = ParticleBufferPool::getInstance();
+			pool->returnVertexBuffer(_vertexBuffer);
+			_vertexBuffer = pool->borrowVertexBuffer(maxParticleCount);
+			_quadsDirty = true;
 		}
-		else{
-			setupVBO();
-		}
-
-		// fixed http://www.cocos2d-x.org/issues/3990
-		// Updates texture coords.
-		updateTexCoords();
 	}
-	else{
-		this->maxParticleCount = maxParticleCount;
-	}
-
 
+	ParticleSimulation::setMaxParticleCount(maxParticleCount);
 
-}
-
-void ParticleEmitter::addParticle()
-{
-	int activeCount = this->activeCount;
-	if (activeCount == maxParticleCount) return;
-	for (int i = 0; i < maxParticleCount; i++) {
-		if (!active[i]) {
-			activateParticle(i);
-			active[i] = true;
-			this->activeCount = activeCount + 1;
-			break;
-		}
-	}
-}
-
-void ParticleEmitter::addParticles(int count)
-{
-	count = std::min(count, maxParticleCount - activeCount);
-	if (count == 0) return;
-	for (int index = 0, i = 0; i < count && index != maxParticleCount; index++) {
-		if (!active[index]) {
-			activateParticle(index);
-			active[index] = true;
-			i++;
-		}
-	}
-	this->activeCount += count;
+	// fixed http://www.cocos2d-x.org/issues/3990
+	// Updates texture coords.
+	if (grown) updateTexCoords();
 }
 
 void ParticleEmitter::update(float delta)
 {
 	CC_PROFILER_START_CATEGORY(kProfilerCategoryParticles, "ParticleEmitter - update");
-	accumulator += delta * 1000;
-	if (accumulator < 1) return;
-	int deltaMillis = (int)accumulator;
-	accumulator -= deltaMillis;
-
-	if (delayTimer < delay) {
-		delayTimer += deltaMillis;
-	}
-	else {
-		bool done = false;
-		if (firstUpdate) {
-			firstUpdate = false;
-			addParticle();
-		}
-
-		if (durationTimer < duration)
-			durationTimer += deltaMillis;
-		else {
-			if (!continuous || _allowCompletion)
-				done = true;
-			else
-				restart();
-		}
-
-		if (!done) {
-			emissionDelta += deltaMillis;
-			float emissionTime = emission + emissionDiff * emissionValue.getScale(durationTimer / (float)duration);
-			if (emissionTime > 0) {
-				emissionTime = 1000 / emissionTime;
-				if (emissionDelta >= emissionTime) {
-					int emitCount = (int)(emissionDelta / emissionTime);
-					emitCount = std::min(emitCount, maxParticleCount - activeCount);
-					emissionDelta -= emitCount * emissionTime;
-					emissionDelta = std::fmod(emissionDelta, emissionTime);
-					addParticles(emitCount);
-				}
-			}
-			if (activeCount < minParticleCount) addParticles(minParticleCount - activeCount);
-		}
+	PARTICLE_TRACE("ParticleEmitter::update");
+	PARTICLE_STATS(beginStatsFrame());
+	if (_bakedLoop) {
+		playBakedLoop(delta);
 	}
-
-
-	int activeCount = this->activeCount;
-	for (int i = 0; i < maxParticleCount; i++) {
-		if (active[i] && !updateParticle(particles[i], delta, deltaMillis)) {
-			active[i] = false;
-			activeCount--;
-		}
+	else if (step(delta)) {
+		updateParticleQuads();
+		_quadsDirty = true;
 	}
-	this->activeCount = activeCount;
-	updateParticleQuads();
-	postStep();
 	CC_PROFILER_STOP_CATEGORY(kProfilerCategoryParticles, "ParticleEmitter - update");
 }
 
-void ParticleEmitter::start()
+void ParticleEmitter::simulate(float delta)
 {
-	firstUpdate = true;
-	_allowCompletion = false;
-	restart();
+	PARTICLE_STATS(beginStatsFrame());
+	// The next update decodes wherever the loop got to.
+	if (_bakedLoop) _bakedTime = std::fmod(_bakedTime + delta, _bakedLoop->getPeriod());
+	else step(delta);
 }
 
-void ParticleEmitter::reset()
+void ParticleEmitter::burst(float x, float y, int count, const BurstParams& params)
 {
-	emissionDelta = 0;
-	durationTimer = duration;
-	for (int i = 0; i < maxParticleCount; i++){
-		active[i] = false;
-	}
-	activeCount = 0;
-	start();
-}
-
-void ParticleEmitter::restart()
-{
-	delay = delayValue.active ? delayValue.newLowValue() : 0;
-	delayTimer = 0;
-
-	durationTimer -= duration;
-	duration = durationValue.newLowValue();
-
-	emission = (int)emissionValue.newLowValue();
-	emissionDiff = (int)emissionValue.newHighValue();
-	if (!emissionValue.isRelative()) emissionDiff -= emission;
-
-	life = (int)lifeValue.newLowValue();
-	lifeDiff = (int)lifeValue.newHighValue();
-	if (!lifeValue.isRelative()) lifeDiff -= life;
-
-	lifeOffset = lifeOffsetValue.active ? (int)lifeOffsetValue.newLowValue() : 0;
-	lifeOffsetDiff = (int)lifeOffsetValue.newHighValue();
-	if (!lifeOffsetValue.isRelative()) lifeOffsetDiff -= lifeOffset;
-
-	spawnWidth = spawnWidthValue.newLowValue();
-	spawnWidthDiff = spawnWidthValue.newHighValue();
-	if (!spawnWidthValue.isRelative()) spawnWidthDiff -= spawnWidth;
-
-	spawnHeight = spawnHeightValue.newLowValue();
-	spawnHeightDiff = spawnHeightValue.newHighValue();
-	if (!spawnHeightValue.isRelative()) spawnHeightDiff -= spawnHeight;
-
-	updateFlags = 0;
-	if (angleValue.active && angleValue.timeline.size() > 1) updateFlags |= UPDATE_ANGLE;
-	if (velocityValue.active) updateFlags |= UPDATE_VELOCITY;
-	if (scaleValue.timeline.size() > 1) updateFlags |= UPDATE_SCALE;
-	if (rotationValue.active && rotationValue.timeline.size() > 1) updateFlags |= UPDATE_ROTATION;
-	if (windValue.active) updateFlags |= UPDATE_WIND;
-	if (gravityValue.active) updateFlags |= UPDATE_GRAVITY;
-	if (tintValue.timeline.size() > 1) updateFlags |= UPDATE_TINT;
+	PARTICLE_STATS(beginStatsFrame());
+	ParticleSimulation::burst(x, y, count, params);
 }
 
-void ParticleEmitter::initIndices()
+void ParticleEmitter::extrapolate(float elapsed)
 {
-	for (int i = 0; i < maxParticleCount; ++i)
-	{
-		const unsigned int i6 = i * 6;
-		const unsigned int i4 = i * 4;
-		_indices[i6 + 0] = (GLushort)i4 + 0;
-		_indices[i6 + 1] = (GLushort)i4 + 1;
-		_indices[i6 + 2] = (GLushort)i4 + 2;
-
-		_indices[i6 + 5] = (GLushort)i4 + 1;
-		_indices[i6 + 4] = (GLushort)i4 + 2;
-		_indices[i6 + 3] = (GLushort)i4 + 3;
-	}
+	if (_bakedLoop) return;
+	updateParticleQuads(elapsed);
+	_quadsDirty = true;
 }
 
 // pointRect should be in Texture coordinates, not pixel coordinates
@@ -529,6 +333,7 @@ void ParticleEmitter::initTexCoordsWithRect(const Rect& pointRect){
 		quads[i].tr.texCoords.u = right;
 		quads[i].tr.texCoords.v = top;
 	}
+	_quadsDirty = true;
 }
 
 void ParticleEmitter::updateTexCoords()
@@ -540,102 +345,99 @@ void ParticleEmitter::updateTexCoords()
 	}
 }
 
-void ParticleEmitter::updateParticleQuads(){
+void ParticleEmitter::updateParticleQuads(float elapsed){
 	if (activeCount <= 0) {
 		return;
 	}
+	PARTICLE_TRACE("ParticleEmitter::updateParticleQuads");
+	PARTICLE_STATS(beginStatsFrame());
+	PARTICLE_STATS_TIMER(_stats.quadTime);
 
+	bool moved = elapsed > 0 && _motion;
 	V3F_C4B_T2F_Quad *startQuad = &(_quads[0]);
 	for (int i = 0; i < maxParticleCount; ++i){
 		if (active[i]){
-			auto particle = particles[i];
-			updatePosWithParticle(startQuad, particle, _spriteWidth, _spriteHeight);
-			auto& color = particle->_color;
-			startQuad->bl.colors.set(color.r, color.g, color.b, particle->_opacity);
-			startQuad->br.colors.set(color.r, color.g, color.b, particle->_opacity);
-			startQuad->tl.colors.set(color.r, color.g, color.b, particle->_opacity);
-			startQuad->tr.colors.set(color.r, color.g, color.b, particle->_opacity);
+			auto particle = &particles[i];
+			if (moved) {
+				Particle extrapolated = *particle;
+				extrapolated.x += _motion[i * 2] * elapsed;
+				extrapolated.y += _motion[i * 2 + 1] * elapsed;
+				updatePosWithParticle(startQuad, &extrapolated, _spriteWidth, _spriteHeight);
+			}
+			else
+				updatePosWithParticle(startQuad, particle, _spriteWidth, _spriteHeight);
+			const ParticleColor& particleColor = particle->color;
+			Color4B color(particleColor.r, particleColor.g, particleColor.b, particleColor.a);
+			startQuad->bl.colors = color;
+			startQuad->br.colors = color;
+			startQuad->tl.colors = color;
+			startQuad->tr.colors = color;
 			++startQuad;
 		}
 	}
 }
 
-void ParticleEmitter::setupVBOandVAO()
+void NS_CUSTOM::ParticleEmitter::postStep()
 {
-	// clean VAO
-	glDeleteBuffers(2, &_buffersVBO[0]);
-	glDeleteVertexArrays(1, &_VAOname);
-	GL::bindVAO(0);
-
-	glGenVertexArrays(1, &_VAOname);
-	GL::bindVAO(_VAOname);
+	_quadsDirty = false;
+	int quadCount = std::min(getQuadCount(), _vertexBuffer.capacity);
+	if (quadCount <= 0 || !_vertexBuffer.vbo) return;
+	PARTICLE_TRACE("ParticleEmitter::postStep");
+	PARTICLE_STATS(_stats.uploadedBytes += sizeof(_quads[0]) * quadCount);
 
-#define kQuadSize sizeof(_quads[0].bl)
-
-	glGenBuffers(2, &_buffersVBO[0]);
-
-	glBindBuffer(GL_ARRAY_BUFFER, _buffersVBO[0]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(_quads[0]) * maxParticleCount, _quads, GL_DYNAMIC_DRAW);
-
-	// vertices
-	glEnableVertexAttribArray(GLProgram::VERTEX_ATTRIB_POSITION);
-	glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_POSITION, 2, GL_FLOAT, GL_FALSE, kQuadSize, (GLvoid*)offsetof(V3F_C4B_T2F, vertices));
+	glBindBuffer(GL_ARRAY_BUFFER, _vertexBuffer.vbo);
 
-	// colors
-	glEnableVertexAttribArray(GLProgram::VERTEX_ATTRIB_COLOR);
-	glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, kQuadSize, (GLvoid*)offsetof(V3F_C4B_T2F, colors));
+	// Option 1: Sub Data, only the quads updateParticleQuads packed at the front
+	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(_quads[0])*quadCount, _quads);
 
-	// tex coords
-	glEnableVertexAttribArray(GLProgram::VERTEX_ATTRIB_TEX_COORD);
-	glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_TEX_COORD, 2, GL_FLOAT, GL_FALSE, kQuadSize, (GLvoid*)offsetof(V3F_C4B_T2F, texCoords));
+	// Option 2: Data
+	//  glBufferData(GL_ARRAY_BUFFER, sizeof(quads_[0]) * particleCount, quads_, GL_DYNAMIC_DRAW);
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _buffersVBO[1]);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(_indices[0]) * maxParticleCount * 6, _indices, GL_STATIC_DRAW);
+	// Option 3: Orphaning + glMapBuffer
+	// glBufferData(GL_ARRAY_BUFFER, sizeof(_quads[0])*_totalParticles, nullptr, GL_STREAM_DRAW);
+	// void *buf = glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+	// memcpy(buf, _quads, sizeof(_quads[0])*_totalParticles);
+	// glUnmapBuffer(GL_ARRAY_BUFFER);
 
-	// Must unbind the VAO before changing the element buffer.
-	GL::bindVAO(0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 	CHECK_GL_ERROR_DEBUG();
 }
 
-void ParticleEmitter::setupVBO()
+void NS_CUSTOM::ParticleEmitter::setBakedLoop(ParticleBakedLoop* loop, float phase)
 {
-	glDeleteBuffers(2, &_buffersVBO[0]);
-
-	glGenBuffers(2, &_buffersVBO[0]);
-
-	glBindBuffer(GL_ARRAY_BUFFER, _buffersVBO[0]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(_quads[0]) * maxParticleCount, _quads, GL_DYNAMIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _buffersVBO[1]);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(_indices[0]) * maxParticleCount * 6, _indices, GL_STATIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-
-	CHECK_GL_ERROR_DEBUG();
+	CC_SAFE_RETAIN(loop);
+	CC_SAFE_RELEASE(_bakedLoop);
+	_bakedLoop = loop;
+	_bakedCount = 0;
+	for (int i = 0; i < maxParticleCount; i++){
+		active[i] = false;
+	}
+	activeCount = 0;
+	setBakedPhase(phase);
 }
 
-void NS_CUSTOM::ParticleEmitter::postStep()
+void NS_CUSTOM::ParticleEmitter::setBakedPhase(float phase)
 {
-	glBindBuffer(GL_ARRAY_BUFFER, _buffersVBO[0]);
-
-	// Option 1: Sub Data
-	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(_quads[0])*maxParticleCount, _quads);
-
-	// Option 2: Data
-	//  glBufferData(GL_ARRAY_BUFFER, sizeof(quads_[0]) * particleCount, quads_, GL_DYNAMIC_DRAW);
-
-	// Option 3: Orphaning + glMapBuffer
-	// glBufferData(GL_ARRAY_BUFFER, sizeof(_quads[0])*_totalParticles, nullptr, GL_STREAM_DRAW);
-	// void *buf = glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
-	// memcpy(buf, _quads, sizeof(_quads[0])*_totalParticles);
-	// glUnmapBuffer(GL_ARRAY_BUFFER);
+	_bakedFrame = -1;
+	_bakedTime = _bakedLoop ? std::fmod(std::max(phase, 0.0f), _bakedLoop->getPeriod()) : 0;
+}
 
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+void NS_CUSTOM::ParticleEmitter::playBakedLoop(float delta)
+{
+	_bakedTime = std::fmod(_bakedTime + delta, _bakedLoop->getPeriod());
+	int frame = _bakedLoop->getFrame(_bakedTime);
+	// Between recorded frames there is nothing to decode or upload.
+	if (frame == _bakedFrame) return;
+	_bakedFrame = frame;
+	_bakedCount = _bakedLoop->decode(frame, _quads, _allocatedParticles);
+	_quadsDirty = true;
+}
 
-	CHECK_GL_ERROR_DEBUG();
+BoundingBox& NS_CUSTOM::ParticleEmitter::getBakedBounds()
+{
+	bounds.set(_bakedLoop->getBounds());
+	return bounds;
 }
 
 void ParticleEmitter::updateBlendFunc()
@@ -654,22 +456,22 @@ void ParticleEmitter::updateBlendFunc()
 void ParticleEmitter::initGLProgramState()
 {
 	if (getGLProgramState()) return;
-	setGLProgramState(GLProgramState::getOrCreateWithGLProgramName(GLProgram::SHADER_NAME_POSITION_TEXTURE_COLOR_NO_MVP));
+	setGLProgramState(GLProgramState::getOrCreateWithGLProgramName(GLProgram::SHADER_NAME_POSITION_TEXTURE_COLOR));
 }
 
 inline void NS_CUSTOM::ParticleEmitter::updatePosWithParticle(V3F_C4B_T2F_Quad *quad, Particle* particle, float spriteW, float spriteH)
 {
 	// vertices
-	GLfloat x2 = spriteW * particle->_scale / 2;
-	GLfloat y2 = spriteH * particle->_scale / 2;
+	GLfloat x2 = spriteW * particle->scale / 2;
+	GLfloat y2 = spriteH * particle->scale / 2;
 
 	GLfloat x1 = -x2;
 	GLfloat y1 = -y2;
 
-	GLfloat x = particle->_position.x + spriteW / 2;
-	GLfloat y = particle->_position.y + spriteH / 2;
+	GLfloat x = particle->x + spriteW / 2 + _originX;
+	GLfloat y = particle->y + spriteH / 2 + _originY;
 
-	GLfloat r = (GLfloat)CC_DEGREES_TO_RADIANS(particle->_rotation);
+	GLfloat r = (GLfloat)CC_DEGREES_TO_RADIANS(particle->rotation);
 	GLfloat cr = cosFast(r);
 	GLfloat sr = sinFast(r);
 
@@ -699,678 +501,263 @@ inline void NS_CUSTOM::ParticleEmitter::updatePosWithParticle(V3F_C4B_T2F_Quad *
 	quad->tr.vertices.y = cy;
 }
 
-void ParticleEmitter::initialize()
-{
-	durationValue.setAlwaysActive(true);
-	emissionValue.setAlwaysActive(true);
-	lifeValue.setAlwaysActive(true);
-	scaleValue.setAlwaysActive(true);
-	transparencyValue.setAlwaysActive(true);
-	spawnShapeValue.setAlwaysActive(true);
-	spawnWidthValue.setAlwaysActive(true);
-	spawnHeightValue.setAlwaysActive(true);
-}
-
-Particle* ParticleEmitter::newParticle(Sprite* sprite)
-{
-	return ParticlePool::getInstance()->getFromPool();
-}
-
-void ParticleEmitter::activateParticle(int index)
-{
-	if (!particles[index]) {
-		particles[index] = newParticle(sprite);
-	}
-	auto particle = particles[index];
-
-	float percent = durationTimer / (float)duration;
-	int updateFlags = this->updateFlags;
-
-	particle->currentLife = particle->life = life + (int)(lifeDiff * lifeValue.getScale(percent));
-
-	if (velocityValue.active) {
-		particle->velocity = velocityValue.newLowValue();
-		particle->velocityDiff = velocityValue.newHighValue();
-		if (!velocityValue.isRelative()) particle->velocityDiff -= particle->velocity;
-	}
-
-	particle->angle = angleValue.newLowValue();
-	particle->angleDiff = angleValue.newHighValue();
-	if (!angleValue.isRelative()) particle->angleDiff -= particle->angle;
-	float angle = 0;
-	if ((updateFlags & UPDATE_ANGLE) == 0) {
-		angle = particle->angle + particle->angleDiff * angleValue.getScale(0);
-		particle->angle = angle;
-		particle->angleCos = cosFast(angle*M_PI / 180);
-		particle->angleSin = sinFast(angle*M_PI / 180);
-	}
-
-	float spriteWidth = sprite->getContentSize().width;
-	particle->scale = scaleValue.newLowValue() / spriteWidth;
-	particle->scaleDiff = scaleValue.newHighValue() / spriteWidth;
-	if (!scaleValue.isRelative()) particle->scaleDiff -= particle->scale;
-	particle->_scale = particle->scale + particle->scaleDiff * scaleValue.getScale(0);
-
-	if (rotationValue.active) {
-		particle->rotation = rotationValue.newLowValue();
-		particle->rotationDiff = rotationValue.newHighValue();
-		if (!rotationValue.isRelative()) particle->rotationDiff -= particle->rotation;
-		float rotation = particle->rotation + particle->rotationDiff * rotationValue.getScale(0);
-		if (aligned) rotation += angle;
-		particle->_rotation = rotation;
-	}
-
-	if (windValue.active) {
-		particle->wind = windValue.newLowValue();
-		particle->windDiff = windValue.newHighValue();
-		if (!windValue.isRelative()) particle->windDiff -= particle->wind;
-	}
-
-	if (gravityValue.active) {
-		particle->gravity = gravityValue.newLowValue();
-		particle->gravityDiff = gravityValue.newHighValue();
-		if (!gravityValue.isRelative()) particle->gravityDiff -= particle->gravity;
-	}
-
-	const float_array& temp = tintValue.getColor(0);
-	particle->tint[0] = temp[0];
-	particle->tint[1] = temp[1];
-	particle->tint[2] = temp[2];
-
-	particle->transparency = transparencyValue.newLowValue();
-	particle->transparencyDiff = transparencyValue.newHighValue() - particle->transparency;
-
-	// Spawn.
-	float x = this->getPositionX();
-	if (xOffsetValue.active) x += xOffsetValue.newLowValue();
-	float y = this->getPositionY();
-	if (yOffsetValue.active) y += yOffsetValue.newLowValue();
-	switch (spawnShapeValue.shape) {
-	case square: {
-		float width = spawnWidth + (spawnWidthDiff * spawnWidthValue.getScale(percent));
-		float height = spawnHeight + (spawnHeightDiff * spawnHeightValue.getScale(percent));
-		x += randomf(0.0f, width) - width / 2;
-		y += randomf(0.0f, height) - height / 2;
-		break;
-	}
-	case ellipse: {
-		float width = spawnWidth + (spawnWidthDiff * spawnWidthValue.getScale(percent));
-		float height = spawnHeight + (spawnHeightDiff * spawnHeightValue.getScale(percent));
-		float radiusX = width / 2;
-		float radiusY = height / 2;
-		if (radiusX == 0 || radiusY == 0) break;
-		float scaleY = radiusX / (float)radiusY;
-		if (spawnShapeValue.edges) {
-			float spawnAngle;
-			switch (spawnShapeValue.side) {
-			case top:
-				spawnAngle = -random(0.0f, 179.0f);
-				break;
-			case bottom:
-				spawnAngle = random(0.0f, 179.0f);
-				break;
-			default:
-				spawnAngle = random(0.0f, 360.0f);
-				break;
-			}
-			float cosDeg = cosFast(spawnAngle*M_PI / 180);
-			float sinDeg = sinFast(spawnAngle*M_PI / 180);
-			x += cosDeg * radiusX;
-			y += sinDeg * radiusX / scaleY;
-			if ((updateFlags & UPDATE_ANGLE) == 0) {
-				particle->angle = spawnAngle;
-				particle->angleCos = cosDeg;
-				particle->angleSin = sinDeg;
-			}
-		}
-		else {
-			float radius2 = radiusX * radiusX;
-			while (true) {
-				float px = randomf(0.0f, width) - radiusX;
-				float py = randomf(0.0f, height) - radiusY;
-				if (px * px + py * py <= radius2) {
-					x += px;
-					y += py / scaleY;
-					break;
-				}
-			}
-		}
-		break;
-	}
-	case line: {
-		float width = spawnWidth + (spawnWidthDiff * spawnWidthValue.getScale(percent));
-		float height = spawnHeight + (spawnHeightDiff * spawnHeightValue.getScale(percent));
-		if (width != 0) {
-			float lineX = randomf(0.0f, width);
-			x += lineX;
-			y += lineX * (height / (float)width);
-		}
-		else
-			y += randomf(0.0f, height);
-		break;
-	}
-	}
-
-	float spriteHeight = sprite->getContentSize().height;
-	particle->setPosition(x - spriteWidth / 2, y - spriteHeight / 2);
-
-	int offsetTime = (int)(lifeOffset + lifeOffsetDiff * lifeOffsetValue.getScale(percent));
-	if (offsetTime > 0) {
-		if (offsetTime >= particle->currentLife) offsetTime = particle->currentLife - 1;
-		updateParticle(particle, offsetTime / 1000.0f, offsetTime);
-	}
-}
-
-bool ParticleEmitter::updateParticle(Particle* particle, float delta, int deltaMillis)
+ParticleMemoryUsage ParticleEmitter::getMemoryUsage() const
 {
-	int life = particle->currentLife - deltaMillis;
-	if (life <= 0) return false;
-	particle->currentLife = life;
-
-	float percent = 1 - particle->currentLife / (float)particle->life;
-	int updateFlags = this->updateFlags;
-
-	if ((updateFlags & UPDATE_SCALE) != 0)
-		particle->_scale = particle->scale + particle->scaleDiff * scaleValue.getScale(percent);
-
-	if ((updateFlags & UPDATE_VELOCITY) != 0) {
-		float velocity = (particle->velocity + particle->velocityDiff * velocityValue.getScale(percent)) * delta;
-
-		float velocityX, velocityY;
-		if ((updateFlags & UPDATE_ANGLE) != 0) {
-			float angle = particle->angle + particle->angleDiff * angleValue.getScale(percent);
-			velocityX = velocity * cosFast(angle*M_PI / 180);
-			velocityY = velocity * sinFast(angle*M_PI / 180);
-			if ((updateFlags & UPDATE_ROTATION) != 0) {
-				float rotation = particle->rotation + particle->rotationDiff * rotationValue.getScale(percent);
-				if (aligned) rotation += angle;
-				particle->_rotation = rotation;
-			}
-		}
-		else {
-			velocityX = velocity * particle->angleCos;
-			velocityY = velocity * particle->angleSin;
-			if (aligned || (updateFlags & UPDATE_ROTATION) != 0) {
-				float rotation = particle->rotation + particle->rotationDiff * rotationValue.getScale(percent);
-				if (aligned) rotation += particle->angle;
-				particle->_rotation = rotation;
-			}
-		}
-
-		if ((updateFlags & UPDATE_WIND) != 0)
-			velocityX += (particle->wind + particle->windDiff * windValue.getScale(percent)) * delta;
-
-		if ((updateFlags & UPDATE_GRAVITY) != 0)
-			velocityY += (particle->gravity + particle->gravityDiff * gravityValue.getScale(percent)) * delta;
-
-		particle->translate(velocityX, velocityY);
-	}
-	else {
-		if ((updateFlags & UPDATE_ROTATION) != 0)
-			particle->_rotation = particle->rotation + particle->rotationDiff * rotationValue.getScale(percent);
-	}
-
-	float red, green, blue;
-	if ((updateFlags & UPDATE_TINT) != 0){
-		const auto& color = tintValue.getColor(percent);
-		red = color[0];
-		green = color[1];
-		blue = color[2];
-	}
-	else{
-		red = particle->tint[0];
-		green = particle->tint[1];
-		blue = particle->tint[2];
-	}
-
-	if (premultipliedAlpha) {
-		float alphaMultiplier = additive ? 0 : 1;
-		float a = particle->transparency + particle->transparencyDiff * transparencyValue.getScale(percent);
-		tempColor.r = red * a * 255;
-		tempColor.g = green * a * 255;
-		tempColor.b = blue * a * 255;
-		particle->_color = tempColor;
-		particle->_opacity = a * alphaMultiplier * 255;
-	}
-	else {
-		tempColor.r = red * 255;
-		tempColor.g = green * 255;
-		tempColor.b = blue * 255;
-		particle->_color = tempColor;
-		particle->_opacity = particle->transparency + particle->transparencyDiff * transparencyValue.getScale(percent) * 255;
-	}
-	return true;
-}
-
-bool ParticleEmitter::isComplete()
-{
-	if (continuous) return false;
-	if (delayTimer < delay) return false;
-	return durationTimer >= duration && activeCount == 0;
-}
-
-float ParticleEmitter::getPercentComplete()
-{
-	if (delayTimer < delay) return 0;
-	return std::min(1.0f, durationTimer / (float)duration);
+	ParticleMemoryUsage usage = ParticleSimulation::getMemoryUsage();
+	usage.state = sizeof(ParticleEmitter);
+	usage.quads = sizeof(V3F_C4B_T2F_Quad) * _allocatedParticles;
+	// Headless buffers have a capacity but no GL storage.
+	if (_vertexBuffer.vbo) usage.glBuffers = sizeof(V3F_C4B_T2F_Quad) * _vertexBuffer.capacity;
+	return usage;
 }
 
 void ParticleEmitter::flipY()
 {
+	auto definition = mutableDefinition();
+	auto& angleValue = definition->angleValue;
 	angleValue.setHigh(-angleValue.getHighMin(), -angleValue.getHighMax());
 	angleValue.setLow(-angleValue.getLowMin(), -angleValue.getLowMax());
 
+	auto& gravityValue = definition->gravityValue;
 	gravityValue.setHigh(-gravityValue.getHighMin(), -gravityValue.getHighMax());
 	gravityValue.setLow(-gravityValue.getLowMin(), -gravityValue.getLowMax());
 
+	auto& windValue = definition->windValue;
 	windValue.setHigh(-windValue.getHighMin(), -windValue.getHighMax());
 	windValue.setLow(-windValue.getLowMin(), -windValue.getLowMax());
 
+	auto& rotationValue = definition->rotationValue;
 	rotationValue.setHigh(-rotationValue.getHighMin(), -rotationValue.getHighMax());
 	rotationValue.setLow(-rotationValue.getLowMin(), -rotationValue.getLowMax());
 
+	auto& yOffsetValue = definition->yOffsetValue;
 	yOffsetValue.setLow(-yOffsetValue.getLowMin(), -yOffsetValue.getLowMax());
 }
 
 ostream& ParticleEmitter::save(ostream& output)
 {
-	output << name << "\n";
-	output << "- Delay -\n";
-	delayValue.save(output);
-	output << "- Duration - \n";
-	durationValue.save(output);
-	output << "- Count - \n";
-	output << "min: " << minParticleCount << "\n";
-	output << "max: " << maxParticleCount << "\n";
-	output << "- Emission - \n";
-	emissionValue.save(output);
-	output << "- Life - \n";
-	lifeValue.save(output);
-	output << "- Life Offset - \n";
-	lifeOffsetValue.save(output);
-	output << "- X Offset - \n";
-	xOffsetValue.save(output);
-	output << "- Y Offset - \n";
-	yOffsetValue.save(output);
-	output << "- Spawn Shape - \n";
-	spawnShapeValue.save(output);
-	output << "- Spawn Width - \n";
-	spawnWidthValue.save(output);
-	output << "- Spawn Height - \n";
-	spawnHeightValue.save(output);
-	output << "- Scale - \n";
-	scaleValue.save(output);
-	output << "- Velocity - \n";
-	velocityValue.save(output);
-	output << "- Angle - \n";
-	angleValue.save(output);
-	output << "- Rotation - \n";
-	rotationValue.save(output);
-	output << "- Wind - \n";
-	windValue.save(output);
-	output << "- Gravity - \n";
-	gravityValue.save(output);
-	output << "- Tint - \n";
-	tintValue.save(output);
-	output << "- Transparency - \n";
-	transparencyValue.save(output);
-	output << "- Options - \n";
-	output << "attached: " << (attached ? "true" : "false") << "\n";
-	output << "continuous: " << (continuous ? "true" : "false") << "\n";
-	output << "aligned: " << (aligned ? "true" : "false") << "\n";
-	output << "additive: " << (additive ? "true" : "false") << "\n";
-	output << "behind: " << (behind ? "true" : "false") << "\n";
-	output << "premultipliedAlpha: " << (premultipliedAlpha ? "true" : "false") << "\n";
-	output << "- Image Path -\n";
-	output << imagePath << "\n";
-	return output;
+	// Saving leaves the shared definition as it is; the emitter's own counts and options are written over it.
+	return _definition->save(output, minParticleCount, maxParticleCount, attached, continuous, aligned, additive,
+		behind, premultipliedAlpha);
 }
 
 void ParticleEmitter::load(istream& reader)
 {
-	string line;
-	name = readString(reader, "name");
-	getline(reader, line);
-	delayValue.load(reader);
-	getline(reader, line);
-	durationValue.load(reader);
-	getline(reader, line);
-	setMinParticleCount(readInt(reader, "minParticleCount"));
-	setMaxParticleCount(readInt(reader, "maxParticleCount"));
-	getline(reader, line);
-	emissionValue.load(reader);
-	getline(reader, line);
-	lifeValue.load(reader);
-	getline(reader, line);
-	lifeOffsetValue.load(reader);
-	getline(reader, line);
-	xOffsetValue.load(reader);
-	getline(reader, line);
-	yOffsetValue.load(reader);
-	getline(reader, line);
-	spawnShapeValue.load(reader);
-	getline(reader, line);
-	spawnWidthValue.load(reader);
-	getline(reader, line);
-	spawnHeightValue.load(reader);
-	getline(reader, line);
-	scaleValue.load(reader);
-	getline(reader, line);
-	velocityValue.load(reader);
-	getline(reader, line);
-	angleValue.load(reader);
-	getline(reader, line);
-	rotationValue.load(reader);
-	getline(reader, line);
-	windValue.load(reader);
-	getline(reader, line);
-	gravityValue.load(reader);
-	getline(reader, line);
-	tintValue.load(reader);
-	getline(reader, line);
-	transparencyValue.load(reader);
-	getline(reader, line);
-	attached = readBoolean(reader, "attached");
-	continuous = readBoolean(reader, "continuous");
-	aligned = readBoolean(reader, "aligned");
-	additive = readBoolean(reader, "additive");
-	behind = readBoolean(reader, "behind");
-
-	// Backwards compatibility
-	getline(reader, line);
-	if (startWith(line, "premultipliedAlpha")) {
-		premultipliedAlpha = readBoolean(line);
-		getline(reader, line);
-	}
-	getline(reader, line);
-	setImagePath(trim(line));
+	auto definition = new EmitterDefinition();
+	definition->load(reader);
+	init(definition);
+	definition->release();
+}
 
+void ParticleEmitter::init(EmitterDefinition* definition)
+{
+	setDefinition(definition);
 	updateBlendFunc();
 	initGLProgramState();
 }
 
-ostream& NumericValue::save(ostream& output)
-{
-	ParticleValue::save(output);
-	if (!active) return output;
-	output << "value: " << value << "\n";
-	return  output;
-}
+EmitterDefinition* EmitterDefinition::_default = nullptr;
 
-void NumericValue::load(NumericValue& value)
+EmitterDefinition::EmitterDefinition() :
+	_source(nullptr)
 {
-	ParticleValue::load(value);
-	this->value = value.value;
 }
 
-void NumericValue::load(istream& reader)
+EmitterDefinition::~EmitterDefinition()
 {
-	ParticleValue::load(reader);
-	if (!active) return;
-	value = readFloat(reader, "value");
+	CC_SAFE_RELEASE(_source);
 }
 
-ostream& RangedNumericValue::save(ostream& output)
+EmitterDefinition* EmitterDefinition::clone()
 {
-	ParticleValue::save(output);
-	if (!active) return output;
-	output << "lowMin: " << lowMin << "\n";
-	output << "lowMax: " << lowMax << "\n";
-	return output;
+	auto definition = new EmitterDefinition();
+	definition->load(this);
+	return definition;
 }
 
-void NS_CUSTOM::RangedNumericValue::load(RangedNumericValue& value)
+EmitterDefinition* EmitterDefinition::getDefault()
 {
-	ParticleValue::load(value);
-	lowMax = value.lowMax;
-	lowMin = value.lowMin;
+	if (!_default){
+		_default = new EmitterDefinition();
+	}
+	return _default;
 }
 
-void NS_CUSTOM::RangedNumericValue::load(istream& reader)
+ParticleMemoryUsage EmitterDefinition::getMemoryUsage() const
 {
-	ParticleValue::load(reader);
-	if (!active) return;
-	lowMin = readFloat(reader, "lowMin");
-	lowMax = readFloat(reader, "lowMax");
+	ParticleMemoryUsage usage = ParticleDefinition::getMemoryUsage();
+	usage.state += sizeof(EmitterDefinition) - sizeof(ParticleDefinition);
+	return usage;
 }
 
-float ScaledNumericValue::getScale(float percent)
+void EmitterDefinition::load(istream& reader)
 {
-	int endIndex = -1;
-	int n = timeline.size();
-	for (int i = 1; i < n; i++) {
-		float t = timeline[i];
-		if (t > percent) {
-			endIndex = i;
-			break;
-		}
-	}
-	if (endIndex == -1) return scaling[n - 1];
-	int startIndex = endIndex - 1;
-	float startValue = scaling[startIndex];
-	float startTime = timeline[startIndex];
-	return startValue + (scaling[endIndex] - startValue) * ((percent - startTime) / (timeline[endIndex] - startTime));
-
+	CC_SAFE_RELEASE_NULL(_source);
+	ParticleDefinition::load(reader);
 }
 
-ostream& ScaledNumericValue::save(ostream& output)
+bool EmitterDefinition::load(ParticleTextReader& reader)
 {
-	RangedNumericValue::save(output);
-	if (!active) return output;
-	output << "highMin: " << highMin << "\n";
-	output << "highMax: " << highMax << "\n";
-	output << "relative: " << (relative ? "true" : "false") << "\n";
-	output << "scalingCount: " << scaling.size() << "\n";
-	for (int i = 0; i != scaling.size(); i++)
-		output << "scaling" << i << ": " << scaling[i] << "\n";
-	output << "timelineCount: " << timeline.size() << "\n";
-	for (int i = 0; i != timeline.size(); i++)
-		output << "timeline" << i << ": " << timeline[i] << "\n";
-	return output;
+	CC_SAFE_RELEASE_NULL(_source);
+	return ParticleDefinition::load(reader);
 }
 
-void ScaledNumericValue::load(ScaledNumericValue& value)
+void EmitterDefinition::load(EmitterDefinition* definition)
 {
-	RangedNumericValue::load(value);
-	highMax = value.highMax;
-	highMin = value.highMin;
-	scaling.clear();
-	for (float v : value.scaling){
-		scaling.push_back(v);
-	}
-	timeline.clear();
-	for (float v : value.timeline){
-		timeline.push_back(v);
-	}
-	relative = value.relative;
+	CC_SAFE_RETAIN(definition->_source);
+	CC_SAFE_RELEASE(_source);
+	_source = definition->_source;
+	ParticleDefinition::load(*definition);
 }
 
-void ScaledNumericValue::load(istream& reader)
+ParticleBufferPool* NS_CUSTOM::ParticleBufferPool::_instance = nullptr;
+const int NS_CUSTOM::ParticleBufferPool::MAX_QUADS;
+
+NS_CUSTOM::ParticleBufferPool::~ParticleBufferPool()
 {
-	RangedNumericValue::load(reader);
-	if (!active) return;
-	highMin = readFloat(reader, "highMin");
-	highMax = readFloat(reader, "highMax");
-	relative = readBoolean(reader, "relative");
-	scaling.clear();
-	int scalingCount = readInt(reader, "scalingCount");
-	for (int i = 0; i < scalingCount; i++){
-		scaling.push_back(readFloat(reader, "scaling" + i));
-	}
-	timeline.clear();
-	int timelineCount = readInt(reader, "timelineCount");
-	for (int i = 0; i < timelineCount; i++){
-		timeline.push_back(readFloat(reader, "timeline" + i));
-	}
+	clearPool();
+	glDeleteBuffers(1, &_indexBuffer);
+	if (this == _instance) _instance = nullptr;
 }
 
-ostream& SpawnShapeValue::save(ostream& output)
+ParticleBufferPool* NS_CUSTOM::ParticleBufferPool::getInstance()
 {
-	ParticleValue::save(output);
-	if (!active) return output;
-	for (auto& pair : SpawnShapeMap){
-		if (pair.second == shape){
-			output << "shape: " << pair.first << "\n";
-			break;
-		}
-	}
-	if (shape == SpawnShape::ellipse) {
-		output << "edges: " << (edges ? "true" : "false") << "\n";
-		for (auto& pair : SpawnEllipseSideMap){
-			if (pair.second == side){
-				output << "side: " << pair.first << "\n";
-				break;
-			}
-		}
+	if (!_instance){
+		_instance = new ParticleBufferPool();
 	}
-	return output;
+	return _instance;
 }
 
-void SpawnShapeValue::load(SpawnShapeValue& value)
+GLuint NS_CUSTOM::ParticleBufferPool::getIndexBuffer(int quadCount)
 {
-	ParticleValue::load(value);
-	shape = value.shape;
-	edges = value.edges;
-	side = value.side;
-}
+	quadCount = std::min(quadCount, MAX_QUADS);
+	if (quadCount <= _indexCapacity) return _indexBuffer;
 
-void SpawnShapeValue::load(istream& reader)
-{
-	ParticleValue::load(reader);
-	if (!active) return;
-	shape = SpawnShapeMap[readString(reader, "shape")];
-	if (shape == SpawnShape::ellipse) {
-		edges = readBoolean(reader, "edges");
-		side = SpawnEllipseSideMap[readString(reader, "side")];
+	int capacity = std::max(_indexCapacity, 16);
+	while (capacity < quadCount) capacity *= 2;
+
+	std::vector<GLushort> indices(capacity * 6);
+	for (int i = 0; i < capacity; ++i)
+	{
+		const unsigned int i6 = i * 6;
+		const unsigned int i4 = i * 4;
+		indices[i6 + 0] = (GLushort)i4 + 0;
+		indices[i6 + 1] = (GLushort)i4 + 1;
+		indices[i6 + 2] = (GLushort)i4 + 2;
+
+		indices[i6 + 5] = (GLushort)i4 + 1;
+		indices[i6 + 4] = (GLushort)i4 + 2;
+		indices[i6 + 3] = (GLushort)i4 + 3;
 	}
-}
 
-ostream& ParticleValue::save(ostream& output)
-{
-	if (!alwaysActive)
-		output << "active: " << (active ? "true" : "false") << "\n";
-	else
-		active = true;
-	return output;
-}
+	// Keep the buffer name when growing, VAOs created earlier stay bound to it.
+	if (!_indexBuffer) glGenBuffers(1, &_indexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices[0]) * indices.size(), indices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	_indexCapacity = capacity;
 
-void NS_CUSTOM::ParticleValue::load(istream& reader)
-{
-	if (!alwaysActive)
-		active = readBoolean(reader, "active");
-	else
-		active = true;
+	CHECK_GL_ERROR_DEBUG();
+	return _indexBuffer;
 }
 
-void NS_CUSTOM::ParticleValue::load(ParticleValue& value)
+ParticleBufferPool::VertexBuffer NS_CUSTOM::ParticleBufferPool::borrowVertexBuffer(int quadCount)
 {
-	active = value.active;
-	alwaysActive = value.alwaysActive;
-}
+	int capacity = 16;
+	while (capacity < quadCount) capacity *= 2;
+	VertexBuffer buffer;
+	if (_headless){
+		memset(&buffer, 0, sizeof(buffer));
+		buffer.capacity = capacity;
+		return buffer;
+	}
+	getIndexBuffer(capacity);
 
-string NS_CUSTOM::readString(string line)
-{
-	return trim(line.substr(line.find(":") + 1));
+	auto& bucket = _freeBuffers[capacity];
+	if (!bucket.empty()){
+		buffer = bucket.back();
+		bucket.pop_back();
+		return buffer;
+	}
+	buffer.capacity = capacity;
+	createVertexBuffer(buffer);
+	return buffer;
 }
 
-string NS_CUSTOM::readString(istream& reader, string name)
+void NS_CUSTOM::ParticleBufferPool::returnVertexBuffer(VertexBuffer& buffer)
 {
-	string line;
-	getline(reader, line);
-	if (line.empty()) return line;
-	return readString(line);
+	if (!buffer.vbo) return;
+	_freeBuffers[buffer.capacity].push_back(buffer);
+	memset(&buffer, 0, sizeof(buffer));
 }
 
-bool NS_CUSTOM::readBoolean(string line)
+void NS_CUSTOM::ParticleBufferPool::clearPool()
 {
-	return Value(readString(line)).asBool();
+	bool shareableVAO = Configuration::getInstance()->supportsShareableVAO();
+	for (auto& pair : _freeBuffers){
+		for (auto& buffer : pair.second){
+			glDeleteBuffers(1, &buffer.vbo);
+			if (shareableVAO) glDeleteVertexArrays(1, &buffer.vao);
+		}
+	}
+	if (shareableVAO) GL::bindVAO(0);
+	_freeBuffers.clear();
 }
 
-bool NS_CUSTOM::readBoolean(istream& reader, string name)
+size_t NS_CUSTOM::ParticleBufferPool::getIndexBufferSize() const
 {
-	return Value(readString(reader, name)).asBool();
+	return sizeof(GLushort) * 6 * _indexCapacity;
 }
 
-int NS_CUSTOM::readInt(istream& reader, string name)
+size_t NS_CUSTOM::ParticleBufferPool::getPooledBufferSize() const
 {
-	return Value(readString(reader, name)).asInt();
+	size_t size = 0;
+	for (auto& pair : _freeBuffers)
+		size += sizeof(V3F_C4B_T2F_Quad) * pair.first * pair.second.size();
+	return size;
 }
 
-float NS_CUSTOM::readFloat(istream& reader, string name)
+void NS_CUSTOM::ParticleBufferPool::createVertexBuffer(VertexBuffer& buffer)
 {
-	return Value(readString(reader, name)).asFloat();
-}
+	buffer.vao = 0;
+	glGenBuffers(1, &buffer.vbo);
 
-float NS_CUSTOM::randomf(float a, float b)
-{
-	return a < b ? random(a, b) : random(b, a);
-}
+	if (!Configuration::getInstance()->supportsShareableVAO()){
+		glBindBuffer(GL_ARRAY_BUFFER, buffer.vbo);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(V3F_C4B_T2F_Quad) * buffer.capacity, nullptr, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		CHECK_GL_ERROR_DEBUG();
+		return;
+	}
 
-ParticlePool* NS_CUSTOM::ParticlePool::_instance = nullptr;
+	glGenVertexArrays(1, &buffer.vao);
+	GL::bindVAO(buffer.vao);
 
-NS_CUSTOM::ParticlePool::~ParticlePool()
-{
-	clearPool();
-	if (this == _instance) _instance = nullptr;
-}
+#define kQuadSize sizeof(V3F_C4B_T2F)
 
-void NS_CUSTOM::ParticlePool::freeToPool(Particle* particle)
-{
-	if (!particle) return;
-	if (_size < _capacity){
-		*(_pool + _size) = particle;
-		_size++;
-	}
-	else{
-		delete particle;
-	}
-}
+	glBindBuffer(GL_ARRAY_BUFFER, buffer.vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(V3F_C4B_T2F_Quad) * buffer.capacity, nullptr, GL_DYNAMIC_DRAW);
 
-Particle* NS_CUSTOM::ParticlePool::getFromPool()
-{
-	if (_size > 0){
-		_size--;
-		auto pos = _pool + _size;
-		auto particle = *pos;
-		*pos = nullptr;
-		return particle;
-		_size--;
-	}
-	else{
-		return new Particle();
-	}
-}
+	// vertices
+	glEnableVertexAttribArray(GLProgram::VERTEX_ATTRIB_POSITION);
+	glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_POSITION, 2, GL_FLOAT, GL_FALSE, kQuadSize, (GLvoid*)offsetof(V3F_C4B_T2F, vertices));
 
-void NS_CUSTOM::ParticlePool::init(int capacity)
-{
-	clearPool();
-	if (capacity <= 0){
-		_capacity = _size = 0;
-		return;
-	}
-	_pool = new Particle*[capacity];
-	_capacity = capacity;
-	_size = 0;
-}
+	// colors
+	glEnableVertexAttribArray(GLProgram::VERTEX_ATTRIB_COLOR);
+	glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, kQuadSize, (GLvoid*)offsetof(V3F_C4B_T2F, colors));
 
-ParticlePool* NS_CUSTOM::ParticlePool::getInstance()
-{
-	if (!_instance){
-		_instance = new ParticlePool();
-	}
-	return _instance;
-}
+	// tex coords
+	glEnableVertexAttribArray(GLProgram::VERTEX_ATTRIB_TEX_COORD);
+	glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_TEX_COORD, 2, GL_FLOAT, GL_FALSE, kQuadSize, (GLvoid*)offsetof(V3F_C4B_T2F, texCoords));
 
-void NS_CUSTOM::ParticlePool::clearPool()
-{
-	if (_pool){
-		auto particle = *_pool;
-		for (int i = 0; i < _size; ++i, ++particle){
-			delete particle;
-		}
-		delete[]_pool;
-		_pool = nullptr;
-	}
-}
+#undef kQuadSize
 
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indexBuffer);
 
+	// Must unbind the VAO before changing the element buffer.
+	GL::bindVAO(0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	CHECK_GL_ERROR_DEBUG();
+}
\ No newline at end of file
@@ -4,6 +4,8 @@
 #include <string>
 #include <iostream>
 #include "cocos2d.h"
+#include "ParticleSimulation.h"
+#include "ParticleStatsRegistry.h"
 #include "core/util/GameDefine.h"
 
 USING_NS_CC;
@@ -13,281 +15,6 @@ using std::ostream;
 
 NS_CUSTOM_BEGIN
 
-class Particle;
-
-class ParticleValue {
-public:
-	friend class ParticleEmitter;
-
-	ParticleValue() : active(false), alwaysActive(false){}
-
-	virtual void setAlwaysActive(bool alwaysActive) {
-		this->alwaysActive = alwaysActive;
-	}
-
-	virtual bool isAlwaysActive() {
-		return alwaysActive;
-	}
-
-	virtual bool isActive() {
-		return alwaysActive || active;
-	}
-
-	virtual void setActive(bool active) {
-		this->active = active;
-	}
-
-	virtual ostream& save(ostream& output);
-
-	virtual void load(istream& reader);
-
-	virtual void load(ParticleValue& value);
-protected:
-	bool active;
-	bool alwaysActive;
-};
-
-class NumericValue :public ParticleValue {
-public:
-	friend class ParticleEmitter;
-
-	NumericValue() :value(0){}
-
-	virtual float getValue() {
-		return value;
-	}
-
-	virtual void setValue(float value) {
-		this->value = value;
-	}
-
-	virtual ostream& save(ostream& output);
-
-	virtual void load(istream& reader);
-
-	virtual void load(NumericValue& value);
-private:
-	float value;
-};
-
-class RangedNumericValue :public ParticleValue {
-public:
-	friend class ParticleEmitter;
-
-	RangedNumericValue() :lowMin(0), lowMax(0){}
-
-	virtual float newLowValue() {
-		return lowMin <= lowMax ? random(lowMin, lowMax) : random(lowMax, lowMin);
-	}
-
-	virtual void setLow(float value) {
-		lowMin = value;
-		lowMax = value;
-	}
-
-	virtual void setLow(float min, float max) {
-		lowMin = min;
-		lowMax = max;
-	}
-
-	virtual float getLowMin() {
-		return lowMin;
-	}
-
-	virtual void setLowMin(float lowMin) {
-		this->lowMin = lowMin;
-	}
-
-	virtual float getLowMax() {
-		return lowMax;
-	}
-
-	virtual void setLowMax(float lowMax) {
-		this->lowMax = lowMax;
-	}
-
-	virtual ostream& save(ostream& output);
-
-	virtual void load(istream& reader);
-
-	virtual void load(RangedNumericValue& value);
-private:
-	float lowMin, lowMax;
-};
-
-class ScaledNumericValue :public RangedNumericValue {
-public:
-	friend class ParticleEmitter;
-
-	ScaledNumericValue() :highMin(0), highMax(0), relative(false){}
-
-	virtual float newHighValue() {
-		return highMin <= highMax ? random(highMin, highMax) : random(highMax, highMin);
-	}
-
-	virtual void setHigh(float value) {
-		highMin = value;
-		highMax = value;
-	}
-
-	virtual void setHigh(float min, float max) {
-		highMin = min;
-		highMax = max;
-	}
-
-	virtual float getHighMin() {
-		return highMin;
-	}
-
-	virtual void setHighMin(float highMin) {
-		this->highMin = highMin;
-	}
-
-	virtual float getHighMax() {
-		return highMax;
-	}
-
-	virtual void setHighMax(float highMax) {
-		this->highMax = highMax;
-	}
-
-	virtual float_array getScaling() {
-		return scaling;
-	}
-
-	virtual void setScaling(float_array values) {
-		this->scaling = values;
-	}
-
-	virtual float_array getTimeline() {
-		return timeline;
-	}
-
-	virtual void setTimeline(float_array timeline) {
-		this->timeline = timeline;
-	}
-
-	virtual bool isRelative() {
-		return relative;
-	}
-
-	virtual void setRelative(bool relative) {
-		this->relative = relative;
-	}
-
-	virtual float getScale(float percent);
-
-	virtual ostream& save(ostream& output);
-
-	virtual void load(istream& reader);
-
-	virtual void load(ScaledNumericValue& value);
-private:
-	float_array scaling = float_array{ 1.0f };
-	float_array timeline = float_array{ 0.0f };
-	float highMin, highMax;
-	bool relative;
-};
-
-class GradientColorValue :public ParticleValue {
-public:
-	friend class ParticleEmitter;
-	GradientColorValue(){
-		alwaysActive = true;
-	}
-
-	float_array getTimeline() {
-		return timeline;
-	}
-
-	virtual void setTimeline(float_array timeline) {
-		this->timeline = timeline;
-	}
-
-	/** @return the r, g and b values for every timeline position */
-	virtual float_array& getColors() {
-		return colors;
-	}
-
-	/** @param colors the r, g and b values for every timeline position */
-	virtual void setColors(float_array colors) {
-		this->colors = colors;
-	}
-
-	virtual float_array& getColor(float percent);
-
-	virtual ostream& save(ostream& output);
-
-	virtual void load(istream& reader);
-
-	virtual void load(GradientColorValue& value);
-private:
-	static float_array temp;
-
-	float_array colors = float_array{ 1.0f, 1.0f, 1.0f };
-	float_array timeline = float_array{ 0.0f };
-};
-
-enum SpawnShape {
-	point, line, square, ellipse
-};
-
-static std::map<string, SpawnShape> SpawnShapeMap{
-	{ "point", point }, { "line", line }, { "square", square }, { "ellipse", ellipse }
-};
-
-enum SpawnEllipseSide {
-	both, top, bottom
-};
-
-static std::map<string, SpawnEllipseSide> SpawnEllipseSideMap{
-	{ "both", both }, { "top", top }, { "bottom", bottom }
-};
-
-class SpawnShapeValue : public ParticleValue {
-public:
-	friend class ParticleEmitter;
-
-	SpawnShapeValue() :edges(false){}
-
-	SpawnShape getShape() {
-		return shape;
-	}
-
-	void setShape(SpawnShape shape) {
-		this->shape = shape;
-	}
-
-	bool isEdges() {
-		return edges;
-	}
-
-	void setEdges(bool edges) {
-		this->edges = edges;
-	}
-
-
-	virtual SpawnEllipseSide getSide() {
-		return side;
-	}
-
-	virtual void setSide(SpawnEllipseSide side) {
-		this->side = side;
-	}
-
-	virtual ostream& save(ostream& output);
-
-	virtual void load(istream& reader);
-
-	virtual void load(SpawnShapeValue& value);
-
-
-protected:
-	SpawnShape shape = SpawnShape::point;
-	bool edges;
-	SpawnEllipseSide side = SpawnEllipseSide::both;
-};
-
 class BoundingBox{
 public:
 	Vec3 min;
@@ -346,280 +73,250 @@ private:
 
 };
 
-class Particle {
-public:
-	friend class ParticleEmitter;
-	Particle() :
-		//_flipX(false), _flipY(false),
-		_scale(0),
-		_rotation(0),
-		_opacity(255),
-		life(0), currentLife(0),
-		scale(0), scaleDiff(0),
-		rotation(0), rotationDiff(0),
-		velocity(0), velocityDiff(0),
-		angle(0), angleDiff(0),
-		angleCos(0), angleSin(0),
-		transparency(0), transparencyDiff(0),
-		wind(0), windDiff(0),
-		gravity(0), gravityDiff(0)
-	{}
-
-	virtual void setPosition(float x, float y);
-	virtual void translate(float dx, float dy);
-protected:
-	Vec2 _position;
-	float _scale;
-	float _rotation;
-	Color3B _color;
-	GLubyte _opacity;
-
-	int life, currentLife;
-	float scale, scaleDiff;
-	float rotation, rotationDiff;
-	float velocity, velocityDiff;
-	float angle, angleDiff;
-	float angleCos, angleSin;
-	float transparency, transparencyDiff;
-	float wind, windDiff;
-	float gravity, gravityDiff;
-	float_array tint = float_array{ 0, 0, 0 };
-};
-
-class ParticlePool{
+/** GL buffers shared by all emitters: one grow-only quad index buffer, and vertex buffers (each with its
+* VAO when supported) bucketed by power-of-two quad capacity that emitters borrow, draw from and return. */
+class ParticleBufferPool{
 public:
-	ParticlePool() : _pool(nullptr), _size(0), _capacity(0){}
-	~ParticlePool();
-	static ParticlePool* getInstance();
-	void init(int capacity);
-	Particle* getFromPool();
-	void freeToPool(Particle* particle);
+	/** Quads one draw can index with 16-bit indices. */
+	static const int MAX_QUADS = 65536 / 4;
+
+	struct VertexBuffer {
+		GLuint vbo;
+		GLuint vao;
+		int capacity;
+	};
+
+	ParticleBufferPool() : _indexBuffer(0), _indexCapacity(0), _headless(false){}
+	~ParticleBufferPool();
+	static ParticleBufferPool* getInstance();
+	/** Returns the shared index buffer, grown to cover at least quadCount quads. */
+	GLuint getIndexBuffer(int quadCount);
+	VertexBuffer borrowVertexBuffer(int quadCount);
+	void returnVertexBuffer(VertexBuffer& buffer);
+	/** Deletes the vertex buffers currently parked in the pool. */
 	void clearPool();
+
+	/** Returns the bytes of the shared index buffer. */
+	size_t getIndexBufferSize() const;
+
+	/** Returns the bytes of the vertex buffers parked in the pool. */
+	size_t getPooledBufferSize() const;
+
+	/** Headless, borrowed buffers have no GL objects and emitters skip uploading, so they can run without a
+	* GL context. Only emitters created while headless are affected. */
+	void setHeadless(bool headless) {
+		_headless = headless;
+	}
+
+	bool isHeadless() const {
+		return _headless;
+	}
 private:
-	static ParticlePool* _instance;
-	Particle** _pool;
-	int _size;
-	int _capacity;
+	static ParticleBufferPool* _instance;
+	GLuint _indexBuffer;
+	int _indexCapacity;
+	bool _headless;
+	std::map<int, std::vector<VertexBuffer>> _freeBuffers;
+
+	void createVertexBuffer(VertexBuffer& buffer);
 };
 
-class ParticleEmitter : public Node{
+/** Immutable, reference-counted emitter data as loaded from an effect file. Every emitter created from
+* the same cached effect shares one definition; ParticleEmitter clones it before the first write. */
+class EmitterDefinition : public Ref, public ParticleDefinition {
 public:
-	static const int UPDATE_SCALE = 1 << 0;
-	static const int UPDATE_ANGLE = 1 << 1;
-	static const int UPDATE_ROTATION = 1 << 2;
-	static const int UPDATE_VELOCITY = 1 << 3;
-	static const int UPDATE_WIND = 1 << 4;
-	static const int UPDATE_GRAVITY = 1 << 5;
-	static const int UPDATE_TINT = 1 << 6;
+	friend class ParticleEffectBinary;
+
+	EmitterDefinition();
+
+	virtual ~EmitterDefinition();
+
+	/** Returns a deep copy with a reference count of one, owned by the caller. */
+	EmitterDefinition* clone();
+
+	/** Returns the shared definition with default values that unloaded emitters start from. */
+	static EmitterDefinition* getDefault();
+
+	virtual ParticleMemoryUsage getMemoryUsage() const;
+
+	virtual void load(istream& reader);
+
+	virtual bool load(ParticleTextReader& reader);
+
+	virtual void load(EmitterDefinition* definition);
+private:
+	static EmitterDefinition* _default;
 
-	static Color3B tempColor;
+	/** The mapped binary effect file the curves point into, if any. Retained. */
+	Ref* _source;
+};
+
+class ParticleBakedLoop;
 
-	float duration = 1, durationTimer = 0;
+/** Draws a ParticleSimulation as a scene graph node: sprite, quads uploaded to and drawn from the borrowed
+* vertex buffer, and copy-on-write access to the shared EmitterDefinition. */
+class ParticleEmitter : public Node, public ParticleSimulation {
+public:
+	friend class ParticleBenchmark;
+	friend class ParticleBakedLoop;
 
 	ParticleEmitter() :
-		accumulator(0),
 		sprite(nullptr),
-		_spriteWidth(0), _spriteHeight(0),
-		particles(nullptr),
-		minParticleCount(0), maxParticleCount(0),
-		dx(0), dy(0),
-		activeCount(0),
-		active(nullptr),
-		firstUpdate(false),
 		_flipX(false), _flipY(false),
-		updateFlags(0),
-		_allowCompletion(false),
-		emission(0), emissionDiff(0), emissionDelta(0),
-		lifeOffset(0), lifeOffsetDiff(0),
-		life(0), lifeDiff(0),
-		spawnWidth(0), spawnWidthDiff(0),
-		spawnHeight(0), spawnHeightDiff(0),
-		delay(0), delayTimer(0),
-		attached(false),
-		continuous(false),
-		aligned(false),
-		behind(false),
+		_spawnPinned(false), _spawnX(0), _spawnY(0),
 		_allocatedParticles(0),
 		_blendFunc(BlendFunc::ALPHA_NON_PREMULTIPLIED),
-		_quads(nullptr),
-		_indices(nullptr),
-		_VAOname(0)
+		_quads(nullptr), _quadsDirty(false),
+		_bakedLoop(nullptr), _bakedTime(0), _bakedFrame(-1), _bakedCount(0)
 	{
-		memset(_buffersVBO, 0, sizeof(_buffersVBO));
-		initialize();
-	}
-
-	virtual ~ParticleEmitter(){
-		CC_SAFE_RELEASE_NULL(sprite);
-		CC_SAFE_FREE(_quads);
-		CC_SAFE_FREE(_indices);
-		glDeleteBuffers(2, &_buffersVBO[0]);
-		if (Configuration::getInstance()->supportsShareableVAO())
-		{
-			glDeleteVertexArrays(1, &_VAOname);
-			GL::bindVAO(0);
-		}
+		memset(&_vertexBuffer, 0, sizeof(_vertexBuffer));
+		_definition = EmitterDefinition::getDefault();
+		definition()->retain();
 	}
 
+	virtual ~ParticleEmitter();
+
 	ParticleEmitter(ParticleEmitter* emitter);
 
 	void init(ParticleEmitter* emitter);
 
-	void draw(Renderer *renderer, const Mat4 &transform, uint32_t flags);
+	/** Sets up a fresh emitter from a loaded definition. */
+	void init(EmitterDefinition* definition);
 
-	void setMaxParticleCount(int maxParticleCount);
+	/** Shares the given definition and resets this emitter's counts and options to it. */
+	void setDefinition(EmitterDefinition* definition);
 
-	void addParticle();
+	const EmitterDefinition* getDefinition() const {
+		return definition();
+	}
 
-	void addParticles(int count);
+	void draw(Renderer *renderer, const Mat4 &transform, uint32_t flags);
 
-	void update(float delta);
+	/** Also grows the quads and the vertex buffer. */
+	void setMaxParticleCount(int maxParticleCount);
 
-	void start();
+	void update(float delta);
 
-	void reset();
+	/** Advances the particles like update() without building quads or uploading them, e.g. to fast-forward. */
+	void simulate(float delta);
 
-	void restart();
+	void setPosition(float x, float y) {
+		// A pinned spawn point stays put, like the particles of an unattached emitter.
+		if (_spawnPinned && !attached) {
+			_spawnX += dx - x;
+			_spawnY += dy - y;
+		}
+		ParticleSimulation::setPosition(x, y);
+	}
 
-	void setPosition(float x, float y);
+	void translate(float x, float y) {
+		if (_spawnPinned && !attached) {
+			_spawnX -= x;
+			_spawnY -= y;
+		}
+		ParticleSimulation::translate(x, y);
+	}
 
-	void translate(float x, float y);
+	/** Spawns at x, y in the node's space from now on instead of at the node's position, e.g. where the parent
+	* particle of a sub-emitter was. Later moves of an unattached emitter leave the point where it is. */
+	void setSpawnPoint(float x, float y) {
+		_spawnPinned = true;
+		_spawnX = x;
+		_spawnY = y;
+	}
 
 	void setFlip(bool flipX, bool flipY);
 
 	void setSprite(Sprite* sprite);
 
-	/** Ignores the {@link #setContinuous(boolean) continuous} setting until the emitter is started again. This allows the emitter
-	* to stop smoothly. */
-	void allowCompletion() {
-		this->_allowCompletion = true;
-		durationTimer = duration;
-	}
-
 	CREATE_FUNC(ParticleEmitter);
 
 	virtual bool init(){ return true; }
 
-	Particle* newParticle(Sprite* sprite);
-
-	void activateParticle(int index);
-
-	bool updateParticle(Particle* particle, float delta, int deltaMillis);
-
 	Sprite* getSprite() {
 		return sprite;
 	}
 
 	string getName() {
-		return name;
+		return _definition->name;
 	}
 
 	void setName(string name) {
-		this->name = name;
+		mutableDefinition()->name = name;
 	}
 
+	/** The value getters below detach this emitter from a shared definition before returning it
+	* (copy-on-write). Use getDefinition() for read-only access. */
 	ScaledNumericValue& getLife() {
-		return lifeValue;
+		return mutableDefinition()->lifeValue;
 	}
 
 	ScaledNumericValue& getScale() {
-		return scaleValue;
+		return mutableDefinition()->scaleValue;
 	}
 
 	ScaledNumericValue& getRotation() {
-		return rotationValue;
+		return mutableDefinition()->rotationValue;
 	}
 
 	GradientColorValue& getTint() {
-		return tintValue;
+		return mutableDefinition()->tintValue;
 	}
 
 	ScaledNumericValue& getVelocity() {
-		return velocityValue;
+		return mutableDefinition()->velocityValue;
 	}
 
 	ScaledNumericValue& getWind() {
-		return windValue;
+		return mutableDefinition()->windValue;
 	}
 
 	ScaledNumericValue& getGravity() {
-		return gravityValue;
+		return mutableDefinition()->gravityValue;
 	}
 
 	ScaledNumericValue& getAngle() {
-		return angleValue;
+		return mutableDefinition()->angleValue;
 	}
 
 	ScaledNumericValue& getEmission() {
-		return emissionValue;
+		return mutableDefinition()->emissionValue;
 	}
 
 	ScaledNumericValue& getTransparency() {
-		return transparencyValue;
+		return mutableDefinition()->transparencyValue;
 	}
 
 	RangedNumericValue& getDuration() {
-		return durationValue;
+		return mutableDefinition()->durationValue;
 	}
 
 	RangedNumericValue& getDelay() {
-		return delayValue;
+		return mutableDefinition()->delayValue;
 	}
 
 	ScaledNumericValue& getLifeOffset() {
-		return lifeOffsetValue;
+		return mutableDefinition()->lifeOffsetValue;
 	}
 
 	RangedNumericValue& getXOffsetValue() {
-		return xOffsetValue;
+		return mutableDefinition()->xOffsetValue;
 	}
 
 	RangedNumericValue& getYOffsetValue() {
-		return yOffsetValue;
+		return mutableDefinition()->yOffsetValue;
 	}
 
 	ScaledNumericValue& getSpawnWidth() {
-		return spawnWidthValue;
+		return mutableDefinition()->spawnWidthValue;
 	}
 
 	ScaledNumericValue& getSpawnHeight() {
-		return spawnHeightValue;
+		return mutableDefinition()->spawnHeightValue;
 	}
 
 	SpawnShapeValue& getSpawnShape() {
-		return spawnShapeValue;
-	}
-
-	bool isAttached() {
-		return attached;
-	}
-
-	void setAttached(bool attached) {
-		this->attached = attached;
-	}
-
-	bool isContinuous() {
-		return continuous;
-	}
-
-	void setContinuous(bool continuous) {
-		this->continuous = continuous;
-	}
-
-	bool isAligned() {
-		return aligned;
-	}
-
-	void setAligned(bool aligned) {
-		this->aligned = aligned;
-	}
-
-	bool isAdditive() {
-		return additive;
-	}
-
-	void setAdditive(bool additive) {
-		this->additive = additive;
+		return mutableDefinition()->spawnShapeValue;
 	}
 
 	/** @return Whether this ParticleEmitter automatically returns the {@link com.badlogic.gdx.graphics.g2d.Batch Batch}'s blend
@@ -640,60 +337,55 @@ public:
 		this->_cleansUpBlendFunction = cleansUpBlendFunction;
 	}
 
-	bool isBehind() {
-		return behind;
-	}
+	/** Redraws the particles moved along their last motion by elapsed seconds since the last update, without
+	* simulating. Lets an emitter be simulated at a lower rate and still move smoothly. */
+	void extrapolate(float elapsed);
 
-	void setBehind(bool behind) {
-		this->behind = behind;
-	}
+	/** Plays loop back from phase seconds into it instead of simulating, or simulates again when loop is null.
+	* While it plays, update() and simulate() only advance it and bursts are not drawn. Either way the particles
+	* simulated so far are dropped. Retained. */
+	void setBakedLoop(ParticleBakedLoop* loop, float phase = 0);
 
-	bool isPremultipliedAlpha() {
-		return premultipliedAlpha;
+	ParticleBakedLoop* getBakedLoop() const {
+		return _bakedLoop;
 	}
 
-	void setPremultipliedAlpha(bool premultipliedAlpha) {
-		this->premultipliedAlpha = premultipliedAlpha;
-	}
+	/** Moves playback to phase seconds into the loop. */
+	void setBakedPhase(float phase);
 
-	int getMinParticleCount() {
-		return minParticleCount;
-	}
-
-	void setMinParticleCount(int minParticleCount) {
-		this->minParticleCount = minParticleCount;
-	}
+	/** See ParticleSimulation::burst(). */
+	void burst(float x, float y, int count, const BurstParams& params = BurstParams());
 
-	int getMaxParticleCount() {
-		return maxParticleCount;
+	/** Returns the bytes held by this emitter's particles, quads and vertex buffer. The shared definition
+	* and the texture are not included. */
+	size_t getMemorySize() const {
+		return getMemoryUsage().total();
 	}
 
-	bool isComplete();
-
-	float getPercentComplete();
-
-	int getActiveCount() {
-		return activeCount;
-	}
+	virtual ParticleMemoryUsage getMemoryUsage() const;
 
 	string getImagePath() {
-		return imagePath;
+		return _definition->imagePath;
 	}
 
 	void setImagePath(string imagePath) {
-		this->imagePath = imagePath;
+		mutableDefinition()->imagePath = imagePath;
 	}
 
 	void flipY();
 
 	/** Returns the bounding box for all active particles. z axis will always be zero. */
 	BoundingBox& getBoundingBox() {
+		if (_bakedLoop) return getBakedBounds();
 		bounds.inf();
 		for (int i = 0; i < maxParticleCount; i++)
 			if (active[i]) {
-				// 				const auto& r = particles.at(i)->getBoundingBox();
-				// 				bounds.ext(r.getMinX(), r.getMinY(), 0);
-				// 				bounds.ext(r.getMaxX(), r.getMaxY(), 0);
+				// Quads are centered half a sprite from the particle, see updatePosWithParticle.
+				const Particle& particle = particles[i];
+				float x = particle.x + _spriteWidth / 2 + _originX, y = particle.y + _spriteHeight / 2 + _originY;
+				float halfWidth = _spriteWidth * particle.scale / 2, halfHeight = _spriteHeight * particle.scale / 2;
+				bounds.ext(x - halfWidth, y - halfHeight, 0);
+				bounds.ext(x + halfWidth, y + halfHeight, 0);
 			}
 
 		return bounds;
@@ -703,70 +395,40 @@ public:
 
 	virtual void load(istream& reader);
 
+protected:
+	/** Particles spawn at the node's position, or at the spawn point when one is set. */
+	virtual void getSpawnPosition(float& x, float& y) {
+		if (_spawnPinned) {
+			x = _spawnX;
+			y = _spawnY;
+			return;
+		}
+		x = getPositionX();
+		y = getPositionY();
+	}
+
 private:
-	RangedNumericValue delayValue;
-	ScaledNumericValue lifeOffsetValue;
-	RangedNumericValue durationValue;
-	ScaledNumericValue lifeValue;
-	ScaledNumericValue emissionValue;
-	ScaledNumericValue scaleValue;
-	ScaledNumericValue rotationValue;
-	ScaledNumericValue velocityValue;
-	ScaledNumericValue angleValue;
-	ScaledNumericValue windValue;
-	ScaledNumericValue gravityValue;
-	ScaledNumericValue transparencyValue;
-	GradientColorValue tintValue;
-	ScaledNumericValue xOffsetValue;
-	ScaledNumericValue yOffsetValue;
-	ScaledNumericValue spawnWidthValue;
-	ScaledNumericValue spawnHeightValue;
-	SpawnShapeValue spawnShapeValue;
-
-	float accumulator;
 	Sprite* sprite;
-	float _spriteWidth, _spriteHeight;
-	Particle** particles;
-	int minParticleCount, maxParticleCount;
-	float dx, dy;
-	string name;
-	string imagePath;
-	int activeCount;
-	bool* active;
-	bool firstUpdate;
 	bool _flipX, _flipY;
-	int updateFlags;
-	bool _allowCompletion;
+	bool _spawnPinned;
+	float _spawnX, _spawnY;
 	BoundingBox bounds;
 
-	int emission, emissionDiff, emissionDelta;
-	int lifeOffset, lifeOffsetDiff;
-	int life, lifeDiff;
-	float spawnWidth, spawnWidthDiff;
-	float spawnHeight, spawnHeightDiff;
-
-	float delay, delayTimer;
-
-	bool attached;
-	bool continuous;
-	bool aligned;
-	bool behind;
-	bool additive = true;
-	bool premultipliedAlpha = false;
 	bool _cleansUpBlendFunction = true;
 
 	int _allocatedParticles;
 	BlendFunc _blendFunc;
 
 	V3F_C4B_T2F_Quad    *_quads;        // quads to be rendered
-	GLushort            *_indices;      // indices
-	GLuint              _VAOname;
-	GLuint              _buffersVBO[2]; //0: vertex  1: indices
+	bool _quadsDirty;                   // _quads changed since the last upload
+	ParticleBufferPool::VertexBuffer _vertexBuffer; // borrowed, indexed by the shared index buffer
 
-	QuadCommand _quadCommand;           // quad command
+	CustomCommand _customCommand;       // draws _vertexBuffer
 
-	/** initializes the indices for the vertices*/
-	void initIndices();
+	ParticleBakedLoop* _bakedLoop;
+	float _bakedTime;                   // seconds into the baked loop
+	int _bakedFrame;                    // the frame in _quads, -1 for none
+	int _bakedCount;                    // quads of that frame
 
 	/** initializes the texture with a rectangle measured Points */
 	void initTexCoordsWithRect(const Rect& rect);
@@ -774,39 +436,45 @@ private:
 	/** Updates texture coords */
 	void updateTexCoords();
 
-	void updateParticleQuads();
-
-	void setupVBOandVAO();
+	void beginStatsFrame() {
+		_stats.beginFrame(ParticleStatsRegistry::getFrame());
+	}
 
-	void setupVBO();
+	/** elapsed > 0 moves each quad along its particle's last motion by that many seconds, see extrapolate(). */
+	void updateParticleQuads(float elapsed = 0);
 
+	/** Uploads the quads to the borrowed vertex buffer. Called when drawing, so emitters that are not drawn
+	* upload nothing and a frame is uploaded once however many steps built it. */
 	void postStep();
 
-	void updateBlendFunc();
-
-	void initGLProgramState();
-
-	void initialize();
-
-	inline void updatePosWithParticle(V3F_C4B_T2F_Quad *quad, Particle* particle, float spriteW, float spriteH);
-
-};
+	void onDraw(const Mat4& transform, uint32_t flags);
 
+	/** Returns the quads to upload and draw: the baked frame's while playing a loop, else one per particle. */
+	int getQuadCount() const {
+		return _bakedLoop ? _bakedCount : activeCount;
+	}
 
+	/** Advances the baked loop by delta seconds, decoding a frame whenever it changes. */
+	void playBakedLoop(float delta);
 
-static string readString(string line);
+	BoundingBox& getBakedBounds();
 
-static string readString(istream& reader, string name);
+	void updateBlendFunc();
 
-static bool readBoolean(string line);
+	void initGLProgramState();
 
-static bool readBoolean(istream& reader, string name);
+	/** The shared definition; ParticleEmitter only ever runs from an EmitterDefinition. */
+	EmitterDefinition* definition() const {
+		return static_cast<EmitterDefinition*>(_definition);
+	}
 
-static int readInt(istream& reader, string name);
+	/** Returns the definition for writing, cloning it first if other emitters share it. */
+	EmitterDefinition* mutableDefinition();
 
-static float readFloat(istream& reader, string name);
+	inline void updatePosWithParticle(V3F_C4B_T2F_Quad *quad, Particle* particle, float spriteW, float spriteH);
 
-static float randomf(float a, float b);
+};
 
 NS_CUSTOM_END
-#endif
\ No newline at end of file
+
+#endif
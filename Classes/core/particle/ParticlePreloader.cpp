@@ -0,0 +1,213 @@
+#include "ParticlePreloader.h"
+#include "ParticleEffect.h"
+#include "core/util/GameUtil.h"
+#include <algorithm>
+#include <chrono>
+
+USING_NS_CUSTOM;
+
+typedef std::chrono::duration<float, std::milli> Milliseconds;
+
+ParticlePreloader* NS_CUSTOM::ParticlePreloader::_instance = nullptr;
+
+NS_CUSTOM::ParticlePreloader::~ParticlePreloader()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_running = false;
+	}
+	_condition.notify_one();
+	if (_thread.joinable()) _thread.join();
+	if (_scheduled) Director::getInstance()->getScheduler()->unschedule("ParticlePreloader", this);
+	for (auto job : _loading){
+		for (auto definition : job->definitions) definition->release();
+		for (auto image : job->images) CC_SAFE_RELEASE(image);
+		delete job;
+	}
+	if (this == _instance) _instance = nullptr;
+}
+
+ParticlePreloader* NS_CUSTOM::ParticlePreloader::getInstance()
+{
+	if (!_instance){
+		_instance = new ParticlePreloader();
+	}
+	return _instance;
+}
+
+void NS_CUSTOM::ParticlePreloader::preload(const std::vector<string>& names, const completeCallback& callback)
+{
+	auto cache = ParticleEffectCache::getInstance();
+	auto batch = new Batch();
+	batch->remaining = 0;
+	batch->callback = callback;
+	std::unordered_set<string> requested;
+	for (auto& name : names){
+		if (cache->peek(name) || !requested.insert(name).second) continue;
+		batch->remaining++;
+		Job* job = nullptr;
+		for (auto loading : _loading){
+			if (loading->name == name){
+				job = loading;
+				break;
+			}
+		}
+		if (job){
+			job->batches.push_back(batch);
+			continue;
+		}
+		job = new Job();
+		job->name = name;
+		// FileUtils caches resolved paths, so paths are resolved here rather than on the worker.
+		job->fullPath = FileUtils::getInstance()->fullPathForFilename(name);
+		job->imageDirectory = getPathForFilename(name);
+		job->stage = Stage::PARSE;
+		job->loadTime = job->parseTime = job->decodeTime = 0;
+		job->batches.push_back(batch);
+		_loading.push_back(job);
+		submit(job);
+	}
+	if (batch->remaining == 0){
+		delete batch;
+		if (callback) callback();
+		return;
+	}
+	if (!_scheduled){
+		_scheduled = true;
+		Director::getInstance()->getScheduler()->schedule(std::bind(&ParticlePreloader::step, this, std::placeholders::_1),
+			this, 0, false, "ParticlePreloader");
+	}
+}
+
+void NS_CUSTOM::ParticlePreloader::submit(Job* job)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (!_running){
+			_running = true;
+			// The worker names its trace track; the trace is created here so it is not created on two threads.
+			ParticleTrace::getInstance();
+			_thread = std::thread(&ParticlePreloader::work, this);
+		}
+		_workQueue.push_back(job);
+	}
+	_condition.notify_one();
+}
+
+void NS_CUSTOM::ParticlePreloader::work()
+{
+	ParticleTrace::getInstance()->setThreadName("ParticlePreloader");
+	while (true){
+		Job* job;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_condition.wait(lock, [this]{ return !_running || !_workQueue.empty(); });
+			if (!_running) return;
+			job = _workQueue.front();
+			_workQueue.pop_front();
+		}
+
+		auto startTime = std::chrono::steady_clock::now();
+		if (job->stage == Stage::PARSE){
+			PARTICLE_TRACE("ParticlePreloader::parse");
+			auto effectFile = EffectFile::open(job->fullPath);
+			if (effectFile){
+				ParticleEffect::readDefinitions(effectFile, job->definitions);
+				effectFile->release();
+			}
+		}
+		else{
+			PARTICLE_TRACE("ParticlePreloader::decode");
+			for (auto& path : job->imagePaths){
+				Image* image = nullptr;
+				if (!path.empty()){
+					Data data = FileUtils::getInstance()->getDataFromFile(path);
+					image = new Image();
+					if (data.isNull() || !image->initWithImageData(data.getBytes(), data.getSize()))
+						CC_SAFE_RELEASE_NULL(image);
+				}
+				job->images.push_back(image);
+			}
+			job->stage = Stage::FINISH;
+		}
+		float workTime = Milliseconds(std::chrono::steady_clock::now() - startTime).count();
+		if (job->stage == Stage::PARSE) job->parseTime += workTime;
+		else job->decodeTime += workTime;
+		job->loadTime += workTime;
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		_doneQueue.push_back(job);
+	}
+}
+
+void NS_CUSTOM::ParticlePreloader::step(float delta)
+{
+	PARTICLE_TRACE("ParticlePreloader::step");
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		while (!_doneQueue.empty()){
+			auto job = _doneQueue.front();
+			_doneQueue.pop_front();
+			if (job->stage == Stage::PARSE){
+				// Images are decoded in a second pass, once their paths are resolved here.
+				for (auto definition : job->definitions){
+					auto& imagePath = definition->getImagePath();
+					job->imagePaths.push_back(imagePath.empty() ? imagePath :
+						FileUtils::getInstance()->fullPathForFilename(job->imageDirectory + imagePath));
+				}
+				job->stage = Stage::DECODE;
+				_workQueue.push_back(job);
+			}
+			else{
+				_finishQueue.push_back(job);
+			}
+		}
+	}
+	_condition.notify_one();
+
+	auto startTime = std::chrono::steady_clock::now();
+	while (!_finishQueue.empty()){
+		auto job = _finishQueue.front();
+		_finishQueue.pop_front();
+		finish(job);
+		if (Milliseconds(std::chrono::steady_clock::now() - startTime).count() >= _frameBudget) break;
+	}
+
+	if (_loading.empty()){
+		_scheduled = false;
+		Director::getInstance()->getScheduler()->unschedule("ParticlePreloader", this);
+	}
+}
+
+void NS_CUSTOM::ParticlePreloader::finish(Job* job)
+{
+	auto startTime = std::chrono::steady_clock::now();
+	auto cache = ParticleEffectCache::getInstance();
+	// createFromCache may have loaded it synchronously in the meantime.
+	if (!cache->peek(job->name)){
+		auto textureCache = Director::getInstance()->getTextureCache();
+		for (size_t i = 0; i < job->images.size(); i++){
+			if (job->images[i]) textureCache->addImage(job->images[i], job->imagePaths[i]);
+		}
+		auto effect = ParticleEffect::create();
+		effect->initWithDefinitions(job->definitions);
+		effect->addLoadTime(job->parseTime, job->decodeTime);
+		effect->loadEmitterImages(job->imageDirectory);
+		job->loadTime += Milliseconds(std::chrono::steady_clock::now() - startTime).count();
+		cache->insert(job->name, effect, job->loadTime);
+	}
+	complete(job);
+}
+
+void NS_CUSTOM::ParticlePreloader::complete(Job* job)
+{
+	for (auto definition : job->definitions) definition->release();
+	for (auto image : job->images) CC_SAFE_RELEASE(image);
+	_loading.erase(std::find(_loading.begin(), _loading.end(), job));
+	for (auto batch : job->batches){
+		if (--batch->remaining > 0) continue;
+		if (batch->callback) batch->callback();
+		delete batch;
+	}
+	delete job;
+}
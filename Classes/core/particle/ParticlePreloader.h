@@ -0,0 +1,95 @@
+#ifndef __PARTICLE_PRELOADER_H__
+#define __PARTICLE_PRELOADER_H__
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "cocos2d.h"
+#include "core/util/GameDefine.h"
+
+USING_NS_CC;
+using std::string;
+
+NS_CUSTOM_BEGIN
+
+class EmitterDefinition;
+
+/** Loads effects into the ParticleEffectCache in the background. Effect files are read and parsed and
+* their images decoded on a worker thread; only texture and node creation run on the GL thread, limited
+* to a time budget per frame. */
+class ParticlePreloader{
+public:
+	typedef std::function<void()> completeCallback;
+
+	ParticlePreloader() : _running(false), _scheduled(false), _frameBudget(2){}
+	~ParticlePreloader();
+	static ParticlePreloader* getInstance();
+
+	/** Starts loading the named effects. The callback runs on the GL thread once all of them are in the
+	* cache, immediately if they already are. */
+	void preload(const std::vector<string>& names, const completeCallback& callback = nullptr);
+
+	/** Sets the GL thread time spent finishing loaded effects per frame, in milliseconds. */
+	void setFrameBudget(float milliseconds) {
+		_frameBudget = milliseconds;
+	}
+
+	bool isLoading() const {
+		return !_loading.empty();
+	}
+
+private:
+	struct Batch{
+		int remaining;
+		completeCallback callback;
+	};
+
+	enum class Stage{
+		PARSE,
+		DECODE,
+		FINISH
+	};
+
+	struct Job{
+		string name;
+		string fullPath;
+		string imageDirectory;
+		std::vector<EmitterDefinition*> definitions;
+		std::vector<string> imagePaths;
+		std::vector<Image*> images;
+		Stage stage;
+		float loadTime;	// milliseconds of actual work, waiting excluded
+		float parseTime, decodeTime;	// the worker's share of it
+		std::vector<Batch*> batches;
+	};
+
+	static ParticlePreloader* _instance;
+
+	std::thread _thread;
+	std::mutex _mutex;
+	std::condition_variable _condition;
+	bool _running;
+	/** Jobs waiting for the worker, and jobs it handed back to the GL thread. Guarded by _mutex. */
+	std::deque<Job*> _workQueue;
+	std::deque<Job*> _doneQueue;
+
+	/** GL thread only. */
+	std::vector<Job*> _loading;
+	std::deque<Job*> _finishQueue;
+	bool _scheduled;
+	float _frameBudget;
+
+	void submit(Job* job);
+	void work();
+	void step(float delta);
+	void finish(Job* job);
+	void complete(Job* job);
+};
+
+NS_CUSTOM_END
+
+#endif
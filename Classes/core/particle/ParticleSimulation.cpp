@@ -0,0 +1,1471 @@
+#include "ParticleSimulation.h"
+#include "ParticleAffector.h"
+#include <cstring>
+#include <cstdlib>
+#include <climits>
+#include <algorithm>
+
+USING_NS_CUSTOM;
+
+uint32_t ParticleRandom::_state = 0x9e3779b9;
+
+float ParticleMath::_table[ParticleMath::TABLE_SIZE];
+
+const bool ParticleMath::_tableReady = ParticleMath::initTable();
+
+bool NS_CUSTOM::ParticleMath::initTable()
+{
+	static const double PI = 3.14159265358979323846;
+	for (int i = 0; i < TABLE_SIZE; i++)
+		_table[i] = (float)std::sin(i * 2 * PI / TABLE_SIZE);
+	return true;
+}
+
+static float randomf(float a, float b)
+{
+	return a < b ? ParticleRandom::random(a, b) : ParticleRandom::random(b, a);
+}
+
+static string trim(const string& text)
+{
+	size_t begin = text.find_first_not_of(" \t\r\n");
+	if (begin == string::npos) return string();
+	return text.substr(begin, text.find_last_not_of(" \t\r\n") - begin + 1);
+}
+
+/** Anything but "0" and "false" is true, as cocos2d::Value reads it. */
+static bool toBoolean(const string& text)
+{
+	return text != "0" && text != "false";
+}
+
+float_array GradientColorValue::temp = { 0, 0, 0, 0 };
+
+float_array& GradientColorValue::getColor(float percent)
+{
+	const float* timeline = timelineData();
+	const float* colors = colorsData();
+	int startIndex = 0, endIndex = -1;
+	int n = timelineCount();
+	for (int i = 1; i < n; i++) {
+		float t = timeline[i];
+		if (t > percent) {
+			endIndex = i;
+			break;
+		}
+		startIndex = i;
+	}
+	float startTime = timeline[startIndex];
+	startIndex *= 3;
+	float r1 = colors[startIndex];
+	float g1 = colors[startIndex + 1];
+	float b1 = colors[startIndex + 2];
+	if (endIndex == -1) {
+		temp[0] = r1;
+		temp[1] = g1;
+		temp[2] = b1;
+		return temp;
+	}
+	float factor = (percent - startTime) / (timeline[endIndex] - startTime);
+	endIndex *= 3;
+	temp[0] = r1 + (colors[endIndex] - r1) * factor;
+	temp[1] = g1 + (colors[endIndex + 1] - g1) * factor;
+	temp[2] = b1 + (colors[endIndex + 2] - b1) * factor;
+	return temp;
+}
+
+ostream& GradientColorValue::save(ostream& output)
+{
+	ParticleValue::save(output);
+	if (!active) return output;
+	output << "colorsCount: " << colorsCount() << "\n";
+	for (int i = 0; i != colorsCount(); i++)
+		output << "colors" << i << ": " << colorsData()[i] << "\n";
+	output << "timelineCount: " << timelineCount() << "\n";
+	for (int i = 0; i != timelineCount(); i++)
+		output << "timeline" << i << ": " << timelineData()[i] << "\n";
+	return output;
+}
+
+void GradientColorValue::load(GradientColorValue& value)
+{
+	ParticleValue::load(value);
+	colors.clear();
+	for (float v : value.colors){
+		colors.push_back(v);
+	}
+	timeline.clear();
+	for (float v : value.timeline){
+		timeline.push_back(v);
+	}
+	// Mapped curves are shared, not copied; the definition keeps the mapping alive.
+	mappedColors = value.mappedColors;
+	mappedColorsCount = value.mappedColorsCount;
+	mappedTimeline = value.mappedTimeline;
+	mappedTimelineCount = value.mappedTimelineCount;
+}
+
+void GradientColorValue::mapCurves(const float* colors, int colorsCount, const float* timeline, int timelineCount)
+{
+	this->colors.clear();
+	this->timeline.clear();
+	mappedColors = colors;
+	mappedColorsCount = colorsCount;
+	mappedTimeline = timeline;
+	mappedTimelineCount = timelineCount;
+}
+
+void GradientColorValue::load(istream& reader)
+{
+	ParticleValue::load(reader);
+	if (!active) return;
+	colors.clear();
+	int colorsCount = readInt(reader, "colorsCount");
+	for (int i = 0; i < colorsCount; i++){
+		colors.push_back(readFloat(reader, "colors"));
+	}
+	timeline.clear();
+	int timelineCount = readInt(reader, "timelineCount");
+	for (int i = 0; i < timelineCount; i++){
+		timeline.push_back(readFloat(reader, "timeline"));
+	}
+	mappedColors = nullptr;
+	mappedTimeline = nullptr;
+}
+
+void GradientColorValue::load(ParticleTextReader& reader)
+{
+	ParticleValue::load(reader);
+	if (!active) return;
+	int colorsCount = reader.readCount("colorsCount");
+	colors.resize(colorsCount);
+	for (int i = 0; i < colorsCount; i++){
+		colors[i] = reader.readFloat("colors", i);
+	}
+	int timelineCount = reader.readCount("timelineCount");
+	timeline.resize(timelineCount);
+	for (int i = 0; i < timelineCount; i++){
+		timeline[i] = reader.readFloat("timeline", i);
+	}
+	mappedColors = nullptr;
+	mappedTimeline = nullptr;
+}
+
+ParticleSimulation::ParticleSimulation() :
+	_definition(nullptr),
+	accumulator(0),
+	_throttle(1),
+	_emitting(true),
+	_spriteWidth(0), _spriteHeight(0),
+	particles(nullptr),
+	minParticleCount(0), maxParticleCount(0),
+	dx(0), dy(0),
+	_originX(0), _originY(0),
+	activeCount(0),
+	active(nullptr),
+	firstUpdate(false),
+	updateFlags(0),
+	_allowCompletion(false),
+	emission(0), emissionDiff(0), emissionDelta(0),
+	lifeOffset(0), lifeOffsetDiff(0),
+	life(0), lifeDiff(0),
+	spawnWidth(0), spawnWidthDiff(0),
+	spawnHeight(0), spawnHeightDiff(0),
+	delay(0), delayTimer(0),
+	attached(false),
+	continuous(false),
+	aligned(false),
+	behind(false),
+	_motion(nullptr),
+	_disabledUpdates(0),
+	_velocities(nullptr),
+	_recordedEvents(0)
+{
+}
+
+ParticleSimulation::~ParticleSimulation()
+{
+	delete[] active;
+	free(particles);
+	free(_motion);
+	free(_velocities);
+}
+
+void ParticleSimulation::setDefinition(ParticleDefinition* definition)
+{
+	_definition = definition;
+	setMinParticleCount(definition->minParticleCount);
+	setMaxParticleCount(definition->maxParticleCount);
+	attached = definition->attached;
+	continuous = definition->continuous;
+	aligned = definition->aligned;
+	additive = definition->additive;
+	behind = definition->behind;
+	premultipliedAlpha = definition->premultipliedAlpha;
+}
+
+void ParticleSimulation::setPosition(float x, float y)
+{
+	if (!attached) moveOrigin(this->dx - x, this->dy - y);
+	dx = x;
+	dy = y;
+}
+
+void ParticleSimulation::translate(float x, float y)
+{
+	if (!attached) moveOrigin(-x, -y);
+	dx += x;
+	dy += y;
+}
+
+void ParticleSimulation::moveOrigin(float x, float y)
+{
+	// With no particles left the origin can start over, which keeps the stored positions small.
+	if (activeCount == 0) {
+		_originX = _originY = 0;
+		return;
+	}
+	_originX += x;
+	_originY += y;
+}
+
+void ParticleSimulation::setMaxParticleCount(int maxParticleCount)
+{
+	if (this->maxParticleCount == maxParticleCount) return;
+
+	if (active) delete[]active;
+	active = new bool[maxParticleCount];
+	for (int i = 0; i < maxParticleCount; ++i){
+		active[i] = false;
+	}
+
+	free(particles);
+	particles = (Particle*)calloc(maxParticleCount, sizeof(Particle));
+	if (_motion){
+		free(_motion);
+		_motion = (float*)calloc(maxParticleCount * 2, sizeof(float));
+	}
+	if (_velocities){
+		free(_velocities);
+		_velocities = (float*)calloc(maxParticleCount * 2, sizeof(float));
+	}
+	this->maxParticleCount = maxParticleCount;
+}
+
+void ParticleSimulation::addParticle()
+{
+	int activeCount = this->activeCount;
+	if (activeCount == maxParticleCount) return;
+	for (int i = 0; i < maxParticleCount; i++) {
+		if (!active[i]) {
+			activateParticle(i);
+			active[i] = true;
+			this->activeCount = activeCount + 1;
+			break;
+		}
+	}
+}
+
+void ParticleSimulation::addParticles(int count)
+{
+	count = std::min(count, maxParticleCount - activeCount);
+	if (count <= 0) return;
+	PARTICLE_TRACE("ParticleSimulation::addParticles");
+	for (int index = 0, i = 0; i < count && index != maxParticleCount; index++) {
+		if (!active[index]) {
+			activateParticle(index);
+			active[index] = true;
+			i++;
+		}
+	}
+	this->activeCount += count;
+}
+
+void ParticleSimulation::burst(float x, float y, int count, const BurstParams& params)
+{
+	count = std::min(count, std::min(getParticleLimit(), maxParticleCount) - activeCount);
+	if (count <= 0) return;
+	bool turn = params.angle != 0 && (updateFlags & UPDATE_ANGLE) == 0;
+	float cosTurn = turn ? ParticleMath::cosDeg(params.angle) : 1;
+	float sinTurn = turn ? ParticleMath::sinDeg(params.angle) : 0;
+	for (int index = 0, i = 0; i < count && index != maxParticleCount; index++) {
+		if (active[index]) continue;
+		activateParticle(index, x, y);
+		Particle* particle = &particles[index];
+		if (params.lifeScale != 1) {
+			particle->life = std::max(1, (int)(particle->life * params.lifeScale));
+			particle->currentLife = std::max(1, (int)(particle->currentLife * params.lifeScale));
+		}
+		if (turn) {
+			float cosDir = particle->direction[0], sinDir = particle->direction[1];
+			particle->direction[0] = (int16_t)(cosDir * cosTurn - sinDir * sinTurn);
+			particle->direction[1] = (int16_t)(sinDir * cosTurn + cosDir * sinTurn);
+			particle->angle += params.angle;
+			if (aligned) particle->rotation += params.angle;
+		}
+		if (_motion) _motion[index * 2] = _motion[index * 2 + 1] = 0;
+		active[index] = true;
+		i++;
+	}
+	activeCount += count;
+	PARTICLE_STATS(_stats.activeHighWater = std::max(_stats.activeHighWater, activeCount));
+}
+
+bool ParticleSimulation::step(float delta)
+{
+	PARTICLE_STATS_TIMER(_stats.updateTime);
+	accumulator += delta * 1000;
+	if (accumulator < 1) return false;
+	int deltaMillis = (int)accumulator;
+	accumulator -= deltaMillis;
+
+	if (!_emitting) {
+		// Only bursts add particles.
+	}
+	else if (delayTimer < delay) {
+		delayTimer += deltaMillis;
+	}
+	else {
+		bool done = false;
+		if (firstUpdate) {
+			firstUpdate = false;
+			addParticle();
+		}
+
+		if (durationTimer < duration)
+			durationTimer += deltaMillis;
+		else {
+			if (!continuous || _allowCompletion)
+				done = true;
+			else
+				restart();
+		}
+
+		if (!done) {
+			emissionDelta += deltaMillis;
+			float emissionTime = emission + emissionDiff * _definition->emissionValue.getScale(durationTimer / (float)duration);
+			emissionTime *= _throttle;
+			int limit = getParticleLimit();
+			if (emissionTime > 0) {
+				emissionTime = 1000 / emissionTime;
+				if (emissionDelta >= emissionTime) {
+					int emitCount = (int)(emissionDelta / emissionTime);
+					emitCount = std::max(0, std::min(emitCount, limit - activeCount));
+					emissionDelta -= emitCount * emissionTime;
+					emissionDelta = std::fmod(emissionDelta, emissionTime);
+					addParticles(emitCount);
+				}
+			}
+			int minCount = std::min(minParticleCount, limit);
+			if (activeCount < minCount) addParticles(minCount - activeCount);
+		}
+	}
+
+	PARTICLE_TRACE("ParticleSimulation::integrate");
+	int activeCount = this->activeCount;
+	if (_motion && delta > 0) {
+		for (int i = 0; i < maxParticleCount; i++) {
+			if (!active[i]) continue;
+			float x = particles[i].x, y = particles[i].y;
+			if (!updateParticle(&particles[i], delta, deltaMillis)) {
+				active[i] = false;
+				activeCount--;
+				if ((_recordedEvents & EVENT_DEATH) != 0) recordEvent(EVENT_DEATH, &particles[i]);
+			}
+			_motion[i * 2] = (particles[i].x - x) / delta;
+			_motion[i * 2 + 1] = (particles[i].y - y) / delta;
+		}
+	}
+	else {
+		for (int i = 0; i < maxParticleCount; i++) {
+			if (active[i] && !updateParticle(&particles[i], delta, deltaMillis)) {
+				active[i] = false;
+				activeCount--;
+				if ((_recordedEvents & EVENT_DEATH) != 0) recordEvent(EVENT_DEATH, &particles[i]);
+			}
+		}
+	}
+	if (!_affectors.empty() && delta > 0) applyAffectors(delta);
+	PARTICLE_STATS(_stats.killed += this->activeCount - activeCount);
+	this->activeCount = activeCount;
+	PARTICLE_STATS(_stats.activeHighWater = std::max(_stats.activeHighWater, activeCount));
+	return true;
+}
+
+void ParticleSimulation::start()
+{
+	firstUpdate = true;
+	_allowCompletion = false;
+	restart();
+}
+
+void ParticleSimulation::reset()
+{
+	emissionDelta = 0;
+	durationTimer = duration;
+	for (int i = 0; i < maxParticleCount; i++){
+		active[i] = false;
+	}
+	activeCount = 0;
+	_originX = _originY = 0;
+	_events.clear();
+	start();
+}
+
+void ParticleSimulation::restart()
+{
+	delay = _definition->delayValue.active ? _definition->delayValue.newLowValue() : 0;
+	delayTimer = 0;
+
+	durationTimer -= duration;
+	duration = _definition->durationValue.newLowValue();
+
+	emission = (int)_definition->emissionValue.newLowValue();
+	emissionDiff = (int)_definition->emissionValue.newHighValue();
+	if (!_definition->emissionValue.isRelative()) emissionDiff -= emission;
+
+	life = (int)_definition->lifeValue.newLowValue();
+	lifeDiff = (int)_definition->lifeValue.newHighValue();
+	if (!_definition->lifeValue.isRelative()) lifeDiff -= life;
+
+	lifeOffset = _definition->lifeOffsetValue.active ? (int)_definition->lifeOffsetValue.newLowValue() : 0;
+	lifeOffsetDiff = (int)_definition->lifeOffsetValue.newHighValue();
+	if (!_definition->lifeOffsetValue.isRelative()) lifeOffsetDiff -= lifeOffset;
+
+	spawnWidth = _definition->spawnWidthValue.newLowValue();
+	spawnWidthDiff = _definition->spawnWidthValue.newHighValue();
+	if (!_definition->spawnWidthValue.isRelative()) spawnWidthDiff -= spawnWidth;
+
+	spawnHeight = _definition->spawnHeightValue.newLowValue();
+	spawnHeightDiff = _definition->spawnHeightValue.newHighValue();
+	if (!_definition->spawnHeightValue.isRelative()) spawnHeightDiff -= spawnHeight;
+
+	updateFlags = getDefinitionUpdateFlags() & ~_disabledUpdates;
+}
+
+int ParticleSimulation::getDefinitionUpdateFlags()
+{
+	int flags = 0;
+	if (_definition->angleValue.active && _definition->angleValue.timelineCount() > 1) flags |= UPDATE_ANGLE;
+	if (_definition->velocityValue.active) flags |= UPDATE_VELOCITY;
+	if (_definition->scaleValue.timelineCount() > 1) flags |= UPDATE_SCALE;
+	if (_definition->rotationValue.active && _definition->rotationValue.timelineCount() > 1) flags |= UPDATE_ROTATION;
+	if (_definition->windValue.active) flags |= UPDATE_WIND;
+	if (_definition->gravityValue.active) flags |= UPDATE_GRAVITY;
+	if (_definition->tintValue.timelineCount() > 1) flags |= UPDATE_TINT;
+	return flags;
+}
+
+void ParticleSimulation::setDisabledUpdates(int flags)
+{
+	if (_disabledUpdates == flags) return;
+	_disabledUpdates = flags;
+	updateFlags = getDefinitionUpdateFlags() & ~flags;
+}
+
+void ParticleSimulation::setMotionTracking(bool enabled)
+{
+	if (enabled == (_motion != nullptr)) return;
+	if (enabled) _motion = (float*)calloc(maxParticleCount * 2, sizeof(float));
+	else {
+		free(_motion);
+		_motion = nullptr;
+	}
+}
+
+void ParticleSimulation::addAffector(ParticleAffector* affector)
+{
+	if (std::find(_affectors.begin(), _affectors.end(), affector) != _affectors.end()) return;
+	_affectors.push_back(affector);
+	if (!_velocities) _velocities = (float*)calloc(maxParticleCount * 2, sizeof(float));
+}
+
+void ParticleSimulation::removeAffector(ParticleAffector* affector)
+{
+	_affectors.erase(std::remove(_affectors.begin(), _affectors.end(), affector), _affectors.end());
+	if (_affectors.empty()){
+		free(_velocities);
+		_velocities = nullptr;
+	}
+}
+
+void ParticleSimulation::applyAffectors(float delta)
+{
+	PARTICLE_TRACE("ParticleSimulation::applyAffectors");
+	// Stored positions are a quad's corner; affectors act on its center, where the particle is drawn.
+	ParticleAffector::Batch batch = { particles, active, _velocities, maxParticleCount,
+		_originX + _spriteWidth / 2, _originY + _spriteHeight / 2, delta };
+	for (auto affector : _affectors){
+		if (affector->isEnabled()) affector->accelerate(batch);
+	}
+	for (int i = 0; i < maxParticleCount; i++){
+		if (!active[i]) continue;
+		particles[i].x += _velocities[i * 2] * delta;
+		particles[i].y += _velocities[i * 2 + 1] * delta;
+		if (_motion){
+			_motion[i * 2] += _velocities[i * 2];
+			_motion[i * 2 + 1] += _velocities[i * 2 + 1];
+		}
+	}
+	for (auto affector : _affectors){
+		if (affector->isEnabled()) affector->constrain(batch);
+	}
+}
+
+void ParticleSimulation::activateParticle(int index, float originX, float originY)
+{
+	PARTICLE_STATS(_stats.spawned++);
+	Particle* particle = &particles[index];
+	if (_velocities) _velocities[index * 2] = _velocities[index * 2 + 1] = 0;
+
+	float percent = durationTimer / (float)duration;
+	int updateFlags = this->updateFlags;
+
+	particle->currentLife = particle->life = life + (int)(lifeDiff * _definition->lifeValue.getScale(percent));
+
+	if (_definition->velocityValue.active) particle->velocityRange.randomize();
+
+	float angle = 0;
+	if ((updateFlags & UPDATE_ANGLE) == 0) {
+		ParticleRange angleRange;
+		angleRange.randomize();
+		angle = _definition->angleValue.getValue(angleRange, 0);
+		particle->direction[0] = (int16_t)(ParticleMath::cosDeg(angle) * 0x7fff);
+		particle->direction[1] = (int16_t)(ParticleMath::sinDeg(angle) * 0x7fff);
+	}
+	else
+		particle->angleRange.randomize();
+	particle->angle = angle;
+
+	particle->scaleRange.randomize();
+	particle->scale = _definition->scaleValue.getValue(particle->scaleRange, 0) / _spriteWidth;
+
+	particle->rotation = 0;
+	if (_definition->rotationValue.active) {
+		particle->rotationRange.randomize();
+		float rotation = _definition->rotationValue.getValue(particle->rotationRange, 0);
+		if (aligned) rotation += angle;
+		particle->rotation = rotation;
+	}
+
+	if (_definition->windValue.active) particle->windRange.randomize();
+
+	if (_definition->gravityValue.active) particle->gravityRange.randomize();
+
+	const float_array& temp = _definition->tintValue.getColor(0);
+	particle->tint[0] = (uint8_t)(temp[0] * 255);
+	particle->tint[1] = (uint8_t)(temp[1] * 255);
+	particle->tint[2] = (uint8_t)(temp[2] * 255);
+
+	particle->transparencyRange.randomize();
+
+	// Spawn.
+	float x = originX;
+	if (_definition->xOffsetValue.active) x += _definition->xOffsetValue.newLowValue();
+	float y = originY;
+	if (_definition->yOffsetValue.active) y += _definition->yOffsetValue.newLowValue();
+	switch (_definition->spawnShapeValue.shape) {
+	case square: {
+		float width = spawnWidth + (spawnWidthDiff * _definition->spawnWidthValue.getScale(percent));
+		float height = spawnHeight + (spawnHeightDiff * _definition->spawnHeightValue.getScale(percent));
+		x += randomf(0.0f, width) - width / 2;
+		y += randomf(0.0f, height) - height / 2;
+		break;
+	}
+	case ellipse: {
+		float width = spawnWidth + (spawnWidthDiff * _definition->spawnWidthValue.getScale(percent));
+		float height = spawnHeight + (spawnHeightDiff * _definition->spawnHeightValue.getScale(percent));
+		float radiusX = width / 2;
+		float radiusY = height / 2;
+		if (radiusX == 0 || radiusY == 0) break;
+		float scaleY = radiusX / (float)radiusY;
+		if (_definition->spawnShapeValue.edges) {
+			float spawnAngle;
+			switch (_definition->spawnShapeValue.side) {
+			case top:
+				spawnAngle = -ParticleRandom::random(0.0f, 179.0f);
+				break;
+			case bottom:
+				spawnAngle = ParticleRandom::random(0.0f, 179.0f);
+				break;
+			default:
+				spawnAngle = ParticleRandom::random(0.0f, 360.0f);
+				break;
+			}
+			float cosDeg = ParticleMath::cosDeg(spawnAngle);
+			float sinDeg = ParticleMath::sinDeg(spawnAngle);
+			x += cosDeg * radiusX;
+			y += sinDeg * radiusX / scaleY;
+			if ((updateFlags & UPDATE_ANGLE) == 0) {
+				particle->angle = spawnAngle;
+				particle->direction[0] = (int16_t)(cosDeg * 0x7fff);
+				particle->direction[1] = (int16_t)(sinDeg * 0x7fff);
+			}
+		}
+		else {
+			float radius2 = radiusX * radiusX;
+			while (true) {
+				float px = randomf(0.0f, width) - radiusX;
+				float py = randomf(0.0f, height) - radiusY;
+				if (px * px + py * py <= radius2) {
+					x += px;
+					y += py / scaleY;
+					break;
+				}
+			}
+		}
+		break;
+	}
+	case line: {
+		float width = spawnWidth + (spawnWidthDiff * _definition->spawnWidthValue.getScale(percent));
+		float height = spawnHeight + (spawnHeightDiff * _definition->spawnHeightValue.getScale(percent));
+		if (width != 0) {
+			float lineX = randomf(0.0f, width);
+			x += lineX;
+			y += lineX * (height / (float)width);
+		}
+		else
+			y += randomf(0.0f, height);
+		break;
+	}
+	}
+
+	particle->x = x - _spriteWidth / 2 - _originX;
+	particle->y = y - _spriteHeight / 2 - _originY;
+	if ((_recordedEvents & EVENT_BIRTH) != 0) recordEvent(EVENT_BIRTH, particle);
+
+	int offsetTime = (int)(lifeOffset + lifeOffsetDiff * _definition->lifeOffsetValue.getScale(percent));
+	if (offsetTime > 0) {
+		if (offsetTime >= particle->currentLife) offsetTime = particle->currentLife - 1;
+		updateParticle(particle, offsetTime / 1000.0f, offsetTime);
+	}
+}
+
+bool ParticleSimulation::updateParticle(Particle* particle, float delta, int deltaMillis)
+{
+	int life = particle->currentLife - deltaMillis;
+	if (life <= 0) return false;
+	particle->currentLife = life;
+
+	float percent = 1 - particle->currentLife / (float)particle->life;
+	int updateFlags = this->updateFlags;
+
+	if ((updateFlags & UPDATE_SCALE) != 0)
+		particle->scale = _definition->scaleValue.getValue(particle->scaleRange, percent) / _spriteWidth;
+
+	if ((updateFlags & UPDATE_VELOCITY) != 0) {
+		float velocity = _definition->velocityValue.getValue(particle->velocityRange, percent) * delta;
+
+		float velocityX, velocityY;
+		if ((updateFlags & UPDATE_ANGLE) != 0) {
+			float angle = _definition->angleValue.getValue(particle->angleRange, percent);
+			velocityX = velocity * ParticleMath::cosDeg(angle);
+			velocityY = velocity * ParticleMath::sinDeg(angle);
+			if ((updateFlags & UPDATE_ROTATION) != 0) {
+				float rotation = _definition->rotationValue.getValue(particle->rotationRange, percent);
+				if (aligned) rotation += angle;
+				particle->rotation = rotation;
+			}
+		}
+		else {
+			velocityX = velocity * (particle->direction[0] / (float)0x7fff);
+			velocityY = velocity * (particle->direction[1] / (float)0x7fff);
+			if (aligned || (updateFlags & UPDATE_ROTATION) != 0) {
+				float rotation = _definition->rotationValue.getValue(particle->rotationRange, percent);
+				if (aligned) rotation += particle->angle;
+				particle->rotation = rotation;
+			}
+		}
+
+		if ((updateFlags & UPDATE_WIND) != 0)
+			velocityX += _definition->windValue.getValue(particle->windRange, percent) * delta;
+
+		if ((updateFlags & UPDATE_GRAVITY) != 0)
+			velocityY += _definition->gravityValue.getValue(particle->gravityRange, percent) * delta;
+
+		particle->x += velocityX;
+		particle->y += velocityY;
+	}
+	else {
+		if ((updateFlags & UPDATE_ROTATION) != 0)
+			particle->rotation = _definition->rotationValue.getValue(particle->rotationRange, percent);
+	}
+
+	float red, green, blue;
+	if ((updateFlags & UPDATE_TINT) != 0){
+		const auto& color = _definition->tintValue.getColor(percent);
+		red = color[0];
+		green = color[1];
+		blue = color[2];
+	}
+	else{
+		red = particle->tint[0] / 255.0f;
+		green = particle->tint[1] / 255.0f;
+		blue = particle->tint[2] / 255.0f;
+	}
+
+	float transparencyLow = _definition->transparencyValue.getLowValue(particle->transparencyRange.low);
+	float transparencyDiff = _definition->transparencyValue.getHighValue(particle->transparencyRange.high) - transparencyLow;
+	float a = transparencyLow + transparencyDiff * _definition->transparencyValue.getScale(percent);
+	ParticleColor& color = particle->color;
+	if (premultipliedAlpha) {
+		float alphaMultiplier = additive ? 0 : 1;
+		color.r = (uint8_t)(red * a * 255);
+		color.g = (uint8_t)(green * a * 255);
+		color.b = (uint8_t)(blue * a * 255);
+		color.a = (uint8_t)(a * alphaMultiplier * 255);
+	}
+	else {
+		color.r = (uint8_t)(red * 255);
+		color.g = (uint8_t)(green * 255);
+		color.b = (uint8_t)(blue * 255);
+		color.a = (uint8_t)(a * 255);
+	}
+	return true;
+}
+
+size_t ParticleSimulation::getParticleMemorySize() const
+{
+	size_t size = (sizeof(Particle) + sizeof(bool)) * maxParticleCount;
+	if (_motion) size += sizeof(float) * 2 * maxParticleCount;
+	if (_velocities) size += sizeof(float) * 2 * maxParticleCount;
+	return size;
+}
+
+ParticleMemoryUsage ParticleSimulation::getMemoryUsage() const
+{
+	ParticleMemoryUsage usage;
+	usage.state = sizeof(ParticleSimulation);
+	usage.particles = getParticleMemorySize();
+	return usage;
+}
+
+bool ParticleSimulation::isComplete()
+{
+	if (continuous) return false;
+	if (delayTimer < delay) return false;
+	return durationTimer >= duration && activeCount == 0;
+}
+
+float ParticleSimulation::getPercentComplete()
+{
+	if (delayTimer < delay) return 0;
+	return std::min(1.0f, durationTimer / (float)duration);
+}
+
+ParticleDefinition::ParticleDefinition() :
+	minParticleCount(0), maxParticleCount(0),
+	attached(false),
+	continuous(false),
+	aligned(false),
+	additive(true),
+	behind(false),
+	premultipliedAlpha(false)
+{
+	durationValue.setAlwaysActive(true);
+	emissionValue.setAlwaysActive(true);
+	lifeValue.setAlwaysActive(true);
+	scaleValue.setAlwaysActive(true);
+	transparencyValue.setAlwaysActive(true);
+	spawnShapeValue.setAlwaysActive(true);
+	spawnWidthValue.setAlwaysActive(true);
+	spawnHeightValue.setAlwaysActive(true);
+}
+
+void ParticleDefinition::load(ParticleDefinition& definition)
+{
+	name = definition.name;
+	imagePath = definition.imagePath;
+	minParticleCount = definition.minParticleCount;
+	maxParticleCount = definition.maxParticleCount;
+	delayValue.load(definition.delayValue);
+	durationValue.load(definition.durationValue);
+	emissionValue.load(definition.emissionValue);
+	lifeValue.load(definition.lifeValue);
+	lifeOffsetValue.load(definition.lifeOffsetValue);
+	scaleValue.load(definition.scaleValue);
+	rotationValue.load(definition.rotationValue);
+	velocityValue.load(definition.velocityValue);
+	angleValue.load(definition.angleValue);
+	windValue.load(definition.windValue);
+	gravityValue.load(definition.gravityValue);
+	transparencyValue.load(definition.transparencyValue);
+	tintValue.load(definition.tintValue);
+	xOffsetValue.load(definition.xOffsetValue);
+	yOffsetValue.load(definition.yOffsetValue);
+	spawnWidthValue.load(definition.spawnWidthValue);
+	spawnHeightValue.load(definition.spawnHeightValue);
+	spawnShapeValue.load(definition.spawnShapeValue);
+	attached = definition.attached;
+	continuous = definition.continuous;
+	aligned = definition.aligned;
+	additive = definition.additive;
+	behind = definition.behind;
+	premultipliedAlpha = definition.premultipliedAlpha;
+}
+
+ParticleMemoryUsage ParticleDefinition::getMemoryUsage() const
+{
+	ParticleMemoryUsage usage;
+	usage.state = sizeof(ParticleDefinition) + name.capacity() + imagePath.capacity();
+	usage.curves = lifeOffsetValue.getCurveSize() + lifeValue.getCurveSize() + emissionValue.getCurveSize();
+	usage.curves += scaleValue.getCurveSize() + rotationValue.getCurveSize() + velocityValue.getCurveSize();
+	usage.curves += angleValue.getCurveSize() + windValue.getCurveSize() + gravityValue.getCurveSize();
+	usage.curves += transparencyValue.getCurveSize() + tintValue.getCurveSize();
+	usage.curves += xOffsetValue.getCurveSize() + yOffsetValue.getCurveSize();
+	usage.curves += spawnWidthValue.getCurveSize() + spawnHeightValue.getCurveSize();
+	return usage;
+}
+
+ostream& ParticleDefinition::save(ostream& output)
+{
+	return save(output, minParticleCount, maxParticleCount, attached, continuous, aligned, additive, behind,
+		premultipliedAlpha);
+}
+
+ostream& ParticleDefinition::save(ostream& output, int minParticleCount, int maxParticleCount, bool attached,
+	bool continuous, bool aligned, bool additive, bool behind, bool premultipliedAlpha)
+{
+	output << name << "\n";
+	output << "- Delay -\n";
+	delayValue.save(output);
+	output << "- Duration - \n";
+	durationValue.save(output);
+	output << "- Count - \n";
+	output << "min: " << minParticleCount << "\n";
+	output << "max: " << maxParticleCount << "\n";
+	output << "- Emission - \n";
+	emissionValue.save(output);
+	output << "- Life - \n";
+	lifeValue.save(output);
+	output << "- Life Offset - \n";
+	lifeOffsetValue.save(output);
+	output << "- X Offset - \n";
+	xOffsetValue.save(output);
+	output << "- Y Offset - \n";
+	yOffsetValue.save(output);
+	output << "- Spawn Shape - \n";
+	spawnShapeValue.save(output);
+	output << "- Spawn Width - \n";
+	spawnWidthValue.save(output);
+	output << "- Spawn Height - \n";
+	spawnHeightValue.save(output);
+	output << "- Scale - \n";
+	scaleValue.save(output);
+	output << "- Velocity - \n";
+	velocityValue.save(output);
+	output << "- Angle - \n";
+	angleValue.save(output);
+	output << "- Rotation - \n";
+	rotationValue.save(output);
+	output << "- Wind - \n";
+	windValue.save(output);
+	output << "- Gravity - \n";
+	gravityValue.save(output);
+	output << "- Tint - \n";
+	tintValue.save(output);
+	output << "- Transparency - \n";
+	transparencyValue.save(output);
+	output << "- Options - \n";
+	output << "attached: " << (attached ? "true" : "false") << "\n";
+	output << "continuous: " << (continuous ? "true" : "false") << "\n";
+	output << "aligned: " << (aligned ? "true" : "false") << "\n";
+	output << "additive: " << (additive ? "true" : "false") << "\n";
+	output << "behind: " << (behind ? "true" : "false") << "\n";
+	output << "premultipliedAlpha: " << (premultipliedAlpha ? "true" : "false") << "\n";
+	output << "- Image Path -\n";
+	output << imagePath << "\n";
+	return output;
+}
+
+void ParticleDefinition::load(istream& reader)
+{
+	string line;
+	name = readString(reader, "name");
+	getline(reader, line);
+	delayValue.load(reader);
+	getline(reader, line);
+	durationValue.load(reader);
+	getline(reader, line);
+	minParticleCount = readInt(reader, "minParticleCount");
+	maxParticleCount = readInt(reader, "maxParticleCount");
+	getline(reader, line);
+	emissionValue.load(reader);
+	getline(reader, line);
+	lifeValue.load(reader);
+	getline(reader, line);
+	lifeOffsetValue.load(reader);
+	getline(reader, line);
+	xOffsetValue.load(reader);
+	getline(reader, line);
+	yOffsetValue.load(reader);
+	getline(reader, line);
+	spawnShapeValue.load(reader);
+	getline(reader, line);
+	spawnWidthValue.load(reader);
+	getline(reader, line);
+	spawnHeightValue.load(reader);
+	getline(reader, line);
+	scaleValue.load(reader);
+	getline(reader, line);
+	velocityValue.load(reader);
+	getline(reader, line);
+	angleValue.load(reader);
+	getline(reader, line);
+	rotationValue.load(reader);
+	getline(reader, line);
+	windValue.load(reader);
+	getline(reader, line);
+	gravityValue.load(reader);
+	getline(reader, line);
+	tintValue.load(reader);
+	getline(reader, line);
+	transparencyValue.load(reader);
+	getline(reader, line);
+	attached = readBoolean(reader, "attached");
+	continuous = readBoolean(reader, "continuous");
+	aligned = readBoolean(reader, "aligned");
+	additive = readBoolean(reader, "additive");
+	behind = readBoolean(reader, "behind");
+
+	// Backwards compatibility
+	getline(reader, line);
+	if (line.compare(0, 18, "premultipliedAlpha") == 0) {
+		premultipliedAlpha = readBoolean(line);
+		getline(reader, line);
+	}
+	getline(reader, line);
+	imagePath = trim(line);
+}
+
+bool ParticleDefinition::load(ParticleTextReader& reader)
+{
+	// Like readString(reader, "name"), anything up to a colon is dropped.
+	name = reader.readLine();
+	auto colon = name.find(':');
+	if (colon != string::npos) name = trim(name.substr(colon + 1));
+	reader.skipLine();
+	delayValue.load(reader);
+	reader.skipLine();
+	durationValue.load(reader);
+	reader.skipLine();
+	minParticleCount = reader.readInt("min");
+	maxParticleCount = reader.readInt("max");
+	reader.skipLine();
+	emissionValue.load(reader);
+	reader.skipLine();
+	lifeValue.load(reader);
+	reader.skipLine();
+	lifeOffsetValue.load(reader);
+	reader.skipLine();
+	xOffsetValue.load(reader);
+	reader.skipLine();
+	yOffsetValue.load(reader);
+	reader.skipLine();
+	spawnShapeValue.load(reader);
+	reader.skipLine();
+	spawnWidthValue.load(reader);
+	reader.skipLine();
+	spawnHeightValue.load(reader);
+	reader.skipLine();
+	scaleValue.load(reader);
+	reader.skipLine();
+	velocityValue.load(reader);
+	reader.skipLine();
+	angleValue.load(reader);
+	reader.skipLine();
+	rotationValue.load(reader);
+	reader.skipLine();
+	windValue.load(reader);
+	reader.skipLine();
+	gravityValue.load(reader);
+	reader.skipLine();
+	tintValue.load(reader);
+	reader.skipLine();
+	transparencyValue.load(reader);
+	reader.skipLine();
+	attached = reader.readBoolean("attached");
+	continuous = reader.readBoolean("continuous");
+	aligned = reader.readBoolean("aligned");
+	additive = reader.readBoolean("additive");
+	behind = reader.readBoolean("behind");
+
+	// Backwards compatibility
+	if (reader.hasKey("premultipliedAlpha"))
+		premultipliedAlpha = reader.readBoolean("premultipliedAlpha");
+	reader.skipLine();
+	imagePath = reader.readLine();
+	return !reader.hasFailed();
+}
+
+ostream& NumericValue::save(ostream& output)
+{
+	ParticleValue::save(output);
+	if (!active) return output;
+	output << "value: " << value << "\n";
+	return  output;
+}
+
+void NumericValue::load(NumericValue& value)
+{
+	ParticleValue::load(value);
+	this->value = value.value;
+}
+
+void NumericValue::load(istream& reader)
+{
+	ParticleValue::load(reader);
+	if (!active) return;
+	value = readFloat(reader, "value");
+}
+
+void NumericValue::load(ParticleTextReader& reader)
+{
+	ParticleValue::load(reader);
+	if (!active) return;
+	value = reader.readFloat("value");
+}
+
+ostream& RangedNumericValue::save(ostream& output)
+{
+	ParticleValue::save(output);
+	if (!active) return output;
+	output << "lowMin: " << lowMin << "\n";
+	output << "lowMax: " << lowMax << "\n";
+	return output;
+}
+
+void NS_CUSTOM::RangedNumericValue::load(RangedNumericValue& value)
+{
+	ParticleValue::load(value);
+	lowMax = value.lowMax;
+	lowMin = value.lowMin;
+}
+
+void NS_CUSTOM::RangedNumericValue::load(istream& reader)
+{
+	ParticleValue::load(reader);
+	if (!active) return;
+	lowMin = readFloat(reader, "lowMin");
+	lowMax = readFloat(reader, "lowMax");
+}
+
+void NS_CUSTOM::RangedNumericValue::load(ParticleTextReader& reader)
+{
+	ParticleValue::load(reader);
+	if (!active) return;
+	lowMin = reader.readFloat("lowMin");
+	lowMax = reader.readFloat("lowMax");
+}
+
+float ScaledNumericValue::getScale(float percent)
+{
+	const float* timeline = timelineData();
+	const float* scaling = scalingData();
+	int endIndex = -1;
+	int n = timelineCount();
+	for (int i = 1; i < n; i++) {
+		float t = timeline[i];
+		if (t > percent) {
+			endIndex = i;
+			break;
+		}
+	}
+	if (endIndex == -1) return scaling[n - 1];
+	int startIndex = endIndex - 1;
+	float startValue = scaling[startIndex];
+	float startTime = timeline[startIndex];
+	return startValue + (scaling[endIndex] - startValue) * ((percent - startTime) / (timeline[endIndex] - startTime));
+
+}
+
+ostream& ScaledNumericValue::save(ostream& output)
+{
+	RangedNumericValue::save(output);
+	if (!active) return output;
+	output << "highMin: " << highMin << "\n";
+	output << "highMax: " << highMax << "\n";
+	output << "relative: " << (relative ? "true" : "false") << "\n";
+	output << "scalingCount: " << scalingCount() << "\n";
+	for (int i = 0; i != scalingCount(); i++)
+		output << "scaling" << i << ": " << scalingData()[i] << "\n";
+	output << "timelineCount: " << timelineCount() << "\n";
+	for (int i = 0; i != timelineCount(); i++)
+		output << "timeline" << i << ": " << timelineData()[i] << "\n";
+	return output;
+}
+
+void ScaledNumericValue::load(ScaledNumericValue& value)
+{
+	RangedNumericValue::load(value);
+	highMax = value.highMax;
+	highMin = value.highMin;
+	scaling.clear();
+	for (float v : value.scaling){
+		scaling.push_back(v);
+	}
+	timeline.clear();
+	for (float v : value.timeline){
+		timeline.push_back(v);
+	}
+	// Mapped curves are shared, not copied; the definition keeps the mapping alive.
+	mappedScaling = value.mappedScaling;
+	mappedScalingCount = value.mappedScalingCount;
+	mappedTimeline = value.mappedTimeline;
+	mappedTimelineCount = value.mappedTimelineCount;
+	relative = value.relative;
+}
+
+void ScaledNumericValue::mapCurves(const float* scaling, int scalingCount, const float* timeline, int timelineCount)
+{
+	this->scaling.clear();
+	this->timeline.clear();
+	mappedScaling = scaling;
+	mappedScalingCount = scalingCount;
+	mappedTimeline = timeline;
+	mappedTimelineCount = timelineCount;
+}
+
+void ScaledNumericValue::load(istream& reader)
+{
+	RangedNumericValue::load(reader);
+	if (!active) return;
+	highMin = readFloat(reader, "highMin");
+	highMax = readFloat(reader, "highMax");
+	relative = readBoolean(reader, "relative");
+	scaling.clear();
+	int scalingCount = readInt(reader, "scalingCount");
+	for (int i = 0; i < scalingCount; i++){
+		scaling.push_back(readFloat(reader, "scaling"));
+	}
+	timeline.clear();
+	int timelineCount = readInt(reader, "timelineCount");
+	for (int i = 0; i < timelineCount; i++){
+		timeline.push_back(readFloat(reader, "timeline"));
+	}
+	mappedScaling = nullptr;
+	mappedTimeline = nullptr;
+}
+
+void ScaledNumericValue::load(ParticleTextReader& reader)
+{
+	RangedNumericValue::load(reader);
+	if (!active) return;
+	highMin = reader.readFloat("highMin");
+	highMax = reader.readFloat("highMax");
+	relative = reader.readBoolean("relative");
+	int scalingCount = reader.readCount("scalingCount");
+	scaling.resize(scalingCount);
+	for (int i = 0; i < scalingCount; i++){
+		scaling[i] = reader.readFloat("scaling", i);
+	}
+	int timelineCount = reader.readCount("timelineCount");
+	timeline.resize(timelineCount);
+	for (int i = 0; i < timelineCount; i++){
+		timeline[i] = reader.readFloat("timeline", i);
+	}
+	mappedScaling = nullptr;
+	mappedTimeline = nullptr;
+}
+
+ostream& SpawnShapeValue::save(ostream& output)
+{
+	ParticleValue::save(output);
+	if (!active) return output;
+	for (auto& pair : SpawnShapeMap){
+		if (pair.second == shape){
+			output << "shape: " << pair.first << "\n";
+			break;
+		}
+	}
+	if (shape == SpawnShape::ellipse) {
+		output << "edges: " << (edges ? "true" : "false") << "\n";
+		for (auto& pair : SpawnEllipseSideMap){
+			if (pair.second == side){
+				output << "side: " << pair.first << "\n";
+				break;
+			}
+		}
+	}
+	return output;
+}
+
+void SpawnShapeValue::load(SpawnShapeValue& value)
+{
+	ParticleValue::load(value);
+	shape = value.shape;
+	edges = value.edges;
+	side = value.side;
+}
+
+void SpawnShapeValue::load(istream& reader)
+{
+	ParticleValue::load(reader);
+	if (!active) return;
+	// find() rather than operator[], definitions are also parsed on the preload thread.
+	auto shapeIt = SpawnShapeMap.find(readString(reader, "shape"));
+	shape = shapeIt != SpawnShapeMap.end() ? shapeIt->second : SpawnShape::point;
+	if (shape == SpawnShape::ellipse) {
+		edges = readBoolean(reader, "edges");
+		auto sideIt = SpawnEllipseSideMap.find(readString(reader, "side"));
+		side = sideIt != SpawnEllipseSideMap.end() ? sideIt->second : SpawnEllipseSide::both;
+	}
+}
+
+void SpawnShapeValue::load(ParticleTextReader& reader)
+{
+	ParticleValue::load(reader);
+	if (!active) return;
+	auto shapeIt = SpawnShapeMap.find(reader.readString("shape"));
+	shape = shapeIt != SpawnShapeMap.end() ? shapeIt->second : SpawnShape::point;
+	if (shape == SpawnShape::ellipse) {
+		edges = reader.readBoolean("edges");
+		auto sideIt = SpawnEllipseSideMap.find(reader.readString("side"));
+		side = sideIt != SpawnEllipseSideMap.end() ? sideIt->second : SpawnEllipseSide::both;
+	}
+}
+
+ostream& ParticleValue::save(ostream& output)
+{
+	if (!alwaysActive)
+		output << "active: " << (active ? "true" : "false") << "\n";
+	else
+		active = true;
+	return output;
+}
+
+void NS_CUSTOM::ParticleValue::load(istream& reader)
+{
+	if (!alwaysActive)
+		active = readBoolean(reader, "active");
+	else
+		active = true;
+}
+
+void NS_CUSTOM::ParticleValue::load(ParticleTextReader& reader)
+{
+	if (!alwaysActive)
+		active = reader.readBoolean("active");
+	else
+		active = true;
+}
+
+void NS_CUSTOM::ParticleValue::load(ParticleValue& value)
+{
+	active = value.active;
+	alwaysActive = value.alwaysActive;
+}
+
+string NS_CUSTOM::readString(string line)
+{
+	return trim(line.substr(line.find(":") + 1));
+}
+
+string NS_CUSTOM::readString(istream& reader, string name)
+{
+	string line;
+	getline(reader, line);
+	if (line.empty()) return line;
+	return readString(line);
+}
+
+bool NS_CUSTOM::readBoolean(string line)
+{
+	return toBoolean(readString(line));
+}
+
+bool NS_CUSTOM::readBoolean(istream& reader, string name)
+{
+	return toBoolean(readString(reader, name));
+}
+
+int NS_CUSTOM::readInt(istream& reader, string name)
+{
+	return atoi(readString(reader, name).c_str());
+}
+
+float NS_CUSTOM::readFloat(istream& reader, string name)
+{
+	return (float)atof(readString(reader, name).c_str());
+}
+
+
+static bool isBlank(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+bool NS_CUSTOM::ParticleTextReader::skipLine()
+{
+	auto lineEnd = (const char*)memchr(_current, '\n', _end - _current);
+	if (!lineEnd){
+		_current = _end;
+		return false;
+	}
+	_current = lineEnd + 1;
+	return true;
+}
+
+string NS_CUSTOM::ParticleTextReader::readLine()
+{
+	if (_failed || _current == _end){
+		_failed = true;
+		return string();
+	}
+	auto begin = _current;
+	skipLine();
+	auto end = _current;
+	if (end > begin && end[-1] == '\n') end--;
+	while (begin < end && (isBlank(*begin) || *begin == '\n')) begin++;
+	while (end > begin && isBlank(end[-1])) end--;
+	return string(begin, end);
+}
+
+bool NS_CUSTOM::ParticleTextReader::hasKey(const char* key) const
+{
+	size_t length = strlen(key);
+	return !_failed && (size_t)(_end - _current) > length && memcmp(_current, key, length) == 0 && _current[length] == ':';
+}
+
+bool NS_CUSTOM::ParticleTextReader::readValue(const char* key, int index, const char*& begin, const char*& end)
+{
+	if (_failed || _current == _end){
+		_failed = true;
+		return false;
+	}
+	auto lineBegin = _current;
+	skipLine();
+	auto lineEnd = _current;
+	if (lineEnd > lineBegin && lineEnd[-1] == '\n') lineEnd--;
+	auto colon = (const char*)memchr(lineBegin, ':', lineEnd - lineBegin);
+	if (!colon || !matchKey(lineBegin, colon, key, index)){
+		_failed = true;
+		return false;
+	}
+	begin = colon + 1;
+	end = lineEnd;
+	while (begin < end && isBlank(*begin)) begin++;
+	while (end > begin && isBlank(end[-1])) end--;
+	return true;
+}
+
+bool NS_CUSTOM::ParticleTextReader::matchKey(const char* begin, const char* end, const char* key, int index)
+{
+	while (*key){
+		if (begin == end || *begin++ != *key++) return false;
+	}
+	if (index < 0) return begin == end;
+	int value;
+	return parseInt(begin, end, value) && value == index && *begin != '-' && *begin != '+';
+}
+
+string NS_CUSTOM::ParticleTextReader::readString(const char* key)
+{
+	const char* begin;
+	const char* end;
+	if (!readValue(key, -1, begin, end)) return string();
+	return string(begin, end);
+}
+
+bool NS_CUSTOM::ParticleTextReader::readBoolean(const char* key)
+{
+	const char* begin;
+	const char* end;
+	if (!readValue(key, -1, begin, end)) return false;
+	size_t length = end - begin;
+	if (length == 4 && memcmp(begin, "true", 4) == 0) return true;
+	if (length == 5 && memcmp(begin, "false", 5) == 0) return false;
+	_failed = true;
+	return false;
+}
+
+int NS_CUSTOM::ParticleTextReader::readInt(const char* key)
+{
+	const char* begin;
+	const char* end;
+	int value = 0;
+	if (readValue(key, -1, begin, end) && !parseInt(begin, end, value)) _failed = true;
+	return value;
+}
+
+int NS_CUSTOM::ParticleTextReader::readCount(const char* key)
+{
+	int count = readInt(key);
+	// Every entry takes at least four bytes ("x0:0"), which bounds the count before anything is allocated.
+	if (_failed || count < 0 || (size_t)count > (size_t)(_end - _current) / 4){
+		_failed = true;
+		return 0;
+	}
+	return count;
+}
+
+float NS_CUSTOM::ParticleTextReader::readFloat(const char* key, int index)
+{
+	const char* begin;
+	const char* end;
+	float value = 0;
+	if (readValue(key, index, begin, end) && !parseFloat(begin, end, value)) _failed = true;
+	return value;
+}
+
+bool NS_CUSTOM::ParticleTextReader::parseInt(const char* begin, const char* end, int& value)
+{
+	bool negative = false;
+	if (begin < end && (*begin == '-' || *begin == '+')) negative = *begin++ == '-';
+	if (begin == end) return false;
+	long long result = 0;
+	for (; begin < end; begin++){
+		if (*begin < '0' || *begin > '9') return false;
+		result = result * 10 + (*begin - '0');
+		if (result > INT_MAX) return false;
+	}
+	value = (int)(negative ? -result : result);
+	return true;
+}
+
+bool NS_CUSTOM::ParticleTextReader::parseFloat(const char* begin, const char* end, float& value)
+{
+	bool negative = false;
+	if (begin < end && (*begin == '-' || *begin == '+')) negative = *begin++ == '-';
+	// Up to 19 significant digits go into the mantissa, the rest only move the decimal exponent.
+	unsigned long long mantissa = 0;
+	int digits = 0, exponent = 0;
+	bool anyDigit = false;
+	for (; begin < end && *begin >= '0' && *begin <= '9'; begin++){
+		anyDigit = true;
+		if (digits < 19){
+			mantissa = mantissa * 10 + (*begin - '0');
+			if (mantissa) digits++;
+		}
+		else exponent++;
+	}
+	if (begin < end && *begin == '.'){
+		for (begin++; begin < end && *begin >= '0' && *begin <= '9'; begin++){
+			anyDigit = true;
+			if (digits < 19){
+				mantissa = mantissa * 10 + (*begin - '0');
+				if (mantissa) digits++;
+				exponent--;
+			}
+		}
+	}
+	if (!anyDigit) return false;
+	if (begin < end && (*begin == 'e' || *begin == 'E')){
+		begin++;
+		bool negativeExponent = false;
+		if (begin < end && (*begin == '-' || *begin == '+')) negativeExponent = *begin++ == '-';
+		if (begin == end) return false;
+		int e = 0;
+		for (; begin < end; begin++){
+			if (*begin < '0' || *begin > '9') return false;
+			if (e < 1000) e = e * 10 + (*begin - '0');
+		}
+		exponent += negativeExponent ? -e : e;
+	}
+	if (begin != end) return false;
+	double result = (double)mantissa;
+	if (exponent < 0) result /= pow(10.0, -exponent);
+	else if (exponent > 0) result *= pow(10.0, exponent);
+	value = (float)(negative ? -result : result);
+	return true;
+}
@@ -0,0 +1,950 @@
+#ifndef __PARTICLE_SIMULATION_H__
+#define __PARTICLE_SIMULATION_H__
+
+#include <string>
+#include <iostream>
+#include <map>
+#include <vector>
+#include <type_traits>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include "ParticleStats.h"
+#include "ParticleTrace.h"
+#include "core/util/GameDefine.h"
+
+using std::string;
+using std::istream;
+using std::ostream;
+
+NS_CUSTOM_BEGIN
+
+class ParticleTextReader;
+
+/** The random source of every simulation, a xorshift generator. Seeding it makes a run repeatable, e.g. to
+* validate a replay on a server. */
+class ParticleRandom {
+public:
+	static void setSeed(uint32_t seed) {
+		_state = seed ? seed : 0x9e3779b9;
+	}
+
+	/** The generator's position, to put it back with setState() after a run that seeded it. */
+	static uint32_t getState() {
+		return _state;
+	}
+
+	static void setState(uint32_t state) {
+		setSeed(state);
+	}
+
+	static uint32_t next() {
+		uint32_t x = _state;
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		return _state = x;
+	}
+
+	/** Uniform in [min, max). */
+	static float random(float min, float max) {
+		return min + (max - min) * ((next() >> 8) * (1.0f / 16777216));
+	}
+private:
+	static uint32_t _state;
+};
+
+/** Sine and cosine of an angle in degrees from a lookup table, accurate to about 0.0004. */
+class ParticleMath {
+public:
+	static float sinDeg(float degrees) {
+		return _table[(int)(degrees * TABLE_PER_DEGREE) & TABLE_MASK];
+	}
+
+	static float cosDeg(float degrees) {
+		return _table[((int)(degrees * TABLE_PER_DEGREE) + TABLE_SIZE / 4) & TABLE_MASK];
+	}
+private:
+	static const int TABLE_SIZE = 1 << 14;
+	static const int TABLE_MASK = TABLE_SIZE - 1;
+	static constexpr float TABLE_PER_DEGREE = TABLE_SIZE / 360.0f;
+	static float _table[TABLE_SIZE];
+	static const bool _tableReady;
+
+	static bool initTable();
+};
+
+struct ParticleColor {
+	uint8_t r, g, b, a;
+};
+
+/** A particle's random draws for one value, stored as 16-bit fractions of its low and high ranges. */
+struct ParticleRange {
+	uint16_t low, high;
+
+	void randomize() {
+		low = (uint16_t)(ParticleRandom::next() >> 16);
+		high = (uint16_t)(ParticleRandom::next() >> 16);
+	}
+};
+
+class ParticleValue {
+public:
+	friend class ParticleSimulation;
+	friend class ParticleEffectBinary;
+
+	ParticleValue() : active(false), alwaysActive(false){}
+
+	virtual void setAlwaysActive(bool alwaysActive) {
+		this->alwaysActive = alwaysActive;
+	}
+
+	virtual bool isAlwaysActive() {
+		return alwaysActive;
+	}
+
+	virtual bool isActive() {
+		return alwaysActive || active;
+	}
+
+	virtual void setActive(bool active) {
+		this->active = active;
+	}
+
+	virtual ostream& save(ostream& output);
+
+	virtual void load(istream& reader);
+
+	virtual void load(ParticleTextReader& reader);
+
+	virtual void load(ParticleValue& value);
+protected:
+	bool active;
+	bool alwaysActive;
+};
+
+class NumericValue :public ParticleValue {
+public:
+	friend class ParticleSimulation;
+	friend class ParticleEffectBinary;
+
+	NumericValue() :value(0){}
+
+	virtual float getValue() {
+		return value;
+	}
+
+	virtual void setValue(float value) {
+		this->value = value;
+	}
+
+	virtual ostream& save(ostream& output);
+
+	virtual void load(istream& reader);
+
+	virtual void load(ParticleTextReader& reader);
+
+	virtual void load(NumericValue& value);
+private:
+	float value;
+};
+
+class RangedNumericValue :public ParticleValue {
+public:
+	friend class ParticleSimulation;
+	friend class ParticleEffectBinary;
+
+	RangedNumericValue() :lowMin(0), lowMax(0){}
+
+	virtual float newLowValue() {
+		return lowMin <= lowMax ? ParticleRandom::random(lowMin, lowMax) : ParticleRandom::random(lowMax, lowMin);
+	}
+
+	virtual void setLow(float value) {
+		lowMin = value;
+		lowMax = value;
+	}
+
+	virtual void setLow(float min, float max) {
+		lowMin = min;
+		lowMax = max;
+	}
+
+	/** Same distribution as newLowValue(), driven by a stored random fraction. */
+	float getLowValue(uint16_t fraction) {
+		return lowMin + (lowMax - lowMin) * (fraction / 65535.0f);
+	}
+
+	virtual float getLowMin() {
+		return lowMin;
+	}
+
+	virtual void setLowMin(float lowMin) {
+		this->lowMin = lowMin;
+	}
+
+	virtual float getLowMax() {
+		return lowMax;
+	}
+
+	virtual void setLowMax(float lowMax) {
+		this->lowMax = lowMax;
+	}
+
+	virtual ostream& save(ostream& output);
+
+	virtual void load(istream& reader);
+
+	virtual void load(ParticleTextReader& reader);
+
+	virtual void load(RangedNumericValue& value);
+private:
+	float lowMin, lowMax;
+};
+
+class ScaledNumericValue :public RangedNumericValue {
+public:
+	friend class ParticleSimulation;
+	friend class ParticleEffectBinary;
+
+	ScaledNumericValue() :highMin(0), highMax(0), relative(false){}
+
+	virtual float newHighValue() {
+		return highMin <= highMax ? ParticleRandom::random(highMin, highMax) : ParticleRandom::random(highMax, highMin);
+	}
+
+	virtual void setHigh(float value) {
+		highMin = value;
+		highMax = value;
+	}
+
+	virtual void setHigh(float min, float max) {
+		highMin = min;
+		highMax = max;
+	}
+
+	/** Same distribution as newHighValue(), driven by a stored random fraction. */
+	float getHighValue(uint16_t fraction) {
+		return highMin + (highMax - highMin) * (fraction / 65535.0f);
+	}
+
+	/** Returns low + diff * getScale(percent) for the particle's stored draws. */
+	float getValue(const ParticleRange& range, float percent) {
+		float low = getLowValue(range.low);
+		float diff = getHighValue(range.high);
+		if (!relative) diff -= low;
+		return low + diff * getScale(percent);
+	}
+
+	virtual float getHighMin() {
+		return highMin;
+	}
+
+	virtual void setHighMin(float highMin) {
+		this->highMin = highMin;
+	}
+
+	virtual float getHighMax() {
+		return highMax;
+	}
+
+	virtual void setHighMax(float highMax) {
+		this->highMax = highMax;
+	}
+
+	virtual float_array getScaling() {
+		return float_array(scalingData(), scalingData() + scalingCount());
+	}
+
+	virtual void setScaling(float_array values) {
+		this->scaling = values;
+		mappedScaling = nullptr;
+	}
+
+	virtual float_array getTimeline() {
+		return float_array(timelineData(), timelineData() + timelineCount());
+	}
+
+	virtual void setTimeline(float_array timeline) {
+		this->timeline = timeline;
+		mappedTimeline = nullptr;
+	}
+
+	/** Points the curves at arrays inside a mapped binary effect file instead of owned vectors. */
+	void mapCurves(const float* scaling, int scalingCount, const float* timeline, int timelineCount);
+
+	virtual bool isRelative() {
+		return relative;
+	}
+
+	virtual void setRelative(bool relative) {
+		this->relative = relative;
+	}
+
+	virtual float getScale(float percent);
+
+	/** Returns the heap bytes held by the scaling and timeline curves. */
+	size_t getCurveSize() const {
+		return (scaling.capacity() + timeline.capacity()) * sizeof(float);
+	}
+
+	virtual ostream& save(ostream& output);
+
+	virtual void load(istream& reader);
+
+	virtual void load(ParticleTextReader& reader);
+
+	virtual void load(ScaledNumericValue& value);
+private:
+	float_array scaling = float_array{ 1.0f };
+	float_array timeline = float_array{ 0.0f };
+	/** Set when a curve lives in a mapped binary effect file rather than in the vector above. */
+	const float* mappedScaling = nullptr;
+	const float* mappedTimeline = nullptr;
+	int mappedScalingCount = 0, mappedTimelineCount = 0;
+	float highMin, highMax;
+	bool relative;
+
+	const float* scalingData() const {
+		return mappedScaling ? mappedScaling : scaling.data();
+	}
+
+	int scalingCount() const {
+		return mappedScaling ? mappedScalingCount : (int)scaling.size();
+	}
+
+	const float* timelineData() const {
+		return mappedTimeline ? mappedTimeline : timeline.data();
+	}
+
+	int timelineCount() const {
+		return mappedTimeline ? mappedTimelineCount : (int)timeline.size();
+	}
+};
+
+class GradientColorValue :public ParticleValue {
+public:
+	friend class ParticleSimulation;
+	friend class ParticleEffectBinary;
+	GradientColorValue(){
+		alwaysActive = true;
+	}
+
+	float_array getTimeline() {
+		return float_array(timelineData(), timelineData() + timelineCount());
+	}
+
+	virtual void setTimeline(float_array timeline) {
+		this->timeline = timeline;
+		mappedTimeline = nullptr;
+	}
+
+	/** @return the r, g and b values for every timeline position */
+	virtual float_array& getColors() {
+		if (mappedColors) {
+			colors.assign(mappedColors, mappedColors + mappedColorsCount);
+			mappedColors = nullptr;
+		}
+		return colors;
+	}
+
+	/** @param colors the r, g and b values for every timeline position */
+	virtual void setColors(float_array colors) {
+		this->colors = colors;
+		mappedColors = nullptr;
+	}
+
+	/** Points the curves at arrays inside a mapped binary effect file instead of owned vectors. */
+	void mapCurves(const float* colors, int colorsCount, const float* timeline, int timelineCount);
+
+	virtual float_array& getColor(float percent);
+
+	/** Returns the heap bytes held by the colors and timeline curves. */
+	size_t getCurveSize() const {
+		return (colors.capacity() + timeline.capacity()) * sizeof(float);
+	}
+
+	virtual ostream& save(ostream& output);
+
+	virtual void load(istream& reader);
+
+	virtual void load(ParticleTextReader& reader);
+
+	virtual void load(GradientColorValue& value);
+private:
+	static float_array temp;
+
+	float_array colors = float_array{ 1.0f, 1.0f, 1.0f };
+	float_array timeline = float_array{ 0.0f };
+	/** Set when a curve lives in a mapped binary effect file rather than in the vector above. */
+	const float* mappedColors = nullptr;
+	const float* mappedTimeline = nullptr;
+	int mappedColorsCount = 0, mappedTimelineCount = 0;
+
+	const float* colorsData() const {
+		return mappedColors ? mappedColors : colors.data();
+	}
+
+	int colorsCount() const {
+		return mappedColors ? mappedColorsCount : (int)colors.size();
+	}
+
+	const float* timelineData() const {
+		return mappedTimeline ? mappedTimeline : timeline.data();
+	}
+
+	int timelineCount() const {
+		return mappedTimeline ? mappedTimelineCount : (int)timeline.size();
+	}
+};
+
+enum SpawnShape {
+	point, line, square, ellipse
+};
+
+static std::map<string, SpawnShape> SpawnShapeMap{
+	{ "point", point }, { "line", line }, { "square", square }, { "ellipse", ellipse }
+};
+
+enum SpawnEllipseSide {
+	both, top, bottom
+};
+
+static std::map<string, SpawnEllipseSide> SpawnEllipseSideMap{
+	{ "both", both }, { "top", top }, { "bottom", bottom }
+};
+
+class SpawnShapeValue : public ParticleValue {
+public:
+	friend class ParticleSimulation;
+	friend class ParticleEffectBinary;
+
+	SpawnShapeValue() :edges(false){}
+
+	SpawnShape getShape() {
+		return shape;
+	}
+
+	void setShape(SpawnShape shape) {
+		this->shape = shape;
+	}
+
+	bool isEdges() {
+		return edges;
+	}
+
+	void setEdges(bool edges) {
+		this->edges = edges;
+	}
+
+	virtual SpawnEllipseSide getSide() {
+		return side;
+	}
+
+	virtual void setSide(SpawnEllipseSide side) {
+		this->side = side;
+	}
+
+	virtual ostream& save(ostream& output);
+
+	virtual void load(istream& reader);
+
+	virtual void load(ParticleTextReader& reader);
+
+	virtual void load(SpawnShapeValue& value);
+
+protected:
+	SpawnShape shape = SpawnShape::point;
+	bool edges;
+	SpawnEllipseSide side = SpawnEllipseSide::both;
+};
+
+/** Emitter data as loaded from an effect file: the values, counts and options a simulation runs from. */
+class ParticleDefinition {
+public:
+	friend class ParticleSimulation;
+	friend class ParticleEmitter;
+	friend class ParticleEffectBinary;
+
+	ParticleDefinition();
+
+	virtual ~ParticleDefinition(){}
+
+	const string& getName() const {
+		return name;
+	}
+
+	const string& getImagePath() const {
+		return imagePath;
+	}
+
+	int getMinParticleCount() const {
+		return minParticleCount;
+	}
+
+	int getMaxParticleCount() const {
+		return maxParticleCount;
+	}
+
+	/** Returns the bytes held by this definition, including its curves. */
+	size_t getMemorySize() const {
+		return getMemoryUsage().total();
+	}
+
+	/** Returns the bytes held by this definition as state and curves. */
+	virtual ParticleMemoryUsage getMemoryUsage() const;
+
+	virtual ostream& save(ostream& output);
+
+	/** Writes the curves of this definition with the given counts and options in place of its own, as an emitter
+	* that overrides them would be loaded back. */
+	ostream& save(ostream& output, int minParticleCount, int maxParticleCount, bool attached, bool continuous,
+		bool aligned, bool additive, bool behind, bool premultipliedAlpha);
+
+	virtual void load(istream& reader);
+
+	/** Fast path for the text format. Returns false if the text strays from the format as saved. */
+	virtual bool load(ParticleTextReader& reader);
+
+	/** Copies definition; curves mapped from a file are shared, not copied. */
+	void load(ParticleDefinition& definition);
+private:
+	RangedNumericValue delayValue;
+	ScaledNumericValue lifeOffsetValue;
+	RangedNumericValue durationValue;
+	ScaledNumericValue lifeValue;
+	ScaledNumericValue emissionValue;
+	ScaledNumericValue scaleValue;
+	ScaledNumericValue rotationValue;
+	ScaledNumericValue velocityValue;
+	ScaledNumericValue angleValue;
+	ScaledNumericValue windValue;
+	ScaledNumericValue gravityValue;
+	ScaledNumericValue transparencyValue;
+	GradientColorValue tintValue;
+	ScaledNumericValue xOffsetValue;
+	ScaledNumericValue yOffsetValue;
+	ScaledNumericValue spawnWidthValue;
+	ScaledNumericValue spawnHeightValue;
+	SpawnShapeValue spawnShapeValue;
+
+	string name;
+	string imagePath;
+	int minParticleCount, maxParticleCount;
+	bool attached;
+	bool continuous;
+	bool aligned;
+	bool additive;
+	bool behind;
+	bool premultipliedAlpha;
+};
+
+/** Plain particle record, 64 bytes, no vtable and no heap storage, so simulations keep particles in one
+* contiguous block that can be zeroed, copied and reallocated in bulk. Random draws are kept as
+* fractions and expanded through the definition's values when needed. */
+struct Particle {
+	float x, y;
+	float scale, rotation;
+	/** Spawn angle in degrees, used when the angle has no timeline. */
+	float angle;
+	int life, currentLife;
+	ParticleColor color;
+	uint8_t tint[3];
+
+	ParticleRange scaleRange;
+	ParticleRange rotationRange;
+	ParticleRange velocityRange;
+	ParticleRange transparencyRange;
+	ParticleRange windRange;
+	ParticleRange gravityRange;
+	union {
+		/** Random draws of the angle, when it has a timeline (UPDATE_ANGLE). */
+		ParticleRange angleRange;
+		/** Cosine and sine of the fixed angle as signed 16-bit fractions, otherwise. */
+		int16_t direction[2];
+	};
+};
+
+static_assert(std::is_trivially_copyable<Particle>::value, "Particle must stay trivially copyable");
+static_assert(sizeof(Particle) <= 64, "Particle must fit in 64 bytes");
+
+class ParticleAffector;
+
+/** Runs the particles of one emitter from a definition: emission, spawning and integration, in the space of
+* its origin. Like the rest of this header it needs the standard library only, so it runs without cocos2d or
+* a GL context, e.g. in tests or on a server; ParticleEmitter adapts it to the scene graph and the renderer. */
+class ParticleSimulation {
+public:
+	static const int UPDATE_SCALE = 1 << 0;
+	static const int UPDATE_ANGLE = 1 << 1;
+	static const int UPDATE_ROTATION = 1 << 2;
+	static const int UPDATE_VELOCITY = 1 << 3;
+	static const int UPDATE_WIND = 1 << 4;
+	static const int UPDATE_GRAVITY = 1 << 5;
+	static const int UPDATE_TINT = 1 << 6;
+
+	static const int EVENT_BIRTH = 1 << 0;
+	static const int EVENT_DEATH = 1 << 1;
+
+	/** Where a particle was born or died, in the space particles spawn in. */
+	struct ParticleEvent {
+		int type;
+		float x, y;
+	};
+
+	/** Adjustments applied to the particles of one burst, see burst(). */
+	struct BurstParams {
+		/** Degrees added to each particle's direction, when the angle has no timeline. */
+		float angle;
+		/** Scale of each particle's life. */
+		float lifeScale;
+
+		BurstParams() : angle(0), lifeScale(1) {}
+	};
+
+	float duration = 1, durationTimer = 0;
+
+	ParticleSimulation();
+
+	virtual ~ParticleSimulation();
+
+	/** Runs from the given definition, which must outlive this simulation, and resets the counts and options
+	* to it. */
+	void setDefinition(ParticleDefinition* definition);
+
+	const ParticleDefinition* getDefinition() const {
+		return _definition;
+	}
+
+	virtual void setMaxParticleCount(int maxParticleCount);
+
+	void addParticle();
+
+	void addParticles(int count);
+
+	/** Advances emission and the particles. Returns false when less than a millisecond has accumulated. */
+	bool step(float delta);
+
+	void start();
+
+	void reset();
+
+	void restart();
+
+	void setPosition(float x, float y);
+
+	void translate(float x, float y);
+
+	/** Ignores the {@link #setContinuous(boolean) continuous} setting until the emitter is started again. This allows the emitter
+	* to stop smoothly. */
+	void allowCompletion() {
+		this->_allowCompletion = true;
+		durationTimer = duration;
+	}
+
+	void activateParticle(int index) {
+		float x, y;
+		getSpawnPosition(x, y);
+		activateParticle(index, x, y);
+	}
+
+	/** Spawns the particle at index around the given origin instead of the spawn position. */
+	void activateParticle(int index, float originX, float originY);
+
+	bool updateParticle(Particle* particle, float delta, int deltaMillis);
+
+	/** Sets the sprite size particles are scaled against, the size of their image when drawn. */
+	void setParticleSize(float width, float height) {
+		_spriteWidth = width;
+		_spriteHeight = height;
+	}
+
+	bool isAttached() {
+		return attached;
+	}
+
+	void setAttached(bool attached) {
+		this->attached = attached;
+	}
+
+	bool isContinuous() {
+		return continuous;
+	}
+
+	void setContinuous(bool continuous) {
+		this->continuous = continuous;
+	}
+
+	bool isAligned() {
+		return aligned;
+	}
+
+	void setAligned(bool aligned) {
+		this->aligned = aligned;
+	}
+
+	bool isAdditive() {
+		return additive;
+	}
+
+	void setAdditive(bool additive) {
+		this->additive = additive;
+	}
+
+	bool isBehind() {
+		return behind;
+	}
+
+	void setBehind(bool behind) {
+		this->behind = behind;
+	}
+
+	bool isPremultipliedAlpha() {
+		return premultipliedAlpha;
+	}
+
+	void setPremultipliedAlpha(bool premultipliedAlpha) {
+		this->premultipliedAlpha = premultipliedAlpha;
+	}
+
+	int getMinParticleCount() {
+		return minParticleCount;
+	}
+
+	void setMinParticleCount(int minParticleCount) {
+		this->minParticleCount = minParticleCount;
+	}
+
+	int getMaxParticleCount() {
+		return maxParticleCount;
+	}
+
+	bool isComplete();
+
+	float getPercentComplete();
+
+	int getActiveCount() {
+		return activeCount;
+	}
+
+	/** Active particles are those with active[i] set, among the first getMaxParticleCount(). */
+	const Particle* getParticles() const {
+		return particles;
+	}
+
+	const bool* getActiveFlags() const {
+		return active;
+	}
+
+	/** Where stored particle positions are relative to, see setPosition(). */
+	float getOriginX() const {
+		return _originX;
+	}
+
+	float getOriginY() const {
+		return _originY;
+	}
+
+	/** Scales the emission rate and the particle limit, 1 for the authored values. Set by the particle budget.
+	* Clamped to [0, 1]: the particle arrays only hold maxParticleCount. */
+	void setThrottle(float throttle) {
+		_throttle = std::min(std::max(throttle, 0.0f), 1.0f);
+	}
+
+	float getThrottle() const {
+		return _throttle;
+	}
+
+	/** Switches off per-particle updates given as UPDATE_ flags, e.g. UPDATE_ROTATION | UPDATE_TINT for a cheap
+	* level of detail. The definition is not changed. */
+	void setDisabledUpdates(int flags);
+
+	int getDisabledUpdates() const {
+		return _disabledUpdates;
+	}
+
+	/** Records each particle's motion during step(), which extrapolating needs. */
+	void setMotionTracking(bool enabled);
+
+	/** Turns the emitter's own emission on or off. Off, it only moves the particles it has, which makes it a
+	* host for burst() that never completes on its own. */
+	void setEmitting(bool emitting) {
+		_emitting = emitting;
+	}
+
+	bool isEmitting() const {
+		return _emitting;
+	}
+
+	/** Spawns up to count particles at once around x, y in this emitter's space, as if it were there. Particles
+	* keep the origin they spawned at, so one emitter can serve many short-lived impacts with a single update
+	* and draw. The count is capped by the particle limit. */
+	void burst(float x, float y, int count, const BurstParams& params = BurstParams());
+
+	/** The count emission stops at: maxParticleCount scaled by the throttle. Particles above it live out their life. */
+	int getParticleLimit() const {
+		return std::min((int)std::ceil(maxParticleCount * _throttle), maxParticleCount);
+	}
+
+	/** Adds a force field or collider, see ParticleAffector. Particles keep the velocity affectors give them
+	* until they die. */
+	void addAffector(ParticleAffector* affector);
+
+	void removeAffector(ParticleAffector* affector);
+
+	const std::vector<ParticleAffector*>& getAffectors() const {
+		return _affectors;
+	}
+
+	/** Records the births and deaths given as EVENT_ flags until they are cleared, e.g. to start sub-emitters
+	* where they happen. */
+	void setRecordedEvents(int events) {
+		_recordedEvents = events;
+	}
+
+	int getRecordedEvents() const {
+		return _recordedEvents;
+	}
+
+	const std::vector<ParticleEvent>& getEvents() const {
+		return _events;
+	}
+
+	void clearEvents() {
+		_events.clear();
+	}
+
+	/** Returns the bytes held by the particles and their motion. */
+	size_t getParticleMemorySize() const;
+
+	/** Returns the bytes held by this simulation as state and particles. The definition is not included. */
+	virtual ParticleMemoryUsage getMemoryUsage() const;
+
+	/** Returns this emitter's counters. Frame counts stay zero unless PARTICLE_STATS_ENABLED. */
+	const ParticleStats& getStats() {
+		_stats.activeCount = activeCount;
+		return _stats;
+	}
+protected:
+	ParticleDefinition* _definition;
+
+	float accumulator;
+	float _throttle;
+	bool _emitting;
+	float _spriteWidth, _spriteHeight;
+	Particle* particles;
+	int minParticleCount, maxParticleCount;
+	float dx, dy;
+	/** Where stored particle positions are relative to. Moving an unattached emitter shifts this origin
+	* the other way instead of every particle; quads add it back. */
+	float _originX, _originY;
+	int activeCount;
+	bool* active;
+	bool firstUpdate;
+	int updateFlags;
+	bool _allowCompletion;
+
+	int emission, emissionDiff, emissionDelta;
+	int lifeOffset, lifeOffsetDiff;
+	int life, lifeDiff;
+	float spawnWidth, spawnWidthDiff;
+	float spawnHeight, spawnHeightDiff;
+
+	float delay, delayTimer;
+
+	bool attached;
+	bool continuous;
+	bool aligned;
+	bool behind;
+	bool additive = true;
+	bool premultipliedAlpha = false;
+
+	float* _motion;                     // x and y velocity per particle over the last step, when tracked
+	int _disabledUpdates;               // UPDATE_ flags switched off regardless of the definition
+	std::vector<ParticleAffector*> _affectors;
+	float* _velocities;                 // x and y velocity per particle from affectors, while there are any
+	int _recordedEvents;                // EVENT_ flags
+	std::vector<ParticleEvent> _events;
+	ParticleStats _stats;
+
+	/** Where activateParticle(int) spawns, in the space particles are stored in before the origin is taken
+	* off. The origin's starting point, 0, 0, by default. */
+	virtual void getSpawnPosition(float& x, float& y) {
+		x = y = 0;
+	}
+
+	/** Shifts the particle origin by x, y, moving every particle at once. */
+	void moveOrigin(float x, float y);
+
+	/** Runs the affectors over the particles: forces, then movement by the velocities, then colliders. */
+	void applyAffectors(float delta);
+
+	void recordEvent(int type, const Particle* particle) {
+		ParticleEvent event = { type, particle->x + _spriteWidth / 2 + _originX, particle->y + _spriteHeight / 2 + _originY };
+		_events.push_back(event);
+	}
+
+	/** The UPDATE_ flags the definition calls for. */
+	int getDefinitionUpdateFlags();
+};
+
+static string readString(string line);
+
+static string readString(istream& reader, string name);
+
+static bool readBoolean(string line);
+
+static bool readBoolean(istream& reader, string name);
+
+static int readInt(istream& reader, string name);
+
+static float readFloat(istream& reader, string name);
+
+/** Reads the text effect format in place from a file buffer, checking each key and parsing numbers without
+* allocating. Any mismatch marks the reader as failed and later reads return defaults. */
+class ParticleTextReader{
+public:
+	ParticleTextReader(const char* data, size_t size) :_current(data), _end(data + size), _failed(false){}
+
+	bool hasFailed() const {
+		return _failed;
+	}
+
+	/** Skips a line such as a section title. Returns false if the data ended before a line break. */
+	bool skipLine();
+
+	/** Returns the next line with surrounding whitespace removed. */
+	string readLine();
+
+	/** Whether the next line has the given key. Consumes nothing. */
+	bool hasKey(const char* key) const;
+
+	string readString(const char* key);
+
+	bool readBoolean(const char* key);
+
+	int readInt(const char* key);
+
+	/** Reads the length of the list that follows, failing if that many lines cannot fit in the data left. */
+	int readCount(const char* key);
+
+	/** A non-negative index reads an indexed key such as "scaling3". */
+	float readFloat(const char* key, int index = -1);
+private:
+	/** Consumes the next line, which must be "key: value", and returns the bounds of the trimmed value. */
+	bool readValue(const char* key, int index, const char*& begin, const char*& end);
+
+	static bool matchKey(const char* begin, const char* end, const char* key, int index);
+
+	static bool parseInt(const char* begin, const char* end, int& value);
+
+	static bool parseFloat(const char* begin, const char* end, float& value);
+
+	const char* _current;
+	const char* _end;
+	bool _failed;
+};
+
+NS_CUSTOM_END
+
+#endif
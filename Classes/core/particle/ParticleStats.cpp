@@ -0,0 +1,73 @@
+#include "ParticleStats.h"
+
+USING_NS_CUSTOM;
+
+void NS_CUSTOM::ParticleStats::reset()
+{
+	frame = 0;
+	spawned = killed = 0;
+	updateTime = quadTime = 0;
+	uploadedBytes = 0;
+	drawCalls = 0;
+	activeCount = activeHighWater = 0;
+	parseTime = imageTime = 0;
+}
+
+void NS_CUSTOM::ParticleMemoryUsage::reset()
+{
+	state = particles = quads = indices = 0;
+	curves = glBuffers = textures = cachePrototypes = bakedLoops = 0;
+}
+
+size_t NS_CUSTOM::ParticleMemoryUsage::total() const
+{
+	return state + particles + quads + indices + curves + glBuffers + textures + cachePrototypes + bakedLoops;
+}
+
+void NS_CUSTOM::ParticleMemoryUsage::add(const ParticleMemoryUsage& other)
+{
+	state += other.state;
+	particles += other.particles;
+	quads += other.quads;
+	indices += other.indices;
+	curves += other.curves;
+	glBuffers += other.glBuffers;
+	textures += other.textures;
+	cachePrototypes += other.cachePrototypes;
+	bakedLoops += other.bakedLoops;
+}
+
+void NS_CUSTOM::ParticleStats::beginFrame(unsigned int frame)
+{
+	if (frame == this->frame) return;
+	this->frame = frame;
+	spawned = killed = 0;
+	updateTime = quadTime = 0;
+	uploadedBytes = 0;
+	drawCalls = 0;
+}
+
+void NS_CUSTOM::ParticleStats::add(const ParticleStats& other)
+{
+	if (other.frame > frame){
+		frame = other.frame;
+		spawned = other.spawned;
+		killed = other.killed;
+		updateTime = other.updateTime;
+		quadTime = other.quadTime;
+		uploadedBytes = other.uploadedBytes;
+		drawCalls = other.drawCalls;
+	}
+	else if (other.frame == frame){
+		spawned += other.spawned;
+		killed += other.killed;
+		updateTime += other.updateTime;
+		quadTime += other.quadTime;
+		uploadedBytes += other.uploadedBytes;
+		drawCalls += other.drawCalls;
+	}
+	activeCount += other.activeCount;
+	activeHighWater += other.activeHighWater;
+	parseTime += other.parseTime;
+	imageTime += other.imageTime;
+}
@@ -0,0 +1,103 @@
+#ifndef __PARTICLE_STATS_H__
+#define __PARTICLE_STATS_H__
+
+#include <chrono>
+#include "core/util/GameDefine.h"
+
+/** Per-frame counters cost a clock read per update and are compiled in only when PARTICLE_STATS_ENABLED is
+* non-zero, by default in debug builds. Load times are always recorded. */
+#ifndef PARTICLE_STATS_ENABLED
+#if defined(COCOS2D_DEBUG) && COCOS2D_DEBUG > 0
+#define PARTICLE_STATS_ENABLED 1
+#else
+#define PARTICLE_STATS_ENABLED 0
+#endif
+#endif
+
+#if PARTICLE_STATS_ENABLED
+#define PARTICLE_STATS(statement) statement
+/** Adds the milliseconds until the end of the enclosing scope to field. */
+#define PARTICLE_STATS_TIMER(field) NS_CUSTOM::ParticleStatsTimer particleStatsTimer(field)
+#else
+#define PARTICLE_STATS(statement)
+#define PARTICLE_STATS_TIMER(field)
+#endif
+
+NS_CUSTOM_BEGIN
+
+/** Counters of one emitter, or rolled up over an effect or every running effect. Frame counts cover the
+* last frame the emitter ran or drew in. Times are in milliseconds. */
+struct ParticleStats{
+	unsigned int frame;
+	int spawned;
+	int killed;
+	float updateTime;
+	float quadTime;
+	size_t uploadedBytes;
+	int drawCalls;
+
+	int activeCount;
+	int activeHighWater;
+	float parseTime;
+	float imageTime;
+
+	ParticleStats(){
+		reset();
+	}
+
+	void reset();
+
+	/** Zeroes the frame counts when frame is newer than the one they belong to. */
+	void beginFrame(unsigned int frame);
+
+	/** Adds other's counts. Frame counts older than this frame's are left out, newer ones replace them. */
+	void add(const ParticleStats& other);
+};
+
+/** Bytes held by particle effects, by what holds them. */
+struct ParticleMemoryUsage{
+	/** The effect, emitter and definition objects themselves. */
+	size_t state;
+	/** Particle, active flag and motion arrays, sized by the particle limit. */
+	size_t particles;
+	/** Quads built on the CPU, sized by the largest particle limit the emitter had. */
+	size_t quads;
+	/** The quad index buffer all emitters share. */
+	size_t indices;
+	/** Timeline, scaling and color points of the definitions' values. */
+	size_t curves;
+	/** Vertex buffers held by emitters or parked in the buffer pool. */
+	size_t glBuffers;
+	size_t textures;
+	/** Everything but curves and textures of the prototypes in the ParticleEffectCache. */
+	size_t cachePrototypes;
+	/** Compressed frames of baked loops, shared by every emitter playing them. */
+	size_t bakedLoops;
+
+	ParticleMemoryUsage(){
+		reset();
+	}
+
+	void reset();
+
+	size_t total() const;
+
+	void add(const ParticleMemoryUsage& other);
+};
+
+class ParticleStatsTimer{
+public:
+	explicit ParticleStatsTimer(float& target) :_target(target), _start(std::chrono::steady_clock::now()){}
+
+	~ParticleStatsTimer(){
+		std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - _start;
+		_target += elapsed.count();
+	}
+private:
+	float& _target;
+	std::chrono::steady_clock::time_point _start;
+};
+
+NS_CUSTOM_END
+
+#endif
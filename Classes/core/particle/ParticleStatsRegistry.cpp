@@ -0,0 +1,125 @@
+#include "ParticleStatsRegistry.h"
+#include "ParticleEffect.h"
+#include "ParticleSystemManager.h"
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+
+USING_NS_CUSTOM;
+
+ParticleStatsRegistry* NS_CUSTOM::ParticleStatsRegistry::_instance = nullptr;
+
+ParticleStatsRegistry* NS_CUSTOM::ParticleStatsRegistry::getInstance()
+{
+	if (!_instance){
+		_instance = new ParticleStatsRegistry();
+	}
+	return _instance;
+}
+
+void NS_CUSTOM::ParticleStatsRegistry::addParseTime(float milliseconds)
+{
+	_loadCount++;
+	_parseTime += milliseconds;
+}
+
+void NS_CUSTOM::ParticleStatsRegistry::addImageTime(float milliseconds)
+{
+	_imageTime += milliseconds;
+}
+
+void NS_CUSTOM::ParticleStatsRegistry::resetLoads()
+{
+	_loadCount = 0;
+	_parseTime = _imageTime = 0;
+}
+
+ParticleStatsRegistry::Snapshot NS_CUSTOM::ParticleStatsRegistry::snapshot()
+{
+	Snapshot snapshot;
+	for (auto effect : ParticleSystemManager::getInstance()->getEffects()){
+		if (!effect) continue;
+		EffectStats entry = { effect->getCacheName(), effect->getStats() };
+		snapshot.effects.push_back(entry);
+	}
+	// Only the latest frame counts: effects that did not run in it roll up as idle.
+	for (auto& entry : snapshot.effects)
+		snapshot.total.beginFrame(std::max(snapshot.total.frame, entry.stats.frame));
+	for (auto& entry : snapshot.effects){
+		if (entry.stats.frame != snapshot.total.frame) entry.stats.beginFrame(snapshot.total.frame);
+		snapshot.total.add(entry.stats);
+	}
+	std::stable_sort(snapshot.effects.begin(), snapshot.effects.end(), [](const EffectStats& a, const EffectStats& b){
+		return a.stats.updateTime + a.stats.quadTime > b.stats.updateTime + b.stats.quadTime;
+	});
+	// Instances report the load of the prototype they were copied from; the totals count each load once.
+	snapshot.total.parseTime = _parseTime;
+	snapshot.total.imageTime = _imageTime;
+	snapshot.loadCount = _loadCount;
+	return snapshot;
+}
+
+static void writeText(std::ostream& output, const ParticleStats& stats)
+{
+	output << "particles " << stats.activeCount << " (high " << stats.activeHighWater << ")"
+		<< ", spawned " << stats.spawned << ", killed " << stats.killed
+		<< ", update " << stats.updateTime << " ms, quads " << stats.quadTime << " ms"
+		<< ", uploaded " << stats.uploadedBytes << " B, draws " << stats.drawCalls;
+}
+
+string NS_CUSTOM::ParticleStatsRegistry::toText(const Snapshot& snapshot)
+{
+	std::ostringstream output;
+	output << std::fixed << std::setprecision(3);
+	output << "frame " << snapshot.total.frame << ", " << snapshot.effects.size() << " effects: ";
+	writeText(output, snapshot.total);
+	output << "\nloads " << snapshot.loadCount << ": parse " << snapshot.total.parseTime << " ms, images "
+		<< snapshot.total.imageTime << " ms\n";
+	for (auto& entry : snapshot.effects){
+		output << "  " << (entry.name.empty() ? "(unnamed)" : entry.name) << ": ";
+		writeText(output, entry.stats);
+		output << "\n";
+	}
+	return output.str();
+}
+
+static void writeJson(std::ostream& output, const ParticleStats& stats)
+{
+	output << "\"active\":" << stats.activeCount << ",\"activeHighWater\":" << stats.activeHighWater
+		<< ",\"spawned\":" << stats.spawned << ",\"killed\":" << stats.killed
+		<< ",\"updateMs\":" << stats.updateTime << ",\"quadMs\":" << stats.quadTime
+		<< ",\"uploadedBytes\":" << stats.uploadedBytes << ",\"drawCalls\":" << stats.drawCalls;
+}
+
+static void writeJsonString(std::ostream& output, const string& value)
+{
+	output << '"';
+	for (char c : value){
+		if (c == '"' || c == '\\') output << '\\' << c;
+		else if ((unsigned char)c < 0x20) output << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)c
+			<< std::dec << std::setfill(' ');
+		else output << c;
+	}
+	output << '"';
+}
+
+string NS_CUSTOM::ParticleStatsRegistry::toJson(const Snapshot& snapshot)
+{
+	std::ostringstream output;
+	output << std::fixed << std::setprecision(3);
+	output << "{\"frame\":" << snapshot.total.frame << ",\"total\":{";
+	writeJson(output, snapshot.total);
+	output << "},\"loads\":{\"count\":" << snapshot.loadCount << ",\"parseMs\":" << snapshot.total.parseTime
+		<< ",\"imageMs\":" << snapshot.total.imageTime << "},\"effects\":[";
+	for (size_t i = 0; i < snapshot.effects.size(); i++){
+		auto& entry = snapshot.effects[i];
+		if (i > 0) output << ',';
+		output << "{\"name\":";
+		writeJsonString(output, entry.name);
+		output << ',';
+		writeJson(output, entry.stats);
+		output << ",\"parseMs\":" << entry.stats.parseTime << ",\"imageMs\":" << entry.stats.imageTime << '}';
+	}
+	output << "]}";
+	return output.str();
+}
@@ -0,0 +1,61 @@
+#ifndef __PARTICLE_STATS_REGISTRY_H__
+#define __PARTICLE_STATS_REGISTRY_H__
+
+#include <string>
+#include <vector>
+#include "cocos2d.h"
+#include "ParticleStats.h"
+#include "core/util/GameDefine.h"
+
+USING_NS_CC;
+using std::string;
+
+NS_CUSTOM_BEGIN
+
+/** Rolls the counters of every effect the ParticleSystemManager runs up into one snapshot, and totals load
+* times across all effects loaded. */
+class ParticleStatsRegistry{
+public:
+	struct EffectStats{
+		string name;
+		ParticleStats stats;
+	};
+
+	struct Snapshot{
+		ParticleStats total;
+		/** Running effects, most expensive update first. */
+		std::vector<EffectStats> effects;
+		int loadCount;
+	};
+
+	ParticleStatsRegistry() :_loadCount(0), _parseTime(0), _imageTime(0){}
+	static ParticleStatsRegistry* getInstance();
+
+	/** The frame counters are attributed to. */
+	static unsigned int getFrame(){
+		return Director::getInstance()->getTotalFrames();
+	}
+
+	/** Records the parse of one effect file. */
+	void addParseTime(float milliseconds);
+
+	void addImageTime(float milliseconds);
+
+	Snapshot snapshot();
+
+	void resetLoads();
+
+	static string toText(const Snapshot& snapshot);
+
+	static string toJson(const Snapshot& snapshot);
+private:
+	static ParticleStatsRegistry* _instance;
+
+	int _loadCount;
+	float _parseTime;
+	float _imageTime;
+};
+
+NS_CUSTOM_END
+
+#endif
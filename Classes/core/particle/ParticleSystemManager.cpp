@@ -0,0 +1,183 @@
+#include "ParticleSystemManager.h"
+#include "ParticleEffect.h"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+
+USING_NS_CUSTOM;
+
+ParticleSystemManager* NS_CUSTOM::ParticleSystemManager::_instance = nullptr;
+
+NS_CUSTOM::ParticleSystemManager::~ParticleSystemManager()
+{
+	if (_scheduled) Director::getInstance()->getScheduler()->unschedule("ParticleSystemManager", this);
+	for (auto effect : _effects){
+		if (effect) effect->_managerIndex = -1;
+	}
+	if (this == _instance) _instance = nullptr;
+}
+
+ParticleSystemManager* NS_CUSTOM::ParticleSystemManager::getInstance()
+{
+	if (!_instance){
+		_instance = new ParticleSystemManager();
+	}
+	return _instance;
+}
+
+void NS_CUSTOM::ParticleSystemManager::add(ParticleEffect* effect)
+{
+	if (effect->_managerIndex >= 0) return;
+	effect->_managerIndex = (int)_effects.size();
+	effect->_pendingDelta = 0;
+	_effects.push_back(effect);
+	_dirty = true;
+	if (!_scheduled){
+		_scheduled = true;
+		Director::getInstance()->getScheduler()->schedule(std::bind(&ParticleSystemManager::update, this, std::placeholders::_1),
+			this, 0, false, "ParticleSystemManager");
+	}
+}
+
+void NS_CUSTOM::ParticleSystemManager::remove(ParticleEffect* effect)
+{
+	int index = effect->_managerIndex;
+	if (index < 0) return;
+	if (_updating){
+		_effects[index] = nullptr;
+		_holes++;
+	}
+	else {
+		// Move the last effect into the slot; the next update regroups.
+		if (index != (int)_effects.size() - 1){
+			auto last = _effects.back();
+			_effects[index] = last;
+			last->_managerIndex = index;
+		}
+		_effects.pop_back();
+		_dirty = true;
+	}
+	effect->_managerIndex = -1;
+}
+
+void NS_CUSTOM::ParticleSystemManager::update(float delta)
+{
+	PARTICLE_TRACE("ParticleSystemManager::update");
+	auto startTime = std::chrono::steady_clock::now();
+	if (_dirty) compact();
+	_updating = true;
+	// Effects started during the update join from the next frame, as with scheduleUpdate.
+	size_t count = _effects.size();
+	bool amortized = _amortizedBudget > 0;
+	for (size_t i = 0; i < count; i++){
+		auto effect = _effects[i];
+		if (!isUpdatable(effect)) continue;
+		if (amortized && effect->_priority < _amortizedPriority){
+			effect->_pendingDelta += delta;
+			continue;
+		}
+		effect->update(delta);
+	}
+	_deferredCount = 0;
+	if (amortized) updateDeferred(std::chrono::steady_clock::now());
+	_updating = false;
+	if (_holes > 0) compact();
+	applyBudget(delta);
+	std::chrono::duration<float, std::milli> updateTime = std::chrono::steady_clock::now() - startTime;
+	_updateTime = updateTime.count();
+}
+
+bool NS_CUSTOM::ParticleSystemManager::isUpdatable(ParticleEffect* effect) const
+{
+	return effect && effect->isRunning() && !effect->_paused;
+}
+
+void NS_CUSTOM::ParticleSystemManager::updateDeferred(std::chrono::steady_clock::time_point startTime)
+{
+	size_t count = _effects.size();
+	if (_cursor >= count) _cursor = 0;
+	size_t i = _cursor;
+	bool first = true, exhausted = false;
+	for (size_t visited = 0; visited < count; visited++, i = (i + 1) % count){
+		auto effect = _effects[i];
+		if (!isUpdatable(effect) || effect->_pendingDelta <= 0) continue;
+		// At least one effect moves each frame, however small the budget.
+		if (!first && !exhausted){
+			std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+			exhausted = elapsed.count() >= _amortizedBudget;
+		}
+		if (exhausted){
+			_deferredCount++;
+			continue;
+		}
+		first = false;
+		float pendingDelta = effect->_pendingDelta;
+		effect->_pendingDelta = 0;
+		effect->update(pendingDelta);
+		_cursor = (i + 1) % count;
+	}
+}
+
+void NS_CUSTOM::ParticleSystemManager::applyBudget(float delta)
+{
+	// Throttles drop quickly when over budget and recover slowly, per second.
+	static const float THROTTLE_DOWN_RATE = 2.0f;
+	static const float THROTTLE_UP_RATE = 0.5f;
+
+	_loads.clear();
+	float demand = 0;
+	int particleCount = 0;
+	for (auto effect : _effects){
+		int count = effect->getActiveCount();
+		particleCount += count;
+		// Throttled effects would have proportionally more particles at full emission.
+		Load load = { effect, count / std::max(effect->_throttle, 0.05f) };
+		demand += load.demand;
+		_loads.push_back(load);
+	}
+	int budget = _particleBudget;
+	if (_timeBudget > 0 && _particleCount > 0 && _updateTime > 0){
+		int timeBudget = std::max(1, (int)(_timeBudget * _particleCount / _updateTime));
+		budget = budget > 0 ? std::min(budget, timeBudget) : timeBudget;
+	}
+	_particleCount = particleCount;
+	if (budget <= 0 && _throttledCount == 0) return;
+
+	float excess = budget > 0 ? demand - budget : 0;
+	std::stable_sort(_loads.begin(), _loads.end(), [](const Load& a, const Load& b){
+		return a.effect->_priority < b.effect->_priority;
+	});
+	// Walk the priority levels from the lowest, throttling each just enough to cover what is left of the excess.
+	_throttledCount = 0;
+	for (size_t i = 0, j; i < _loads.size(); i = j){
+		float levelDemand = 0;
+		for (j = i; j < _loads.size() && _loads[j].effect->_priority == _loads[i].effect->_priority; j++)
+			levelDemand += _loads[j].demand;
+		float target = 1;
+		if (excess > 0 && levelDemand > 0){
+			target = std::max(_minimumThrottle, 1 - excess / levelDemand);
+			excess -= levelDemand * (1 - target);
+		}
+		for (size_t k = i; k < j; k++){
+			auto effect = _loads[k].effect;
+			float throttle = effect->_throttle;
+			if (target < throttle) throttle = std::max(target, throttle - THROTTLE_DOWN_RATE * delta);
+			else throttle = std::min(target, throttle + THROTTLE_UP_RATE * delta);
+			effect->setThrottle(throttle);
+			if (throttle < 1) _throttledCount++;
+		}
+	}
+}
+
+void NS_CUSTOM::ParticleSystemManager::compact()
+{
+	_effects.erase(std::remove(_effects.begin(), _effects.end(), nullptr), _effects.end());
+	_holes = 0;
+	// Instances of the same effect share their definitions; updating them back to back keeps those hot.
+	std::stable_sort(_effects.begin(), _effects.end(), [](ParticleEffect* a, ParticleEffect* b){
+		return std::less<const void*>()(a->getGroupKey(), b->getGroupKey());
+	});
+	for (size_t i = 0; i < _effects.size(); i++)
+		_effects[i]->_managerIndex = (int)i;
+	_dirty = false;
+}
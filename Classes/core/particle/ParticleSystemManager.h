@@ -0,0 +1,143 @@
+#ifndef __PARTICLE_SYSTEM_MANAGER_H__
+#define __PARTICLE_SYSTEM_MANAGER_H__
+
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include "cocos2d.h"
+#include "core/util/GameDefine.h"
+
+USING_NS_CC;
+
+NS_CUSTOM_BEGIN
+
+class ParticleEffect;
+
+/** Updates every started ParticleEffect from one scheduler entry. Effects are kept in a flat array, grouped
+* by the definitions they share so that consecutive updates touch the same curves. Effects are not retained;
+* they leave the array when they complete, are cleaned up or are destroyed. */
+class ParticleSystemManager{
+public:
+	ParticleSystemManager() : _holes(0), _dirty(false), _scheduled(false), _updating(false), _updateTime(0),
+		_particleBudget(0), _timeBudget(0), _minimumThrottle(0.1f), _particleCount(0), _throttledCount(0),
+		_amortizedBudget(0), _amortizedPriority(0), _cursor(0), _deferredCount(0){}
+	~ParticleSystemManager();
+	static ParticleSystemManager* getInstance();
+
+	void add(ParticleEffect* effect);
+
+	void remove(ParticleEffect* effect);
+
+	int getEffectCount() const {
+		return (int)_effects.size() - _holes;
+	}
+
+	/** The started effects. Slots emptied during an update are null until it ends. */
+	const std::vector<ParticleEffect*>& getEffects() const {
+		return _effects;
+	}
+
+	/** Milliseconds spent in the last update. */
+	float getUpdateTime() const {
+		return _updateTime;
+	}
+
+	/** Caps the particles alive across all effects, 0 for no cap. Over the cap, the lowest priority effects
+	* have their emission and particle limit scaled down, and back up once the load drops. */
+	void setParticleBudget(int particles) {
+		_particleBudget = particles;
+	}
+
+	int getParticleBudget() const {
+		return _particleBudget;
+	}
+
+	/** Caps the update time per frame in milliseconds, 0 for no cap. It is turned into a particle count with
+	* the cost per particle measured in the previous update. */
+	void setTimeBudget(float milliseconds) {
+		_timeBudget = milliseconds;
+	}
+
+	float getTimeBudget() const {
+		return _timeBudget;
+	}
+
+	/** The lowest throttle the budget applies, 0.1 by default so that low priority effects thin out instead of
+	* disappearing. 0 lets it stop their emission entirely. */
+	void setMinimumThrottle(float throttle) {
+		_minimumThrottle = std::min(std::max(throttle, 0.0f), 1.0f);
+	}
+
+	float getMinimumThrottle() const {
+		return _minimumThrottle;
+	}
+
+	/** Particles alive after the last update. */
+	int getParticleCount() const {
+		return _particleCount;
+	}
+
+	/** Effects emitting below their authored rate after the last update. */
+	int getThrottledCount() const {
+		return _throttledCount;
+	}
+
+	/** Effects with a priority below amortizedPriority are updated in turn within a budget of milliseconds per
+	* frame, after all other effects. Those not reached keep their delta and catch up in one larger step when
+	* their turn comes. 0 updates every effect every frame. */
+	void setAmortizedBudget(float milliseconds, int amortizedPriority = 0) {
+		_amortizedBudget = milliseconds;
+		_amortizedPriority = amortizedPriority;
+	}
+
+	float getAmortizedBudget() const {
+		return _amortizedBudget;
+	}
+
+	/** Low priority effects left waiting in the last update. */
+	int getDeferredCount() const {
+		return _deferredCount;
+	}
+
+	void update(float delta);
+private:
+	struct Load{
+		ParticleEffect* effect;
+		float demand;	// particles the effect would have at full emission
+	};
+
+	static ParticleSystemManager* _instance;
+
+	std::vector<ParticleEffect*> _effects;
+	/** Slots emptied during an update, compacted once it ends. */
+	int _holes;
+	/** Set when effects were added since the array was last grouped. */
+	bool _dirty;
+	bool _scheduled;
+	bool _updating;
+	float _updateTime;
+	int _particleBudget;
+	float _timeBudget;
+	float _minimumThrottle;
+	int _particleCount;
+	int _throttledCount;
+	std::vector<Load> _loads;
+	float _amortizedBudget;
+	int _amortizedPriority;
+	/** Where the next round of low priority updates starts. */
+	size_t _cursor;
+	int _deferredCount;
+
+	void compact();
+
+	void applyBudget(float delta);
+
+	bool isUpdatable(ParticleEffect* effect) const;
+
+	/** Updates waiting low priority effects in turn until the frame budget, counted from startTime, is spent. */
+	void updateDeferred(std::chrono::steady_clock::time_point startTime);
+};
+
+NS_CUSTOM_END
+
+#endif
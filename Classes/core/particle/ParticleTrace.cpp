@@ -0,0 +1,116 @@
+#include "ParticleTrace.h"
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+USING_NS_CUSTOM;
+
+ParticleTrace* NS_CUSTOM::ParticleTrace::_instance = nullptr;
+
+ParticleTrace* NS_CUSTOM::ParticleTrace::getInstance()
+{
+	if (!_instance){
+		_instance = new ParticleTrace();
+	}
+	return _instance;
+}
+
+void NS_CUSTOM::ParticleTrace::start(size_t capacity)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_events.assign(std::max<size_t>(capacity, 1), Event());
+	_next = _count = 0;
+	_origin = std::chrono::steady_clock::now();
+	int thread = getThreadIndex(std::this_thread::get_id());
+	if (_threadNames[thread].empty()) _threadNames[thread] = "main";
+	_recording = true;
+}
+
+void NS_CUSTOM::ParticleTrace::stop()
+{
+	_recording = false;
+}
+
+void NS_CUSTOM::ParticleTrace::record(const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (!_recording || _events.empty()) return;
+	Event& event = _events[_next];
+	event.name = name;
+	event.start = std::chrono::duration_cast<std::chrono::nanoseconds>(start - _origin).count();
+	event.duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+	event.thread = getThreadIndex(std::this_thread::get_id());
+	_next = (_next + 1) % _events.size();
+	if (_count < _events.size()) _count++;
+}
+
+void NS_CUSTOM::ParticleTrace::setThreadName(const string& name)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_threadNames[getThreadIndex(std::this_thread::get_id())] = name;
+}
+
+void NS_CUSTOM::ParticleTrace::clear()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_next = _count = 0;
+}
+
+std::vector<ParticleTrace::Event> NS_CUSTOM::ParticleTrace::getEvents()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	std::vector<Event> events;
+	events.reserve(_count);
+	size_t first = (_next + _events.size() - _count) % std::max<size_t>(_events.size(), 1);
+	for (size_t i = 0; i < _count; i++)
+		events.push_back(_events[(first + i) % _events.size()]);
+	return events;
+}
+
+int NS_CUSTOM::ParticleTrace::getThreadIndex(std::thread::id id)
+{
+	for (size_t i = 0; i < _threads.size(); i++){
+		if (_threads[i] == id) return (int)i;
+	}
+	_threads.push_back(id);
+	_threadNames.push_back(string());
+	return (int)_threads.size() - 1;
+}
+
+static void writeJsonString(std::ostream& output, const string& value)
+{
+	output << '"';
+	for (char c : value){
+		if (c == '"' || c == '\\') output << '\\' << c;
+		else if ((unsigned char)c >= 0x20) output << c;
+	}
+	output << '"';
+}
+
+string NS_CUSTOM::ParticleTrace::toJson()
+{
+	auto events = getEvents();
+	std::vector<string> threadNames;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		threadNames = _threadNames;
+	}
+	std::ostringstream output;
+	output << std::fixed << std::setprecision(3);
+	output << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	for (size_t i = 0; i < threadNames.size(); i++){
+		if (i > 0) output << ',';
+		output << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << i << ",\"args\":{\"name\":";
+		writeJsonString(output, threadNames[i].empty() ? "thread " + std::to_string(i) : threadNames[i]);
+		output << "}}";
+	}
+	// Complete ("X") events in microseconds.
+	for (auto& event : events){
+		output << ",{\"name\":";
+		writeJsonString(output, event.name);
+		output << ",\"cat\":\"particle\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+			<< ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << event.duration / 1000.0 << '}';
+	}
+	output << "]}";
+	return output.str();
+}
@@ -0,0 +1,102 @@
+#ifndef __PARTICLE_TRACE_H__
+#define __PARTICLE_TRACE_H__
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include "core/util/GameDefine.h"
+
+using std::string;
+
+/** Trace markers are compiled in only when PARTICLE_TRACE_ENABLED is non-zero, by default in debug builds.
+* Compiled in, a marker costs a flag check until tracing starts. */
+#ifndef PARTICLE_TRACE_ENABLED
+#if defined(COCOS2D_DEBUG) && COCOS2D_DEBUG > 0
+#define PARTICLE_TRACE_ENABLED 1
+#else
+#define PARTICLE_TRACE_ENABLED 0
+#endif
+#endif
+
+#if PARTICLE_TRACE_ENABLED
+/** Records the enclosing scope as a trace event; name must be a string literal. */
+#define PARTICLE_TRACE(name) NS_CUSTOM::ParticleTraceScope particleTraceScope(name)
+#else
+#define PARTICLE_TRACE(name)
+#endif
+
+NS_CUSTOM_BEGIN
+
+/** Records timed phases of the particle pipeline into a ring buffer and exports them as Chrome trace-event
+* JSON, which chrome://tracing and Perfetto open as a timeline with one track per thread. */
+class ParticleTrace{
+public:
+	struct Event{
+		const char* name;
+		/** Nanoseconds since the trace started. */
+		long long start;
+		long long duration;
+		int thread;
+	};
+
+	ParticleTrace() :_recording(false), _next(0), _count(0){}
+	static ParticleTrace* getInstance();
+
+	/** Starts recording, keeping the latest capacity events. The calling thread is named "main" unless it
+	* has a name. */
+	void start(size_t capacity = 1 << 16);
+
+	void stop();
+
+	bool isRecording() const {
+		return _recording.load(std::memory_order_relaxed);
+	}
+
+	void record(const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+
+	/** Names the calling thread's track. */
+	void setThreadName(const string& name);
+
+	void clear();
+
+	/** Returns the recorded events, oldest first. */
+	std::vector<Event> getEvents();
+
+	string toJson();
+private:
+	static ParticleTrace* _instance;
+
+	std::atomic<bool> _recording;
+	std::chrono::steady_clock::time_point _origin;
+	/** Guards everything below. */
+	std::mutex _mutex;
+	std::vector<Event> _events;
+	size_t _next;
+	size_t _count;
+	/** Threads in the order they first recorded; the index is the track id. */
+	std::vector<std::thread::id> _threads;
+	std::vector<string> _threadNames;
+
+	int getThreadIndex(std::thread::id id);
+};
+
+class ParticleTraceScope{
+public:
+	explicit ParticleTraceScope(const char* name) :_name(ParticleTrace::getInstance()->isRecording() ? name : nullptr){
+		if (_name) _start = std::chrono::steady_clock::now();
+	}
+
+	~ParticleTraceScope(){
+		if (_name) ParticleTrace::getInstance()->record(_name, _start, std::chrono::steady_clock::now());
+	}
+private:
+	const char* _name;
+	std::chrono::steady_clock::time_point _start;
+};
+
+NS_CUSTOM_END
+
+#endif
@@ -0,0 +1,176 @@
+/** Checks that affectors act where particles are drawn. Needs only the simulation core, e.g. from
+* Classes/core/particle:
+*   g++ -std=c++14 -I. -I../.. test/ParticleAffectorTest.cpp ParticleSimulation.cpp ParticleStats.cpp ParticleAffector.cpp */
+#include "ParticleSimulation.h"
+#include "ParticleAffector.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+USING_NS_CUSTOM;
+
+static const float SPRITE_SIZE = 32;
+
+/** One particle that neither moves nor fades for a second. */
+static const char* STILL_DEFINITION =
+	"Still\n"
+	"- Delay -\n"
+	"active: false\n"
+	"- Duration - \n"
+	"lowMin: 1000.0\n"
+	"lowMax: 1000.0\n"
+	"- Count - \n"
+	"min: 0\n"
+	"max: 1\n"
+	"- Emission - \n"
+	"lowMin: 0.0\n"
+	"lowMax: 0.0\n"
+	"highMin: 0.0\n"
+	"highMax: 0.0\n"
+	"relative: false\n"
+	"scalingCount: 1\n"
+	"scaling0: 1.0\n"
+	"timelineCount: 1\n"
+	"timeline0: 0.0\n"
+	"- Life - \n"
+	"lowMin: 0.0\n"
+	"lowMax: 0.0\n"
+	"highMin: 1000.0\n"
+	"highMax: 1000.0\n"
+	"relative: false\n"
+	"scalingCount: 1\n"
+	"scaling0: 1.0\n"
+	"timelineCount: 1\n"
+	"timeline0: 0.0\n"
+	"- Life Offset - \n"
+	"active: false\n"
+	"- X Offset - \n"
+	"active: false\n"
+	"- Y Offset - \n"
+	"active: false\n"
+	"- Spawn Shape - \n"
+	"shape: point\n"
+	"- Spawn Width - \n"
+	"lowMin: 0.0\n"
+	"lowMax: 0.0\n"
+	"highMin: 0.0\n"
+	"highMax: 0.0\n"
+	"relative: false\n"
+	"scalingCount: 1\n"
+	"scaling0: 1.0\n"
+	"timelineCount: 1\n"
+	"timeline0: 0.0\n"
+	"- Spawn Height - \n"
+	"lowMin: 0.0\n"
+	"lowMax: 0.0\n"
+	"highMin: 0.0\n"
+	"highMax: 0.0\n"
+	"relative: false\n"
+	"scalingCount: 1\n"
+	"scaling0: 1.0\n"
+	"timelineCount: 1\n"
+	"timeline0: 0.0\n"
+	"- Scale - \n"
+	"lowMin: 0.0\n"
+	"lowMax: 0.0\n"
+	"highMin: 1.0\n"
+	"highMax: 1.0\n"
+	"relative: false\n"
+	"scalingCount: 1\n"
+	"scaling0: 1.0\n"
+	"timelineCount: 1\n"
+	"timeline0: 0.0\n"
+	"- Velocity - \n"
+	"active: false\n"
+	"- Angle - \n"
+	"active: false\n"
+	"- Rotation - \n"
+	"active: false\n"
+	"- Wind - \n"
+	"active: false\n"
+	"- Gravity - \n"
+	"active: false\n"
+	"- Tint - \n"
+	"colorsCount: 3\n"
+	"colors0: 1.0\n"
+	"colors1: 1.0\n"
+	"colors2: 1.0\n"
+	"timelineCount: 1\n"
+	"timeline0: 0.0\n"
+	"- Transparency - \n"
+	"lowMin: 0.0\n"
+	"lowMax: 0.0\n"
+	"highMin: 1.0\n"
+	"highMax: 1.0\n"
+	"relative: false\n"
+	"scalingCount: 1\n"
+	"scaling0: 1.0\n"
+	"timelineCount: 1\n"
+	"timeline0: 0.0\n"
+	"- Options - \n"
+	"attached: false\n"
+	"continuous: false\n"
+	"aligned: false\n"
+	"additive: false\n"
+	"behind: false\n"
+	"premultipliedAlpha: false\n"
+	"- Image Path -\n"
+	"particle.png\n";
+
+static int failures = 0;
+
+static void check(bool condition, const char* message)
+{
+	if (condition) return;
+	printf("FAILED: %s\n", message);
+	failures++;
+}
+
+/** Spawns one still particle drawn at x, y and steps it once under affector. */
+static void stepOne(ParticleDefinition& definition, ParticleAffector& affector, float x, float y, float& drawnX, float& drawnY)
+{
+	ParticleSimulation simulation;
+	simulation.setDefinition(&definition);
+	simulation.setParticleSize(SPRITE_SIZE, SPRITE_SIZE);
+	simulation.setEmitting(false);
+	simulation.addAffector(&affector);
+	simulation.start();
+	simulation.burst(x, y, 1);
+	simulation.step(1 / 60.0f);
+	const Particle& particle = simulation.getParticles()[0];
+	drawnX = particle.x + SPRITE_SIZE / 2 + simulation.getOriginX();
+	drawnY = particle.y + SPRITE_SIZE / 2 + simulation.getOriginY();
+	simulation.removeAffector(&affector);
+}
+
+int main()
+{
+	ParticleDefinition definition;
+	ParticleTextReader reader(STILL_DEFINITION, strlen(STILL_DEFINITION));
+	check(definition.load(reader), "loads the test definition");
+
+	// A particle drawn at the very center of a circle leaves it.
+	ParticleCircleCollider circle(100, 100, 10);
+	float x, y;
+	stepOne(definition, circle, 100, 100, x, y);
+	check(std::sqrt((x - 100) * (x - 100) + (y - 100) * (y - 100)) >= 10 - 1e-3f, "circle collider pushes out a centered particle");
+
+	// One drawn below a plane is put back on it.
+	ParticlePlaneCollider plane(0, 50);
+	stepOne(definition, plane, 200, 40, x, y);
+	check(std::abs(y - 50) < 1e-3f, "plane collider holds the drawn center on the plane");
+
+	// One drawn inside a box of a collision world leaves it.
+	ParticleCollisionWorld world(64);
+	world.addBox(90, 90, 20, 20);
+	stepOne(definition, world, 100, 104, x, y);
+	check(y >= 110 - 1e-3f, "collision world pushes a particle out of a box");
+
+	// An attractor exactly at the drawn center has no direction to pull in.
+	ParticleAttractor attractor(100, 100, 1000);
+	stepOne(definition, attractor, 100, 100, x, y);
+	check(std::abs(x - 100) < 1e-3f && std::abs(y - 100) < 1e-3f, "attractor leaves a particle at its center in place");
+
+	if (failures == 0) printf("ParticleAffectorTest passed\n");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+/** Checks that binary effects load back to the text they were compiled from, and that damaged files are
+* rejected before anything points into them. Needs the cocos2d-x headers and library for Ref and FileUtils,
+* e.g. from Classes/core/particle:
+*   g++ -std=c++14 -I. -I../.. -I$COCOS_ROOT/cocos test/ParticleEffectBinaryTest.cpp *.cpp -L$COCOS_LIB -lcocos2d */
+#include "ParticleEffect.h"
+#include "ParticleEffectBinary.h"
+#include "ParticleTestEffects.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+USING_NS_CUSTOM;
+
+static const char* BINARY_PATH = "ParticleEffectBinaryTest.pfeb";
+
+// Byte offsets of the file layout, which ParticleEffectBinary keeps private.
+static const size_t HEADER_EMITTER_OFFSET = 12;
+static const size_t HEADER_FLOAT_OFFSET = 16;
+static const size_t HEADER_FLOAT_COUNT = 20;
+static const size_t HEADER_STRING_SIZE = 28;
+static const size_t RECORD_VALUES = 20;
+static const size_t VALUE_SIZE = 36;
+static const size_t VALUE_CURVE_COUNT = 24;
+static const size_t VALUE_TIMELINE_COUNT = 32;
+static const int LIFE_VALUE = 3;
+static const int TINT_VALUE = 12;
+
+static int failures = 0;
+
+static void check(bool condition, const char* message)
+{
+	if (condition) return;
+	printf("FAILED: %s\n", message);
+	failures++;
+}
+
+static string saveText(std::vector<EmitterDefinition*>& definitions)
+{
+	std::ostringstream output;
+	for (size_t i = 0; i < definitions.size(); i++){
+		if (i > 0) output << "\n\n";
+		definitions[i]->save(output);
+	}
+	return output.str();
+}
+
+static void releaseAll(std::vector<EmitterDefinition*>& definitions)
+{
+	for (auto definition : definitions)
+		definition->release();
+	definitions.clear();
+}
+
+static uint32_t readWord(const string& bytes, size_t offset)
+{
+	uint32_t word;
+	memcpy(&word, bytes.data() + offset, sizeof(word));
+	return word;
+}
+
+static void writeWord(string& bytes, size_t offset, uint32_t word)
+{
+	memcpy(&bytes[offset], &word, sizeof(word));
+}
+
+/** Whether the damaged copy is turned down, with nothing appended. */
+static bool rejects(EffectFile* file, const string& bytes)
+{
+	std::vector<EmitterDefinition*> definitions;
+	bool read = ParticleEffectBinary::read(file, bytes.data(), bytes.size(), definitions);
+	bool rejected = !read && definitions.empty();
+	releaseAll(definitions);
+	return rejected;
+}
+
+int main()
+{
+	std::vector<EmitterDefinition*> definitions;
+	check(ParticleEffect::parseDefinitions(TEST_EFFECT, strlen(TEST_EFFECT), definitions), "parses the test effect");
+	check(definitions.size() == 2, "the test effect has two emitters");
+	string text = saveText(definitions);
+
+	{
+		std::ofstream output(BINARY_PATH, std::ios::binary | std::ios::trunc);
+		check(ParticleEffectBinary::write(definitions, output), "writes the binary effect");
+	}
+	releaseAll(definitions);
+
+	auto file = EffectFile::open(BINARY_PATH);
+	check(file != nullptr, "opens the binary effect");
+	if (!file) return 1;
+	check(file->isBinary(), "the written file has the binary header");
+
+	// Definitions point into the file, so it is compared while they are alive.
+	check(ParticleEffectBinary::read(file, definitions), "reads the binary effect");
+	check(saveText(definitions) == text, "binary effect saves as the text it was compiled from");
+	releaseAll(definitions);
+
+	string bytes(file->getData(), file->getSize());
+	uint32_t emitterOffset = readWord(bytes, HEADER_EMITTER_OFFSET);
+	size_t life = emitterOffset + RECORD_VALUES + LIFE_VALUE * VALUE_SIZE;
+	size_t tint = emitterOffset + RECORD_VALUES + TINT_VALUE * VALUE_SIZE;
+
+	check(rejects(file, bytes.substr(0, bytes.size() - 1)), "rejects a file missing its last byte");
+	check(rejects(file, bytes.substr(0, 16)), "rejects a file cut inside the header");
+
+	string damaged = bytes;
+	writeWord(damaged, HEADER_FLOAT_COUNT, (uint32_t)(bytes.size() - readWord(bytes, HEADER_FLOAT_OFFSET)) / 4 + 1);
+	check(rejects(file, damaged), "rejects a float table longer than the file");
+
+	damaged = bytes;
+	damaged[bytes.size() - 1] = 'x';
+	check(rejects(file, damaged), "rejects an unterminated string table");
+
+	damaged = bytes;
+	writeWord(damaged, HEADER_STRING_SIZE, 0);
+	check(rejects(file, damaged), "rejects an empty string table");
+
+	damaged = bytes;
+	writeWord(damaged, life + VALUE_CURVE_COUNT, readWord(bytes, life + VALUE_TIMELINE_COUNT) - 1);
+	check(rejects(file, damaged), "rejects fewer scaling points than timeline entries");
+
+	damaged = bytes;
+	writeWord(damaged, life + VALUE_CURVE_COUNT, 0);
+	writeWord(damaged, life + VALUE_TIMELINE_COUNT, 0);
+	check(rejects(file, damaged), "rejects an empty curve");
+
+	damaged = bytes;
+	writeWord(damaged, tint + VALUE_CURVE_COUNT, readWord(bytes, tint + VALUE_TIMELINE_COUNT) * 3 - 1);
+	check(rejects(file, damaged), "rejects a tint without three colors per timeline entry");
+
+	file->release();
+	remove(BINARY_PATH);
+	if (failures == 0) printf("ParticleEffectBinaryTest passed\n");
+	return failures == 0 ? 0 : 1;
+}
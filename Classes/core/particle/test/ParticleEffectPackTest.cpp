@@ -0,0 +1,223 @@
+/** Packs a few effects with their images, reopens the pack and preloads it into the effect cache, and checks that
+* damaged packs are rejected when opened. Textures need a GL context, so this opens a window through cocos2d-x,
+* e.g. from Classes/core/particle:
+*   g++ -std=c++14 -I. -I../.. -I$COCOS_ROOT/cocos test/ParticleEffectPackTest.cpp *.cpp -L$COCOS_LIB -lcocos2d */
+#include "ParticleEffect.h"
+#include "ParticleEffectBinary.h"
+#include "ParticleEffectCache.h"
+#include "ParticleEffectPack.h"
+#include "ParticleTestEffects.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+USING_NS_CUSTOM;
+
+/** Effects and images are written below the writable path, and packed under names relative to it. */
+static const string DIRECTORY = "ParticleEffectPackTest/";
+static const string PACK_FILE = "ParticleEffectPackTest.pfpk";
+static const string DAMAGED_FILE = "ParticleEffectPackTest.damaged.pfpk";
+
+static string root;
+
+// Byte offsets of the pack layout, which ParticleEffectPack keeps private.
+static const size_t HEADER_VERSION = 4;
+static const size_t HEADER_ENTRY_COUNT = 8;
+static const size_t HEADER_INDEX_OFFSET = 12;
+static const size_t HEADER_NAME_OFFSET = 16;
+static const size_t RECORD_SIZE = 20;
+static const size_t RECORD_TYPE = 0;
+static const size_t RECORD_NAME = 4;
+static const size_t RECORD_NAME_LENGTH = 8;
+static const size_t RECORD_OFFSET = 12;
+static const size_t RECORD_BYTES = 16;
+
+/** A 1x1 PNG; its odd size leaves padding behind each copy in the pack. */
+static const unsigned char IMAGE[] = {
+	0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d, 0x49, 0x48, 0x44, 0x52,
+	0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0x08, 0x06, 0x00, 0x00, 0x00, 0x1f, 0x15, 0xc4,
+	0x89, 0x00, 0x00, 0x00, 0x03, 0x74, 0x45, 0x58, 0x74, 0x61, 0x00, 0x62, 0xdc, 0x49, 0xa2, 0x3b,
+	0x00, 0x00, 0x00, 0x0b, 0x49, 0x44, 0x41, 0x54, 0x78, 0x9c, 0x63, 0xf8, 0x0f, 0x04, 0x00, 0x09,
+	0xfb, 0x03, 0xfd, 0xfb, 0x5e, 0x6b, 0x2b, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4e, 0x44, 0xae,
+	0x42, 0x60, 0x82 };
+
+static int failures = 0;
+
+static void check(bool condition, const char* message)
+{
+	if (condition) return;
+	printf("FAILED: %s\n", message);
+	failures++;
+}
+
+static void writeFile(const string& path, const string& bytes)
+{
+	std::ofstream output(path, std::ios::binary | std::ios::trunc);
+	output.write(bytes.data(), bytes.size());
+}
+
+static string readFile(const string& path)
+{
+	std::ifstream input(path, std::ios::binary);
+	std::ostringstream bytes;
+	bytes << input.rdbuf();
+	return bytes.str();
+}
+
+static uint32_t readWord(const string& bytes, size_t offset)
+{
+	uint32_t word;
+	memcpy(&word, bytes.data() + offset, sizeof(word));
+	return word;
+}
+
+static void writeWord(string& bytes, size_t offset, uint32_t word)
+{
+	memcpy(&bytes[offset], &word, sizeof(word));
+}
+
+/** Whether a pack with these bytes fails to open. */
+static bool rejects(const string& bytes)
+{
+	writeFile(root + DAMAGED_FILE, bytes);
+	bool rejected = ParticleEffectPack::create(root + DAMAGED_FILE) == nullptr;
+	remove((root + DAMAGED_FILE).c_str());
+	return rejected;
+}
+
+static string saveText(ParticleEffect* effect)
+{
+	std::ostringstream output;
+	effect->save(output);
+	return output.str();
+}
+
+/** The text an effect loaded from an effect file saves as. */
+static string saveText(const string& text)
+{
+	std::vector<EmitterDefinition*> definitions;
+	ParticleEffect::parseDefinitions(text.data(), text.size(), definitions);
+	auto effect = ParticleEffect::create();
+	effect->initWithDefinitions(definitions);
+	for (auto definition : definitions)
+		definition->release();
+	return saveText(effect);
+}
+
+int main()
+{
+	auto director = Director::getInstance();
+	director->setOpenGLView(GLViewImpl::create("ParticleEffectPackTest"));
+	auto fileUtils = FileUtils::getInstance();
+	root = fileUtils->getWritablePath();
+	fileUtils->addSearchPath(root, true);
+	fileUtils->createDirectory(root + DIRECTORY);
+	string packPath = root + PACK_FILE;
+
+	// A text effect with both images, a text effect and a binary effect that each share one of them.
+	string effect = TEST_EFFECT;
+	size_t split = effect.find("\n\n\n");
+	string flame = effect.substr(0, split + 1);
+	string sparks = effect.substr(split + 3);
+	std::vector<EmitterDefinition*> definitions;
+	check(ParticleEffect::parseDefinitions(sparks.data(), sparks.size(), definitions), "parses the sparks emitter");
+	{
+		std::ofstream output(root + DIRECTORY + "sparks.pfeb", std::ios::binary | std::ios::trunc);
+		check(ParticleEffectBinary::write(definitions, output), "writes the binary effect");
+	}
+	for (auto definition : definitions)
+		definition->release();
+	writeFile(root + DIRECTORY + "effect.p", effect);
+	writeFile(root + DIRECTORY + "flame.p", flame);
+	string image((const char*)IMAGE, sizeof(IMAGE));
+	writeFile(root + DIRECTORY + "particle.png", image);
+	writeFile(root + DIRECTORY + "spark.png", image);
+
+	std::vector<string> names = { DIRECTORY + "effect.p", DIRECTORY + "flame.p", DIRECTORY + "sparks.pfeb" };
+	check(!ParticleEffectPack::write({ DIRECTORY + "missing.p" }, packPath), "does not pack a missing effect");
+	check(ParticleEffectPack::write(names, packPath), "writes the pack");
+
+	// Every effect and image once, aligned, with the bytes of the file it came from.
+	string bytes = readFile(packPath);
+	uint32_t entryCount = readWord(bytes, HEADER_ENTRY_COUNT);
+	uint32_t indexOffset = readWord(bytes, HEADER_INDEX_OFFSET);
+	uint32_t nameOffset = readWord(bytes, HEADER_NAME_OFFSET);
+	check(entryCount == 5, "packs three effects and two images");
+	bool aligned = true, copied = true;
+	for (uint32_t i = 0; i < entryCount; i++){
+		size_t record = indexOffset + i * RECORD_SIZE;
+		string name = bytes.substr(nameOffset + readWord(bytes, record + RECORD_NAME), readWord(bytes, record + RECORD_NAME_LENGTH));
+		uint32_t offset = readWord(bytes, record + RECORD_OFFSET);
+		aligned = aligned && offset % 4 == 0;
+		copied = copied && bytes.compare(offset, readWord(bytes, record + RECORD_BYTES), readFile(root + name)) == 0;
+	}
+	check(aligned, "every entry starts on a 4-byte boundary");
+	check(copied, "every entry holds the file it was packed from");
+
+	auto pack = ParticleEffectPack::create(packPath);
+	check(pack != nullptr, "opens the pack");
+	if (!pack) return 1;
+	check(pack->getEffectNames() == names, "lists the effects in the order they were packed");
+	check(pack->contains(DIRECTORY + "particle.png") && pack->contains(DIRECTORY + "spark.png"), "holds the images the effects reference");
+	check(pack->getTexture(DIRECTORY + "effect.p") == nullptr, "does not decode an effect as an image");
+
+	// The loose files are gone, so everything has to come from the pack.
+	string loose[] = { "effect.p", "flame.p", "sparks.pfeb", "particle.png", "spark.png" };
+	for (auto& file : loose)
+		remove((root + DIRECTORY + file).c_str());
+
+	auto cache = ParticleEffectCache::getInstance();
+	ParticleEffect::clearCache();
+	check(pack->preload() == 3, "preloads every effect");
+	check(cache->getCount() == 3, "caches every effect");
+	check(pack->preload() == 0, "skips effects already cached");
+	auto cached = cache->peek(DIRECTORY + "effect.p");
+	check(cached && saveText(cached) == saveText(effect), "the packed text effect loads as the file it came from");
+	cached = cache->peek(DIRECTORY + "sparks.pfeb");
+	check(cached && saveText(cached) == saveText(sparks), "the packed binary effect loads as the text it was compiled from");
+	check(cached && cached->getEmitters().at(0)->getSprite()
+		&& cached->getEmitters().at(0)->getSprite()->getTexture() == pack->getTexture(DIRECTORY + "spark.png"),
+		"emitters draw with the images in the pack");
+	ParticleEffect::clearCache();
+
+	check(rejects(bytes.substr(0, bytes.size() - 1)), "rejects a pack missing its last byte");
+	check(rejects(bytes.substr(0, 12)), "rejects a pack cut inside the header");
+
+	string damaged = bytes;
+	damaged[0] = 'X';
+	check(rejects(damaged), "rejects a pack without the magic");
+
+	damaged = bytes;
+	writeWord(damaged, HEADER_VERSION, ParticleEffectPack::VERSION + 1);
+	check(rejects(damaged), "rejects a newer pack version");
+
+	damaged = bytes;
+	writeWord(damaged, HEADER_INDEX_OFFSET, indexOffset + 2);
+	check(rejects(damaged), "rejects a misaligned index");
+
+	damaged = bytes;
+	writeWord(damaged, HEADER_ENTRY_COUNT, entryCount + 1000);
+	check(rejects(damaged), "rejects an index longer than the pack");
+
+	damaged = bytes;
+	writeWord(damaged, indexOffset + RECORD_OFFSET, readWord(bytes, indexOffset + RECORD_OFFSET) + 1);
+	check(rejects(damaged), "rejects a misaligned entry");
+
+	damaged = bytes;
+	writeWord(damaged, indexOffset + RECORD_BYTES, (uint32_t)bytes.size());
+	check(rejects(damaged), "rejects an entry longer than the pack");
+
+	damaged = bytes;
+	writeWord(damaged, indexOffset + RECORD_NAME_LENGTH, (uint32_t)bytes.size());
+	check(rejects(damaged), "rejects a name past the name table");
+
+	damaged = bytes;
+	writeWord(damaged, indexOffset + RECORD_TYPE, 2);
+	check(rejects(damaged), "rejects an unknown entry type");
+
+	remove(packPath.c_str());
+	fileUtils->removeDirectory(root + DIRECTORY);
+	if (failures == 0) printf("ParticleEffectPackTest passed\n");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,306 @@
+#ifndef __PARTICLE_TEST_EFFECTS_H__
+#define __PARTICLE_TEST_EFFECTS_H__
+
+/** A two-emitter effect as the editor saves it: a continuous flame, and sparks that use the remaining kinds of
+* value (life offset, wind, an elliptic edge spawn and a two-color tint). */
+static const char* TEST_EFFECT =
+	"Flame\n"
+	"- Delay -\n"
+	"active: false\n"
+	"- Duration - \n"
+	"lowMin: 1000.0\n"
+	"lowMax: 1000.0\n"
+	"- Count - \n"
+	"min: 0\n"
+	"max: 200\n"
+	"- Emission - \n"
+	"lowMin: 0.0\n"
+	"lowMax: 0.0\n"
+	"highMin: 250.0\n"
+	"highMax: 250.0\n"
+	"relative: false\n"
+	"scalingCount: 1\n"
+	"scaling0: 1.0\n"
+	"timelineCount: 1\n"
+	"timeline0: 0.0\n"
+	"- Life - \n"
+	"lowMin: 0.0\n"
+	"lowMax: 0.0\n"
+	"highMin: 500.0\n"
+	"highMax: 1000.0\n"
+	"relative: false\n"
+	"scalingCount: 3\n"
+	"scaling0: 1.0\n"
+	"scaling1: 1.0\n"
+	"scaling2: 0.3\n"
+	"timelineCount: 3\n"
+	"timeline0: 0.0\n"
+	"timeline1: 0.66\n"
+	"timeline2: 0.93\n"
+	"- Life Offset - \n"
+	"active: false\n"
+	"- X Offset - \n"
+	"active: false\n"
+	"- Y Offset - \n"
+	"active: false\n"
+	"- Spawn Shape - \n"
+	"shape: point\n"
+	"- Spawn Width - \n"
+	"lowMin: 0.0\n"
+	"lowMax: 0.0\n"
+	"highMin: 0.0\n"
+	"highMax: 0.0\n"
+	"relative: false\n"
+	"scalingCount: 1\n"
+	"scaling0: 1.0\n"
+	"timelineCount: 1\n"
+	"timeline0: 0.0\n"
+	"- Spawn Height - \n"
+	"lowMin: 0.0\n"
+	"lowMax: 0.0\n"
+	"highMin: 0.0\n"
+	"highMax: 0.0\n"
+	"relative: false\n"
+	"scalingCount: 1\n"
+	"scaling0: 1.0\n"
+	"timelineCount: 1\n"
+	"timeline0: 0.0\n"
+	"- Scale - \n"
+	"lowMin: 0.0\n"
+	"lowMax: 0.0\n"
+	"highMin: 32.0\n"
+	"highMax: 32.0\n"
+	"relative: false\n"
+	"scalingCount: 1\n"
+	"scaling0: 1.0\n"
+	"timelineCount: 1\n"
+	"timeline0: 0.0\n"
+	"- Velocity - \n"
+	"active: true\n"
+	"lowMin: 0.0\n"
+	"lowMax: 0.0\n"
+	"highMin: 30.0\n"
+	"highMax: 300.0\n"
+	"relative: false\n"
+	"scalingCount: 1\n"
+	"scaling0: 1.0\n"
+	"timelineCount: 1\n"
+	"timeline0: 0.0\n"
+	"- Angle - \n"
+	"active: true\n"
+	"lowMin: 90.0\n"
+	"lowMax: 90.0\n"
+	"highMin: 45.0\n"
+	"highMax: 135.0\n"
+	"relative: false\n"
+	"scalingCount: 3\n"
+	"scaling0: 1.0\n"
+	"scaling1: 0.0\n"
+	"scaling2: 0.0\n"
+	"timelineCount: 3\n"
+	"timeline0: 0.0\n"
+	"timeline1: 0.5\n"
+	"timeline2: 1.0\n"
+	"- Rotation - \n"
+	"active: false\n"
+	"- Wind - \n"
+	"active: false\n"
+	"- Gravity - \n"
+	"active: false\n"
+	"- Tint - \n"
+	"colorsCount: 3\n"
+	"colors0: 1.0\n"
+	"colors1: 0.12156863\n"
+	"colors2: 0.047058824\n"
+	"timelineCount: 1\n"
+	"timeline0: 0.0\n"
+	"- Transparency - \n"
+	"lowMin: 0.0\n"
+	"lowMax: 0.0\n"
+	"highMin: 1.0\n"
+	"highMax: 1.0\n"
+	"relative: false\n"
+	"scalingCount: 4\n"
+	"scaling0: 0.0\n"
+	"scaling1: 1.0\n"
+	"scaling2: 0.75\n"
+	"scaling3: 0.0\n"
+	"timelineCount: 4\n"
+	"timeline0: 0.0\n"
+	"timeline1: 0.2\n"
+	"timeline2: 0.8\n"
+	"timeline3: 1.0\n"
+	"- Options - \n"
+	"attached: false\n"
+	"continuous: true\n"
+	"aligned: false\n"
+	"additive: true\n"
+	"behind: false\n"
+	"premultipliedAlpha: false\n"
+	"- Image Path -\n"
+	"particle.png\n"
+	"\n"
+	"\n"
+	"Sparks\n"
+	"- Delay -\n"
+	"active: false\n"
+	"- Duration - \n"
+	"lowMin: 1000.0\n"
+	"lowMax: 1000.0\n"
+	"- Count - \n"
+	"min: 0\n"
+	"max: 200\n"
+	"- Emission - \n"
+	"lowMin: 0.0\n"
+	"lowMax: 0.0\n"
+	"highMin: 250.0\n"
+	"highMax: 250.0\n"
+	"relative: false\n"
+	"scalingCount: 1\n"
+	"scaling0: 1.0\n"
+	"timelineCount: 1\n"
+	"timeline0: 0.0\n"
+	"- Life - \n"
+	"lowMin: 0.0\n"
+	"lowMax: 0.0\n"
+	"highMin: 500.0\n"
+	"highMax: 1000.0\n"
+	"relative: false\n"
+	"scalingCount: 3\n"
+	"scaling0: 1.0\n"
+	"scaling1: 1.0\n"
+	"scaling2: 0.3\n"
+	"timelineCount: 3\n"
+	"timeline0: 0.0\n"
+	"timeline1: 0.66\n"
+	"timeline2: 0.93\n"
+	"- Life Offset - \n"
+	"active: true\n"
+	"lowMin: 0.0\n"
+	"lowMax: 0.0\n"
+	"highMin: 0.0\n"
+	"highMax: 250.0\n"
+	"relative: true\n"
+	"scalingCount: 2\n"
+	"scaling0: 0.5\n"
+	"scaling1: 1.0\n"
+	"timelineCount: 2\n"
+	"timeline0: 0.0\n"
+	"timeline1: 1.0\n"
+	"- X Offset - \n"
+	"active: false\n"
+	"- Y Offset - \n"
+	"active: false\n"
+	"- Spawn Shape - \n"
+	"shape: ellipse\n"
+	"edges: true\n"
+	"side: top\n"
+	"- Spawn Width - \n"
+	"lowMin: 0.0\n"
+	"lowMax: 0.0\n"
+	"highMin: 0.0\n"
+	"highMax: 0.0\n"
+	"relative: false\n"
+	"scalingCount: 1\n"
+	"scaling0: 1.0\n"
+	"timelineCount: 1\n"
+	"timeline0: 0.0\n"
+	"- Spawn Height - \n"
+	"lowMin: 0.0\n"
+	"lowMax: 0.0\n"
+	"highMin: 0.0\n"
+	"highMax: 0.0\n"
+	"relative: false\n"
+	"scalingCount: 1\n"
+	"scaling0: 1.0\n"
+	"timelineCount: 1\n"
+	"timeline0: 0.0\n"
+	"- Scale - \n"
+	"lowMin: 0.0\n"
+	"lowMax: 0.0\n"
+	"highMin: 32.0\n"
+	"highMax: 32.0\n"
+	"relative: false\n"
+	"scalingCount: 1\n"
+	"scaling0: 1.0\n"
+	"timelineCount: 1\n"
+	"timeline0: 0.0\n"
+	"- Velocity - \n"
+	"active: true\n"
+	"lowMin: 0.0\n"
+	"lowMax: 0.0\n"
+	"highMin: 30.0\n"
+	"highMax: 300.0\n"
+	"relative: false\n"
+	"scalingCount: 1\n"
+	"scaling0: 1.0\n"
+	"timelineCount: 1\n"
+	"timeline0: 0.0\n"
+	"- Angle - \n"
+	"active: true\n"
+	"lowMin: 90.0\n"
+	"lowMax: 90.0\n"
+	"highMin: 45.0\n"
+	"highMax: 135.0\n"
+	"relative: false\n"
+	"scalingCount: 3\n"
+	"scaling0: 1.0\n"
+	"scaling1: 0.0\n"
+	"scaling2: 0.0\n"
+	"timelineCount: 3\n"
+	"timeline0: 0.0\n"
+	"timeline1: 0.5\n"
+	"timeline2: 1.0\n"
+	"- Rotation - \n"
+	"active: false\n"
+	"- Wind - \n"
+	"active: true\n"
+	"lowMin: 0.0\n"
+	"lowMax: 0.0\n"
+	"highMin: -20.0\n"
+	"highMax: 20.0\n"
+	"relative: false\n"
+	"scalingCount: 1\n"
+	"scaling0: 1.0\n"
+	"timelineCount: 1\n"
+	"timeline0: 0.0\n"
+	"- Gravity - \n"
+	"active: false\n"
+	"- Tint - \n"
+	"colorsCount: 6\n"
+	"colors0: 1.0\n"
+	"colors1: 0.8\n"
+	"colors2: 0.25\n"
+	"colors3: 0.5\n"
+	"colors4: 0.1\n"
+	"colors5: 0.0\n"
+	"timelineCount: 2\n"
+	"timeline0: 0.0\n"
+	"timeline1: 1.0\n"
+	"- Transparency - \n"
+	"lowMin: 0.0\n"
+	"lowMax: 0.0\n"
+	"highMin: 1.0\n"
+	"highMax: 1.0\n"
+	"relative: false\n"
+	"scalingCount: 4\n"
+	"scaling0: 0.0\n"
+	"scaling1: 1.0\n"
+	"scaling2: 0.75\n"
+	"scaling3: 0.0\n"
+	"timelineCount: 4\n"
+	"timeline0: 0.0\n"
+	"timeline1: 0.2\n"
+	"timeline2: 0.8\n"
+	"timeline3: 1.0\n"
+	"- Options - \n"
+	"attached: false\n"
+	"continuous: false\n"
+	"aligned: false\n"
+	"additive: true\n"
+	"behind: false\n"
+	"premultipliedAlpha: true\n"
+	"- Image Path -\n"
+	"spark.png\n";
+
+#endif
@@ -0,0 +1,148 @@
+/** Checks that ParticleTextReader loads effects exactly as the line-by-line stream reader does, down to the bits
+* of every number. Needs only the simulation core, e.g. from Classes/core/particle:
+*   g++ -std=c++14 -I. -I../.. test/ParticleTextReaderTest.cpp ParticleSimulation.cpp ParticleStats.cpp ParticleAffector.cpp */
+#include "ParticleSimulation.h"
+#include "ParticleTestEffects.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+USING_NS_CUSTOM;
+
+static int failures = 0;
+
+static void check(bool condition, const char* message)
+{
+	if (condition) return;
+	printf("FAILED: %s\n", message);
+	failures++;
+}
+
+/** Saves with enough digits that two floats print alike only if they are equal. */
+static string saveExact(std::vector<ParticleDefinition*>& definitions)
+{
+	std::ostringstream output;
+	output.precision(9);
+	for (auto definition : definitions)
+		definition->save(output) << "\n\n";
+	return output.str();
+}
+
+static void deleteAll(std::vector<ParticleDefinition*>& definitions)
+{
+	for (auto definition : definitions)
+		delete definition;
+	definitions.clear();
+}
+
+/** Loads as ParticleEffect::parseDefinitions does. */
+static bool parse(const string& text, std::vector<ParticleDefinition*>& definitions)
+{
+	ParticleTextReader reader(text.data(), text.size());
+	while (true) {
+		auto definition = new ParticleDefinition();
+		definitions.push_back(definition);
+		if (!definition->load(reader)) return false;
+		if (!reader.skipLine() || !reader.skipLine()) return true;
+	}
+}
+
+/** Loads as the stream reader in ParticleEffect does. */
+static void read(const string& text, std::vector<ParticleDefinition*>& definitions)
+{
+	std::istringstream input(text);
+	string line;
+	while (true) {
+		auto definition = new ParticleDefinition();
+		definition->load(input);
+		definitions.push_back(definition);
+		getline(input, line);
+		if (input.eof()) break;
+		getline(input, line);
+		if (input.eof()) break;
+	}
+}
+
+/** Whether both readers accept text and load the same definitions from it. */
+static bool loadsAlike(const string& text)
+{
+	std::vector<ParticleDefinition*> parsed, read;
+	bool parsedAll = parse(text, parsed);
+	::read(text, read);
+	bool alike = parsedAll && saveExact(parsed) == saveExact(read);
+	if (parsedAll && !alike){
+		std::istringstream parsedText(saveExact(parsed)), readText(saveExact(read));
+		string parsedLine, readLine;
+		while (getline(parsedText, parsedLine) && getline(readText, readLine)){
+			if (parsedLine == readLine) continue;
+			printf("parsed \"%s\", read \"%s\"\n", parsedLine.c_str(), readLine.c_str());
+			break;
+		}
+	}
+	deleteAll(parsed);
+	deleteAll(read);
+	return alike;
+}
+
+/** Replaces the first line of text that starts with from by to, or removes it. */
+static string replaceLine(string text, const string& from, const string& to)
+{
+	size_t start = text.find(from);
+	if (start == string::npos) return text;
+	size_t end = text.find('\n', start);
+	if (to.empty()) end++;
+	return text.replace(start, end - start, to);
+}
+
+/** The first emitter of the test effect with count numbers as its life scaling, as the editor writes them. */
+static string withScaling(const std::vector<string>& numbers)
+{
+	string text = TEST_EFFECT;
+	text = text.substr(0, text.find("\n\n") + 1);
+	std::ostringstream scaling;
+	scaling << "scalingCount: " << numbers.size() << "\n";
+	for (size_t i = 0; i < numbers.size(); i++)
+		scaling << "scaling" << i << ": " << numbers[i] << "\n";
+	scaling << "timelineCount: " << numbers.size() << "\n";
+	for (size_t i = 0; i < numbers.size(); i++)
+		scaling << "timeline" << i << ": " << (float)i / numbers.size() << "\n";
+	size_t life = text.find("- Life - ");
+	size_t start = text.find("scalingCount", life);
+	size_t end = text.find("- Life Offset - ", life);
+	return text.replace(start, end - start, scaling.str());
+}
+
+int main()
+{
+	check(loadsAlike(TEST_EFFECT), "both readers load the test effect alike");
+
+	// Editor output (Java's Float.toString), printf styles and edge cases: every one must match atof.
+	std::vector<string> numbers = { "0", "0.0", "-0.0", "1", "1.0", "-1.0", "0.5", "0.047058824", "0.12156863",
+		"1.0E-5", "1.4E-45", "3.4028235E38", "1.17549435E-38", "6.5E10", "123456789", "0.1", "0.3", "2.5e+3",
+		"-7.0E-3", "100000.0", "0.00000001", "99999999999999999999", "0.123456789012345678901234",
+		"1234567890123456789012345.0", "+2" };
+	ParticleRandom::setSeed(1);
+	char buffer[64];
+	for (int i = 0; i < 20000; i++){
+		// Values across the magnitudes effects use, with random mantissas.
+		float value = ParticleRandom::random(-1, 1) * powf(10, (float)(i % 13 - 6));
+		const char* formats[] = { "%.9g", "%.8g", "%.7g", "%.6g", "%f", "%.9e" };
+		snprintf(buffer, sizeof(buffer), formats[i % 6], value);
+		numbers.push_back(buffer);
+	}
+	check(loadsAlike(withScaling(numbers)), "both readers parse every number to the same float");
+
+	// Emitters saved before premultipliedAlpha existed go straight from behind to the image path.
+	check(loadsAlike(replaceLine(TEST_EFFECT, "premultipliedAlpha", "")), "both readers load emitters without premultipliedAlpha");
+
+	std::vector<ParticleDefinition*> definitions;
+	check(!parse(replaceLine(TEST_EFFECT, "scaling1", "scalinq1: 1.0"), definitions), "the parser checks indexed keys");
+	deleteAll(definitions);
+	check(!parse(replaceLine(TEST_EFFECT, "lowMax", "lowMax: 1.0.0"), definitions), "the parser rejects malformed numbers");
+	deleteAll(definitions);
+
+	if (failures == 0) printf("ParticleTextReaderTest passed\n");
+	return failures == 0 ? 0 : 1;
+}
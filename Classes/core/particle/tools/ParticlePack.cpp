@@ -0,0 +1,52 @@
+/** Packs effect files and the images they reference into one ParticleEffectPack file:
+*   ParticlePack [-r <resource root>] <pack file> <effect>... [@<list file>]...
+* Effects are stored under the names given, so pass them as the game loads them, relative to a resource root
+* that -r puts in front of the search paths. A list file holds one effect name per line. Needs the cocos2d-x
+* library for FileUtils, e.g. from Classes/core/particle:
+*   g++ -std=c++14 -I. -I../.. -I$COCOS_ROOT/cocos tools/ParticlePack.cpp *.cpp -L$COCOS_LIB -lcocos2d -o ParticlePack */
+#include "ParticleEffectPack.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+USING_NS_CUSTOM;
+
+static bool readList(const string& file, std::vector<string>& names)
+{
+	std::ifstream input(file);
+	if (!input.is_open()) return false;
+	string line;
+	while (getline(input, line)){
+		if (!line.empty() && line.back() == '\r') line.pop_back();
+		if (!line.empty()) names.push_back(line);
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	int arg = 1;
+	if (arg + 1 < argc && strcmp(argv[arg], "-r") == 0){
+		FileUtils::getInstance()->addSearchPath(argv[arg + 1], true);
+		arg += 2;
+	}
+	if (arg + 1 >= argc){
+		printf("usage: ParticlePack [-r <resource root>] <pack file> <effect>... [@<list file>]...\n");
+		return 2;
+	}
+	string packFile = argv[arg++];
+	std::vector<string> names;
+	for (; arg < argc; arg++){
+		if (argv[arg][0] != '@') names.push_back(argv[arg]);
+		else if (!readList(argv[arg] + 1, names)){
+			printf("ParticlePack: cannot read %s\n", argv[arg] + 1);
+			return 1;
+		}
+	}
+	if (!ParticleEffectPack::write(names, packFile)){
+		printf("ParticlePack: failed to write %s\n", packFile.c_str());
+		return 1;
+	}
+	printf("ParticlePack: packed %d effects into %s\n", (int)names.size(), packFile.c_str());
+	return 0;
+}